@@ -25,6 +25,10 @@
  * MarkdownBrowser.c - Markdown browser widget derived from GtkBox.
  */
 #include "MarkdownBrowser.h"
+#include "MarkdownBrowserBundle.h"
+#include "MarkdownBrowserDocument.h"
+#include "MarkdownBrowserImageCache.h"
+#include "MarkdownBrowserParseCache.h"
 
 // C source data for default interface
 #include "MarkdownBrowser-ui.h"
@@ -34,16 +38,22 @@
 #define DEFAULT_FILE_MATCH      "(.*)\\.(md|markdown)$" // Default Markdown file match regex (first group capture is used as topic ID name)
 #define DEFAULT_TITLE_MATCH     "^ {0,3}\\# (.*)"       // Default regular expression to extract title from content
 
-#define MAX_LIST_LEVELS         10      // Maximum number of nested list levels (1 = bullet list without children)
-#define MAX_HEADER_NUMBER       6       // Maximum header number (h6)
-#define MAX_FIRST_LEVEL_SPACES  3       // Maximum spaces at beginning of line for first level of list or header
-#define MAX_LEVEL_SPACES        5       // Maximum number of additional spaces at start of line per level
-#define MIN_LEVEL_SPACING       2       // Minimum additional spaces for each list level
-
 #define DEFAULT_IMAGES_PATH     "."     // Default data path for images
 #define DEFAULT_BULLET_CHARS    "●○■"   // Default bullet characters for level 1, 2, and 3+
 #define DEFAULT_HOME_TOPIC      "README"        // Default home topic name ID
 #define DEFAULT_ICON_SIZE       24
+#define DEFAULT_RENDER_CACHE_SIZE       8       // Default number of rendered topic buffers to keep
+#define MAX_RENDER_CACHE_SIZE   1000    // Maximum value of render-cache-size property
+#define RENDER_SLICE_TIME       4000    // Time budget of each progressive render slice in microseconds
+#define RENDER_FIRST_LINES      100     // Number of lines always rendered up front (at least a screenful)
+#define DEFAULT_RENDER_DEADLINE 2000    // Default parse time limit of a topic in milliseconds
+#define MAX_RENDER_DEADLINE     600000  // Maximum value of render-deadline property
+#define MAX_BULLET_LEN          8       // Maximum size of a bullet string (UTF-8 character, space and NUL)
+#define IMAGE_LOAD_AHEAD        1       // Number of pages above and below the visible area to load images for
+#define MAX_IMAGE_SIZE          16384   // Maximum image size hint
+#define DEFAULT_CONTENT_BUDGET  (8 * 1024 * 1024)       // Default memory budget of lazily loaded topics in bytes
+#define TITLE_SCAN_SIZE         4096    // Number of bytes at the start of a lazily loaded file searched for the title
+#define WATCH_DEBOUNCE_TIME     250     // Milliseconds without further changes before watched files are reloaded
 
 enum
 {
@@ -55,9 +65,27 @@ enum
   PROP_HISTORY_SIZE,
   PROP_HISTORY_MAX,
   PROP_BULLET_CHARS,
-  PROP_HOME_TOPIC
+  PROP_HOME_TOPIC,
+  PROP_RENDER_CACHE_SIZE,
+  PROP_RENDER_DEADLINE,
+  PROP_PAGINATE_LEVEL,
+  PROP_SECTION,
+  PROP_SECTION_COUNT,
+  PROP_LAZY_LOAD,
+  PROP_CONTENT_BUDGET,
+  PROP_RECURSIVE,
+  PROP_WATCH
+};
+
+// Signal IDs
+enum
+{
+  RENDER_TIMEOUT,
+  LAST_SIGNAL
 };
 
+static guint markdown_browser_signals[LAST_SIGNAL];
+
 // Enum of tags defined in UI file
 typedef enum
 {
@@ -83,38 +111,201 @@ typedef enum
   MARKDOWN_BROWSER_TAG_COUNT
 } MarkdownBrowserTag;
 
-// Columns for data in topic list store
+// Columns for data in topic tree store
 enum
 {
-  TOPIC_COLUMN_TITLE,           // Topic title
-  TOPIC_COLUMN_INDEX            // Index of topic in topic array
+  TOPIC_COLUMN_TITLE,           // Topic title (directory name for directory rows)
+  TOPIC_COLUMN_INDEX,           // Index of topic in topic array (-1 for directory and placeholder rows)
+  TOPIC_COLUMN_DIRECTORY        // Topic name prefix of directory rows ("dir/sub/"), NULL otherwise
 };
 
 typedef struct
 {
   GtkBuilder *builder;                  // GTK builder for preferences interface
   GtkTreeSelection *treeSelection;      // Topic tree view selection
-  GtkListStore *topicListStore;         // Topic list store
+  GtkTreeStore *topicTreeStore;         // Topic tree store
+  GArray *topicIters;                   // Tree store iterator of each topic (GtkTreeIter, user_data is NULL if not in tree)
+  GHashTable *directories;              // Topic name prefix ("dir/sub/") -> MarkdownBrowserDirectory, for recursive add_files
   GtkTextView *textView;                // Content text view
-  GtkTextBuffer *textBuffer;            // Content text buffer
+  GtkTextBuffer *textBuffer;            // Displayed content text buffer (ref held)
+  GtkTextBuffer *emptyBuffer;           // Empty content text buffer shown when no topic is selected
+  MarkdownBrowserDocument *emptyDocument;       // Empty document of a topic whose file failed to load (ref held)
+  GtkTextTagTable *tagTable;            // Tag table shared by all content text buffers
+  GQueue *renderCache;                  // Rendered topic buffers (MarkdownBrowserCachedBuffer), most recently used first
+  struct _MarkdownBrowserRenderBag *renderJob;  // Progressive render in progress or NULL
+  guint renderIdleId;                   // Idle callback ID of progressive render
+  guint iconRefreshId;                  // Idle callback ID of refresh after an icon theme change
+  guint animationTickId;                // Text view tick callback ID while animations are visible (0 if none)
 
   GArray *topics;                   // Array of MarkdownBrowserTopic structures
+  GArray *topicInfo;                    // Array of MarkdownBrowserTopicInfo, private data of topics (same indexes)
+  GHashTable *topicNames;               // Topic name (borrowed from topics) -> topic index, for first topic with a name
   GtkTextTag *tags[MARKDOWN_BROWSER_TAG_COUNT];        // Tag array for quick access
   GArray *history;                      // Array of MarkdownBrowserVisit for visit history
   int historyPos;                       // Current history position (next index in history to store to which may be off the end)
   gboolean scrollToLine;                // TRUE to scroll to line in size-request signal of GtkTextView
   guint idleId;                         // Idle callback ID
+  guint navigateSerial;                 // Incremented on each navigation request (newer requests supersede pending async ones)
 
   char *uiFile;                         // External UI file name (or NULL to use internal data)
   char *imagesPath;                     // Path to images
   char *bulletChars;                    // Bullet characters, last one is used for all following levels
+  char bullets[MARKDOWN_BROWSER_MAX_LIST_LEVELS][MAX_BULLET_LEN];       // Bullet string for each list level (from bulletChars)
+  GString *renderRun;                   // Scratch text run buffer of renderer (reused between renders)
   char *homeTopic;                      // Home topic name or NULL if disabled
   int topicIndex;                       // Current topic index (-1 if none)
   int historyMax;                      // Maximum history size
+  int renderCacheSize;                  // Maximum number of rendered topic buffers to keep
+  int renderDeadline;                   // Parse time limit of a topic in milliseconds (0 for none)
+  int paginateLevel;                    // Maximum header number to split topics into sections at (0 to disable)
+  int section;                          // Current section of current topic
+  GArray *sections;                     // Start span index of each section of current topic (guint)
+  gboolean lazyLoad;                    // TRUE to only scan titles in markdown_browser_add_files() and load content on demand
+  gboolean recursive;                   // TRUE to add sub directories in markdown_browser_add_files() (enumerated on demand)
+  gboolean watch;                       // TRUE to watch directories of markdown_browser_add_files() for changed files
+  GPtrArray *watches;                   // Watched directories (MarkdownBrowserWatch)
+#ifdef DEBUG
+  gboolean coalesceRuns;                // TRUE to insert same-style text as runs, FALSE to insert and tag each span
+#endif
+  GHashTable *watchChanges;             // Changed file path -> MarkdownBrowserWatch, pending reload
+  guint watchTimeoutId;                 // Debounce timeout ID of changed files (0 if none pending)
+  int contentBudget;                    // Memory budget of lazily loaded topic content and parsed documents in bytes
+  gsize lazyBytes;                      // Memory used by loaded content and documents of lazily loaded topics
+  guint topicUseSerial;                 // Incremented each time a topic is used (for least recently used eviction)
+  guint topicIdSerial;                  // Last topic ID assigned (see MarkdownBrowserTopicInfo id)
+  GtkWidget *prevSectionBtn;            // Previous section button
+  GtkWidget *nextSectionBtn;            // Next section button
   gboolean onLink;                      // TRUE when mouse cursor is over link (changed to pointer cursor)
 } MarkdownBrowserPrivate;
 
-static void markdown_browser_topic_clear (gpointer data);
+// Rendered topic text buffer in the render cache
+typedef struct
+{
+  int topic;                            // Topic index
+  int section;                          // Topic section
+  GtkTextBuffer *buffer;                // Rendered content text buffer (ref held)
+} MarkdownBrowserCachedBuffer;
+
+// An image anchored in a rendered text buffer, attached to its child anchor as "image" data.  Images are anchored
+// widgets while being decoded and permanently on HiDPI displays, since text buffer pixbufs can't be drawn scaled.
+typedef struct
+{
+  char *filename;                       // Image file name
+  const char *alt;                      // Image alt text or NULL (in the document text pool)
+  int width;                            // Display size in logical pixels
+  int height;
+  int decodeWidth;                      // Size to decode the image at or -1 for natural size
+  int decodeHeight;
+  int scale;                            // Device pixels per logical pixel of the decoded image
+  GdkPixbuf *pixbuf;                    // Decoded image shown by the anchored widget if scale > 1 (ref held)
+  gboolean animated;                    // TRUE if image is an animation (GIF)
+  GdkPixbufAnimation *animation;        // Decoded animation if animated (ref held, shared)
+  GdkPixbufAnimationIter *animationIter;        // Animation iterator once it was visible or NULL
+  gint64 nextFrameTime;                 // Frame clock time of next animation frame (microseconds)
+  GtkTextBuffer *buffer;                // Text buffer of the anchor, NULL once it was destroyed (no ref held)
+  GCancellable *cancellable;            // Cancellable of the decode once started, NULL if not yet started
+} MarkdownBrowserAnchoredImage;
+
+// Markdown render bag (for passing between render functions, persists between progressive render slices)
+typedef struct _MarkdownBrowserRenderBag
+{
+  MarkdownBrowserPrivate *priv;
+  GtkTextBuffer *textBuf;               // Content text buffer being rendered to (ref held)
+  GtkTextIter iter;                     // Append iterator of textBuf (only valid during a render slice)
+  MarkdownBrowserDocument *doc;         // Parsed document being rendered (ref held)
+  int topic;                            // Topic index being rendered
+  int section;                          // Topic section being rendered
+  guint spanIndex;                      // Index of next span to render
+  guint spanEnd;                        // Index of span after the last one to render (end of section)
+  GString *run;                         // Pending text run which has not been inserted yet (priv->renderRun)
+  guint runStyle;                       // Span style of pending text run
+} MarkdownBrowserRenderBag;
+
+// Pending asynchronous navigation (task data of parser thread task)
+typedef struct
+{
+  int historyOfs;                       // History position offset
+  int topicIndex;                       // Topic index (if historyOfs == 0)
+  guint topicId;                        // ID of topic being parsed (its index changes if topics are re-sorted)
+  const char *content;                  // Content of topic being parsed or NULL if a lazily loaded topic has to be
+                                        // loaded first (topic is pinned, so content remains valid)
+  int contentLen;                       // Length of content or -1 if NUL terminated
+  char *path;                           // File of lazily loaded topic (if content is NULL)
+  char *loadedContent;                  // Content loaded from path by the worker thread
+  int timeLimit;                        // Parse time limit in milliseconds (render-deadline property)
+  gboolean cached;                      // TRUE if the topic is from a file and uses the parse cache
+  char *hash;                           // Content hash for the parse cache or NULL to compute it
+  char *anchor;                         // Anchor of the section to go to (without '#') or NULL
+  guint serial;                         // Navigation serial number at time of request
+} MarkdownBrowserNavigateData;
+
+// Markdown file loaded by a markdown_browser_add_files() thread pool worker
+typedef struct
+{
+  char *fullpath;                       // Full path of the file
+  char *name;                           // Topic name from the file match
+  char *title;                          // Title from the title match or NULL (set by worker)
+  char *content;                        // Content (set by worker, NULL on error or if lazy)
+  char *hash;                           // Content hash for the parse cache (set by worker, NULL if lazy)
+  gboolean lazy;                        // TRUE to only extract the title from the start of the file
+  GError *err;                          // Load error (set by worker)
+} MarkdownBrowserFileLoad;
+
+// Private data of a topic, kept out of MarkdownBrowserTopic which is returned by markdown_browser_get_topics()
+typedef struct
+{
+  guint id;                             // Unique topic ID, stays the same when topics are re-sorted
+  MarkdownBrowserDocument *document;    // Parsed content, created on first render
+  char *path;                           // File the content is loaded from if lazily loaded, NULL otherwise
+  GBytes *bytes;                        // Content data if added from GBytes (content points into it) or NULL
+  gsize size;                           // Memory used by loaded content and document if lazily loaded
+  guint lastUsed;                       // Use serial number for least recently used unloading
+  int pinCount;                         // Number of pending parses which keep the content loaded
+  MarkdownBrowserBundle *bundle;        // Help bundle the topic was added from or NULL
+  guint bundleIndex;                    // Topic index in bundle
+  char *hash;                           // Content hash of a topic from markdown_browser_add_files() for the parse cache
+  char *imagesPath;                     // Images of a topic added from resources or a bundle, NULL for images-path
+} MarkdownBrowserTopicInfo;
+
+// Private data of a topic in priv->topics
+#define markdown_browser_topic_info(priv, topic) \
+  (&g_array_index ((priv)->topicInfo, MarkdownBrowserTopicInfo, (topic) - (MarkdownBrowserTopic *)(priv)->topics->data))
+
+// Base path of images referenced by a topic, topics added from resources or a bundle have their own images
+#define markdown_browser_topic_images_path(priv, index) \
+  ((index) >= 0 && (index) < (priv)->topicInfo->len \
+   && g_array_index ((priv)->topicInfo, MarkdownBrowserTopicInfo, (index)).imagesPath \
+   ? g_array_index ((priv)->topicInfo, MarkdownBrowserTopicInfo, (index)).imagesPath : (priv)->imagesPath)
+
+// Length of topic content to parse, content of topics added from GBytes is not necessarily NUL terminated
+#define markdown_browser_topic_content_len(info)        ((info)->bytes ? (int)g_bytes_get_size ((info)->bytes) : -1)
+
+// Sub directory of a recursive markdown_browser_add_files(), enumerated when its tree row is expanded or a topic in it
+// is looked up by name
+typedef struct
+{
+  char *prefix;                         // Topic name prefix of the directory ("dir/sub/")
+  char *path;                           // Directory path
+  GRegex *fileRegex;                    // File match regex (ref held)
+  GRegex *titleRegex;                   // Title match regex (ref held)
+  gboolean lazy;                        // Value of lazy-load property when added
+  gboolean enumerated;                  // TRUE once its files have been added as topics
+  gboolean inTree;                      // TRUE if it has a row in the topic tree store
+  GtkTreeIter iter;                     // Topic tree store row if inTree
+} MarkdownBrowserDirectory;
+
+// Directory of markdown_browser_add_files() watched for changed and new files (watch property)
+typedef struct
+{
+  MarkdownBrowser *browser;             // Browser (no ref held, watches are freed on finalize)
+  GFileMonitor *monitor;                // Directory monitor (ref held)
+  char *prefix;                         // Topic name prefix of files in the directory
+  GRegex *fileRegex;                    // File match regex (ref held)
+  GRegex *titleRegex;                   // Title match regex (ref held)
+  gboolean lazy;                        // Value of lazy-load property when added
+} MarkdownBrowserWatch;
+
+static void markdown_browser_topic_clear (MarkdownBrowserTopic *topic, MarkdownBrowserTopicInfo *info);
 static void markdown_browser_finalize (GObject *object);
 static void markdown_browser_constructed (GObject *object);
 static void markdown_browser_key_press_event (MarkdownBrowser *browser, GdkEventKey *keyEvent, gpointer user_data);
@@ -133,13 +324,54 @@ static void markdown_browser_set_property (GObject *object, guint property_id,
 static void markdown_browser_get_property (GObject *object, guint property_id,
                                      GValue *value, GParamSpec *pspec);
 static void markdown_browser_topic_selection_changed (GtkTreeSelection *selection, gpointer user_data);
-static int markdown_browser_topic_sort (gconstpointer a, gconstpointer b);
-static void markdown_browser_render_topic (MarkdownBrowser *browser, MarkdownBrowserTopic *topic);
-static gboolean markdown_browser_real_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex);
+static void markdown_browser_topic_names_rebuild (MarkdownBrowser *browser);
+static int markdown_browser_topic_index_sort (gconstpointer a, gconstpointer b, gpointer user_data);
+static void markdown_browser_topics_added (MarkdownBrowser *browser);
+static gboolean markdown_browser_directory_load (MarkdownBrowser *browser, const char *path, const char *prefix,
+                                                 GRegex *fileRegex, GRegex *titleRegex, gboolean lazy,
+                                                 gboolean recursive, GPtrArray *subdirs, GError **err);
+static gboolean markdown_browser_directory_enumerate_path (MarkdownBrowser *browser, const char *name);
+static gboolean markdown_browser_topic_tree_test_expand_row (GtkTreeView *treeView, GtkTreeIter *iter,
+                                                             GtkTreePath *path, MarkdownBrowser *browser);
+static void markdown_browser_watch_free (MarkdownBrowserWatch *watch);
+static void markdown_browser_watch_directory (MarkdownBrowser *browser, const char *path, const char *prefix,
+                                              GRegex *fileRegex, GRegex *titleRegex, gboolean lazy);
+static MarkdownBrowserTopicInfo *markdown_browser_add_topic_take (MarkdownBrowser *browser, char *name, char *title,
+                                                                  char *content);
+static void markdown_browser_topics_trim (MarkdownBrowser *browser, MarkdownBrowserTopic *inUse);
+static void markdown_browser_file_load_thread (gpointer data, gpointer user_data);
+static gboolean markdown_browser_render_topic (MarkdownBrowserRenderBag *bag, gint64 budget, int minLines);
+static gboolean markdown_browser_render_idle (gpointer data);
+static void markdown_browser_render_cancel (MarkdownBrowser *browser);
+static void markdown_browser_render_bag_free (MarkdownBrowserRenderBag *bag);
+static void markdown_browser_update_bullets (MarkdownBrowserPrivate *priv);
+static void markdown_browser_show_topic (MarkdownBrowser *browser, int topicIndex, int section, int line);
+static void markdown_browser_attach_image_widgets (MarkdownBrowser *browser);
+static void markdown_browser_load_visible_images (MarkdownBrowser *browser);
+static void markdown_browser_vadjustment_changed (GtkAdjustment *adjustment, MarkdownBrowser *browser);
+static void markdown_browser_scale_factor_changed (GObject *object, GParamSpec *pspec, MarkdownBrowser *browser);
+static void markdown_browser_icon_theme_changed (GtkIconTheme *iconTheme, MarkdownBrowser *browser);
+static void markdown_browser_refresh_topic (MarkdownBrowser *browser);
+static void markdown_browser_scroll_to_line (MarkdownBrowser *browser, int line);
+static void markdown_browser_update_animations (MarkdownBrowser *browser);
+static void markdown_browser_text_view_map_changed (GtkWidget *widget, MarkdownBrowser *browser);
+static void markdown_browser_render_cache_trim (MarkdownBrowser *browser, int size);
+static gboolean markdown_browser_real_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex, int section);
+static void markdown_browser_update_section_buttons (MarkdownBrowser *browser);
+static void markdown_browser_parse_thread (GTask *task, gpointer source_object, gpointer task_data,
+                                           GCancellable *cancellable);
+static void markdown_browser_navigate_parsed (GObject *source_object, GAsyncResult *res, gpointer user_data);
+static void markdown_browser_navigate_data_free (gpointer data);
+static void markdown_browser_navigate_home (MarkdownBrowser *browser);
+static void markdown_browser_real_navigate_async (MarkdownBrowser *browser, int historyOfs, int topicIndex,
+                                                  const char *anchor, GCancellable *cancellable,
+                                                  GAsyncReadyCallback callback, gpointer user_data);
 static void markdown_browser_back_clicked (GtkWidget *widget, MarkdownBrowser *browser);
 static void markdown_browser_forward_clicked (GtkWidget *widget, MarkdownBrowser *browser);
 static void markdown_browser_home_clicked (GtkWidget *widget, MarkdownBrowser *browser);
 static void markdown_browser_clicker_clicked (GtkWidget *widget, MarkdownBrowser *browser);
+static void markdown_browser_prev_section_clicked (GtkWidget *widget, MarkdownBrowser *browser);
+static void markdown_browser_next_section_clicked (GtkWidget *widget, MarkdownBrowser *browser);
 static gboolean markdown_browser_topics_update (gpointer data);
 
 G_DEFINE_TYPE_WITH_PRIVATE (MarkdownBrowser, markdown_browser, GTK_TYPE_BOX)
@@ -168,56 +400,10 @@ const char *markdown_browser_tag_names[MARKDOWN_BROWSER_TAG_COUNT] =
   "H6"
 };
 
-typedef enum
-{
-  REGEX_EMPHASIS_START,         // Emphasis (bold/italic) start regular expression
-  REGEX_HEADER_START,           // h1-h6 Markdown header
-  REGEX_BULLET_ITEM_START,      // Start of a bullet list item
-  REGEX_NUMERIC_ITEM_START,     // Start of a numeric list item
-  REGEX_IMAGE,                  // Image in the form: ![Alt Text](/images/image.jpg)
-  REGEX_LINK,                   // Link in the form: [Alt Text](http://link)
-
-  REGEX_EMPHASIS_END,           // Emphasis end regular expression
-  REGEX_HEADER_OR_LIST_ITEM_END // End of header
-} MarkdownBrowserRegexEnum;
-
-#define REGEX_COUNT             REGEX_HEADER_OR_LIST_ITEM_END + 1
-
-// Set to the first END tag (only searched if a START tag has matched)
-#define REGEX_FIRST_END_MATCH   REGEX_EMPHASIS_END
-
-// Match a string in brackets or parenthesis, including escaped end bracket or parenthesis using Friedl's unrolling-the-loop technique
-#define BRACKET_STR             "\\[([^]\\\\]*(?:\\\\.[^]\\\\]*)*)\\]"
-#define PARENTH_STR             "\\(([^)\\\\]+(?:\\\\.[^)\\\\]*)*)\\)"
-
-// Markdown parsing regular expressions
-// Look behind/ahead is used to not consume surrounding character assertions
-// Backslash escape characters are handled here as well, to ensure regex does not match
-static const char *regex_strings[REGEX_COUNT] =
-{
-  "(?<!\\\\)(\\*{1,3})(?![* ])",  // REGEX_EMPHASIS_START
-  "^ {0,3}(\\#{1,6}) ",         // REGEX_HEADER_START
-  "^( *)\\* ",                  // REGEX_BULLET_ITEM_START
-  "^( *)\\d+\\. ",              // REGEX_NUMERIC_ITEM_START
-  "(?<!\\\\)!" BRACKET_STR PARENTH_STR,         // REGEX_IMAGE
-  "(?<![!\\\\])" BRACKET_STR PARENTH_STR,       // REGEX_LINK
-
-  "(?<![\\\\ ])(\\*{1,3})",     // REGEX_EMPHASIS_END - The look behind causes character preceeding end match to be processed normally
-  "(?=\\R)"                     // REGEX_HEADER_OR_LIST_ITEM_END
-};
-
-// Characters in Markdown which can be escaped, others will result in the backslash not being considered an escape character
-static const char *valid_escaped_chars = "\\`*_{}[]<>()#+-.!|";
-
-// Compiled regular expressions for Markdown matching
-static GRegex *regexes[REGEX_COUNT];
-
 static void
 markdown_browser_class_init (MarkdownBrowserClass *klass)
 {
   GObjectClass *obj_class = G_OBJECT_CLASS (klass);
-  GError *err = NULL;
-  int i;
 
   obj_class->constructed = markdown_browser_constructed;
   obj_class->finalize = markdown_browser_finalize;
@@ -248,15 +434,55 @@ markdown_browser_class_init (MarkdownBrowserClass *klass)
   g_object_class_install_property (obj_class, PROP_HOME_TOPIC,
     g_param_spec_string ("home-topic", "HomeTopic", "Home topic or NULL to disable",
                          DEFAULT_HOME_TOPIC, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_RENDER_CACHE_SIZE,
+    g_param_spec_int ("render-cache-size", "RenderCacheSize", "Number of rendered topics to keep for fast navigation (0 to disable)",
+                      0, MAX_RENDER_CACHE_SIZE, DEFAULT_RENDER_CACHE_SIZE, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_RENDER_DEADLINE,
+    g_param_spec_int ("render-deadline", "RenderDeadline", "Time limit in milliseconds for formatting a topic, after which the rest is shown as plain text (0 for no limit)",
+                      0, MAX_RENDER_DEADLINE, DEFAULT_RENDER_DEADLINE, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_PAGINATE_LEVEL,
+    g_param_spec_int ("paginate-level", "PaginateLevel", "Split topics into sections at headers up to this level, only showing one section at a time (0 to disable)",
+                      0, MARKDOWN_BROWSER_MAX_HEADER_NUMBER, 0, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_SECTION,
+    g_param_spec_int ("section", "Section", "Current section of topic (if paginate-level is set)",
+                      0, G_MAXINT, 0, G_PARAM_READABLE));
+  g_object_class_install_property (obj_class, PROP_SECTION_COUNT,
+    g_param_spec_int ("section-count", "SectionCount", "Number of sections in current topic (if paginate-level is set)",
+                      0, G_MAXINT, 0, G_PARAM_READABLE));
+  g_object_class_install_property (obj_class, PROP_LAZY_LOAD,
+    g_param_spec_boolean ("lazy-load", "LazyLoad", "Only read titles of files added with markdown_browser_add_files() and load their content when shown",
+                          FALSE, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_CONTENT_BUDGET,
+    g_param_spec_int ("content-budget", "ContentBudget", "Memory budget in bytes of lazily loaded topics, least recently used ones are unloaded when exceeded",
+                      0, G_MAXINT, DEFAULT_CONTENT_BUDGET, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_RECURSIVE,
+    g_param_spec_boolean ("recursive", "Recursive", "Add sub directories in markdown_browser_add_files() as a topic hierarchy, enumerated when expanded",
+                          FALSE, G_PARAM_READWRITE));
+  g_object_class_install_property (obj_class, PROP_WATCH,
+    g_param_spec_boolean ("watch", "Watch", "Watch directories added with markdown_browser_add_files() and reload topics when their files change",
+                          FALSE, G_PARAM_READWRITE));
+
+  /**
+   * MarkdownBrowser::render-timeout:
+   * @browser: Markdown browser
+   * @name: Name of the topic which exceeded the render deadline
+   *
+   * Emitted when formatting a topic exceeds the render-deadline property time limit.  The rest
+   * of the topic after that point is shown as plain text.
+   */
+  markdown_browser_signals[RENDER_TIMEOUT] =
+    g_signal_new ("render-timeout", G_TYPE_FROM_CLASS (obj_class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                  G_TYPE_NONE, 1, G_TYPE_STRING);
+}
 
-  // Compile regular expressions into GRegex structures
-  for (i = 0; i < REGEX_COUNT; i++)
-  {
-    regexes[i] = g_regex_new (regex_strings[i], G_REGEX_MULTILINE, 0, &err);
-
-    if (!regexes[i])
-      g_error ("Invalid regex '%s': %s", regex_strings[i], err->message);
-  }
+static void
+markdown_browser_directory_free (MarkdownBrowserDirectory *directory)
+{
+  g_free (directory->prefix);
+  g_free (directory->path);
+  g_regex_unref (directory->fileRegex);
+  g_regex_unref (directory->titleRegex);
+  g_slice_free (MarkdownBrowserDirectory, directory);
 }
 
 static void
@@ -265,7 +491,15 @@ markdown_browser_init (MarkdownBrowser *browser)
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
 
   priv->topics = g_array_new (FALSE, FALSE, sizeof (MarkdownBrowserTopic));
-  g_array_set_clear_func (priv->topics, markdown_browser_topic_clear);
+  priv->topicInfo = g_array_new (FALSE, FALSE, sizeof (MarkdownBrowserTopicInfo));
+  priv->topicNames = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->emptyDocument = markdown_browser_document_new ("", 0, 0);     // ++ new document
+  priv->topicIters = g_array_new (FALSE, TRUE, sizeof (GtkTreeIter));
+  priv->directories = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,     // Key is the directory prefix
+                                             (GDestroyNotify)markdown_browser_directory_free);
+
+  priv->watches = g_ptr_array_new_with_free_func ((GDestroyNotify)markdown_browser_watch_free);
+  priv->watchChanges = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   priv->history = g_array_new (FALSE, FALSE, sizeof (MarkdownBrowserVisit));
 
@@ -273,7 +507,17 @@ markdown_browser_init (MarkdownBrowser *browser)
   priv->topicIndex = MARKDOWN_BROWSER_TOPIC_NONE;
   priv->historyMax = DEFAULT_HISTORY_MAX;
   priv->bulletChars = g_strdup (DEFAULT_BULLET_CHARS);
+  markdown_browser_update_bullets (priv);
+  priv->renderRun = g_string_sized_new (1024);
   priv->homeTopic = g_strdup (DEFAULT_HOME_TOPIC);
+  priv->renderCache = g_queue_new ();
+  priv->renderCacheSize = DEFAULT_RENDER_CACHE_SIZE;
+  priv->renderDeadline = DEFAULT_RENDER_DEADLINE;
+  priv->contentBudget = DEFAULT_CONTENT_BUDGET;
+#ifdef DEBUG
+  priv->coalesceRuns = TRUE;
+#endif
+  priv->sections = g_array_new (FALSE, FALSE, sizeof (guint));
 }
 
 static void
@@ -281,9 +525,34 @@ markdown_browser_finalize (GObject *object)
 {
   MarkdownBrowser *browser = MARKDOWN_BROWSER (object);
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  guint i;
+
+  if (priv->watchTimeoutId)
+    g_source_remove (priv->watchTimeoutId);
+  g_hash_table_destroy (priv->watchChanges);
+  g_ptr_array_free (priv->watches, TRUE);
+
+  g_hash_table_destroy (priv->topicNames);      // Before topics, keys are borrowed from them
+  g_hash_table_destroy (priv->directories);
+  g_array_free (priv->topicIters, TRUE);
+
+  for (i = 0; i < priv->topics->len; i++)
+    markdown_browser_topic_clear (&g_array_index (priv->topics, MarkdownBrowserTopic, i),
+                                  &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, i));
 
   g_array_free (priv->topics, TRUE);
+  g_array_free (priv->topicInfo, TRUE);
+  markdown_browser_document_unref (priv->emptyDocument);       // -- unref empty document
   g_array_free (priv->history, TRUE);
+  g_array_free (priv->sections, TRUE);
+  markdown_browser_render_cancel (browser);
+  markdown_browser_render_cache_trim (browser, 0);
+  g_queue_free (priv->renderCache);
+
+  if (priv->iconRefreshId)
+    g_source_remove (priv->iconRefreshId);
+  g_string_free (priv->renderRun, TRUE);
+  g_clear_object (&priv->textBuffer);           // -- unref displayed text buffer
   g_object_unref (priv->builder);               // -- unref builder
   g_free (priv->homeTopic);
 
@@ -295,14 +564,26 @@ markdown_browser_finalize (GObject *object)
 }
 
 static void
-markdown_browser_topic_clear (gpointer data)
+markdown_browser_topic_clear (MarkdownBrowserTopic *topic, MarkdownBrowserTopicInfo *info)
 {
-  MarkdownBrowserTopic *topic = data;
-
   g_free (topic->name);
   g_free (topic->title);
-  g_free (topic->content);
+  if (info->bytes)
+    g_bytes_unref (info->bytes);        // Content points into bytes
+  else g_free (topic->content);
+
+  g_free (info->path);
+  g_free (info->hash);
+  g_free (info->imagesPath);
+
+  if (info->document)
+    markdown_browser_document_unref (info->document);
+
+  if (info->bundle)
+    markdown_browser_bundle_unref (info->bundle);
+
   memset (topic, 0, sizeof (MarkdownBrowserTopic));
+  memset (info, 0, sizeof (MarkdownBrowserTopicInfo));
 }
 
 static void
@@ -311,7 +592,6 @@ markdown_browser_constructed (GObject *object)
   MarkdownBrowser *browser = MARKDOWN_BROWSER (object);
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
   GtkWidget *widg;
-  GtkTextTagTable *tagTable;
   int i;
 
   gtk_orientable_set_orientation (GTK_ORIENTABLE (browser), GTK_ORIENTATION_VERTICAL);
@@ -327,6 +607,8 @@ markdown_browser_constructed (GObject *object)
                                     "forward", G_CALLBACK (markdown_browser_forward_clicked),
                                     "home", G_CALLBACK (markdown_browser_home_clicked),
                                     "clicker", G_CALLBACK (markdown_browser_clicker_clicked),
+                                    "prev_section", G_CALLBACK (markdown_browser_prev_section_clicked),
+                                    "next_section", G_CALLBACK (markdown_browser_next_section_clicked),
                                     NULL);
   gtk_builder_connect_signals (priv->builder, browser);
 
@@ -344,13 +626,15 @@ markdown_browser_constructed (GObject *object)
 
   g_signal_connect (browser, "key-press-event", G_CALLBACK (markdown_browser_key_press_event), browser);
 
-  priv->topicListStore = GTK_LIST_STORE (gtk_builder_get_object (priv->builder, "TopicListStore"));
+  priv->topicTreeStore = GTK_TREE_STORE (gtk_builder_get_object (priv->builder, "TopicTreeStore"));
 
   widg = GTK_WIDGET (gtk_builder_get_object (priv->builder, "TopicTreeView"));
   priv->treeSelection = GTK_TREE_SELECTION (gtk_tree_view_get_selection (GTK_TREE_VIEW (widg)));
   g_signal_connect (priv->treeSelection, "changed", G_CALLBACK (markdown_browser_topic_selection_changed), browser);
+  g_signal_connect (widg, "test-expand-row", G_CALLBACK (markdown_browser_topic_tree_test_expand_row), browser);
 
-  priv->textBuffer = GTK_TEXT_BUFFER (gtk_builder_get_object (priv->builder, "HelpTextBuffer"));
+  priv->emptyBuffer = GTK_TEXT_BUFFER (gtk_builder_get_object (priv->builder, "HelpTextBuffer"));
+  priv->textBuffer = g_object_ref (priv->emptyBuffer);  // ++ ref displayed text buffer
 
   priv->textView = GTK_TEXT_VIEW (gtk_builder_get_object (priv->builder, "HelpTextView"));
 
@@ -361,6 +645,17 @@ markdown_browser_constructed (GObject *object)
   g_signal_connect (priv->textView, "button-press-event", G_CALLBACK (markdown_browser_text_view_button_press), browser);
   g_signal_connect (priv->textView, "leave-notify-event", G_CALLBACK (markdown_browser_text_view_leave_notify), browser);
   g_signal_connect (priv->textView, "query-tooltip", G_CALLBACK (markdown_browser_text_view_query_tooltip), browser);
+  g_signal_connect (gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (priv->textView)), "value-changed",
+                    G_CALLBACK (markdown_browser_vadjustment_changed), browser);
+  g_signal_connect (priv->textView, "notify::scale-factor", G_CALLBACK (markdown_browser_scale_factor_changed), browser);
+  g_signal_connect_object (gtk_icon_theme_get_default (), "changed", G_CALLBACK (markdown_browser_icon_theme_changed),
+                           browser, 0);
+  g_signal_connect_after (priv->textView, "map", G_CALLBACK (markdown_browser_text_view_map_changed), browser);
+  g_signal_connect_after (priv->textView, "unmap", G_CALLBACK (markdown_browser_text_view_map_changed), browser);
+
+  priv->prevSectionBtn = GTK_WIDGET (gtk_builder_get_object (priv->builder, "PrevSectionBtn"));
+  priv->nextSectionBtn = GTK_WIDGET (gtk_builder_get_object (priv->builder, "NextSectionBtn"));
+  markdown_browser_update_section_buttons (browser);
 
   // Hide home button if home topic is NULL
   if (!priv->homeTopic)
@@ -368,26 +663,28 @@ markdown_browser_constructed (GObject *object)
 
   gtk_widget_show (GTK_WIDGET (browser));
 
-  tagTable = GTK_TEXT_TAG_TABLE (gtk_builder_get_object (priv->builder, "TagTable"));
+  priv->tagTable = GTK_TEXT_TAG_TABLE (gtk_builder_get_object (priv->builder, "TagTable"));
 
   // Populate tags array
   for (i = 0; i < MARKDOWN_BROWSER_TAG_COUNT; i++)
-    priv->tags[i] = gtk_text_tag_table_lookup (tagTable, markdown_browser_tag_names[i]);
+    priv->tags[i] = gtk_text_tag_table_lookup (priv->tagTable, markdown_browser_tag_names[i]);
 }
 
 static void
 markdown_browser_key_press_event (MarkdownBrowser *browser, GdkEventKey *keyEvent, gpointer user_data)
 {
-  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-
   if ((keyEvent->state & GDK_MODIFIER_MASK) == GDK_MOD1_MASK)
   {
     if (keyEvent->keyval == GDK_KEY_Left)
-      markdown_browser_navigate (browser, -1, 0);
+      markdown_browser_navigate_async (browser, -1, 0, NULL, NULL, NULL);
     else if (keyEvent->keyval == GDK_KEY_Right)
-      markdown_browser_navigate (browser, 1, 0);
-    else if (keyEvent->keyval == GDK_KEY_Home && priv->homeTopic)
-      markdown_browser_navigate_to_topic_by_name (browser, priv->homeTopic);
+      markdown_browser_navigate_async (browser, 1, 0, NULL, NULL, NULL);
+    else if (keyEvent->keyval == GDK_KEY_Home)
+      markdown_browser_navigate_home (browser);
+    else if (keyEvent->keyval == GDK_KEY_Page_Up)
+      markdown_browser_prev_section_clicked (NULL, browser);
+    else if (keyEvent->keyval == GDK_KEY_Page_Down)
+      markdown_browser_next_section_clicked (NULL, browser);
   }
 }
 
@@ -408,8 +705,115 @@ markdown_browser_text_view_size_allocate (GtkTextView *textView, GdkRectangle *r
     if (mark)
       gtk_text_view_scroll_to_mark (priv->textView, mark, 0.0, TRUE, 0.5, 0.0);
 
-    priv->scrollToLine = TRUE;
+    priv->scrollToLine = FALSE;
+  }
+
+  markdown_browser_load_visible_images (browser);
+}
+
+static void
+markdown_browser_vadjustment_changed (GtkAdjustment *adjustment, MarkdownBrowser *browser)
+{
+  markdown_browser_load_visible_images (browser);
+}
+
+// Rendered buffers have images decoded for the old scale factor
+static void
+markdown_browser_scale_factor_changed (GObject *object, GParamSpec *pspec, MarkdownBrowser *browser)
+{
+  markdown_browser_render_cancel (browser);
+  markdown_browser_render_cache_trim (browser, 0);
+  markdown_browser_refresh_topic (browser);
+}
+
+// Free an icon cache value, NULL for icons which were not found
+static void
+markdown_browser_icon_cache_value_free (gpointer pixbuf)
+{
+  if (pixbuf)
+    g_object_unref (pixbuf);                            // -- unref pixbuf
+}
+
+// Clear the icon cache of an icon theme, connected to its "changed" signal when the cache is created
+static void
+markdown_browser_icon_cache_clear (GtkIconTheme *iconTheme, gpointer user_data)
+{
+  GHashTable *iconCache;
+
+  if ((iconCache = g_object_get_data (G_OBJECT (iconTheme), "markdown-browser-icon-cache")))
+    g_hash_table_remove_all (iconCache);
+}
+
+// Load an icon from the icon cache of an icon theme, looking it up on a miss.  The cache is shared by all browsers.
+static GdkPixbuf *
+markdown_browser_icon_cache_load (GtkIconTheme *iconTheme, const char *name, int size, int scale)     // ++ ref shared pixbuf
+{
+  GHashTable *iconCache;
+  GdkPixbuf *pixbuf;
+  char *key;
+
+  if (!(iconCache = g_object_get_data (G_OBJECT (iconTheme), "markdown-browser-icon-cache")))
+  { // Icon name, size and scale -> pixbuf or NULL if not found
+    iconCache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,              // ++ new hash table
+                                       markdown_browser_icon_cache_value_free);
+    g_object_set_data_full (G_OBJECT (iconTheme), "markdown-browser-icon-cache", iconCache,  // !! takes over hash table
+                            (GDestroyNotify)g_hash_table_unref);
+    g_signal_connect (iconTheme, "changed", G_CALLBACK (markdown_browser_icon_cache_clear), NULL);
+  }
+
+  key = g_strdup_printf ("%s\n%d\n%d", name, size, scale);      // ++ alloc key
+
+  if (g_hash_table_lookup_extended (iconCache, key, NULL, (gpointer *)&pixbuf))
+  {
+    g_free (key);                                       // -- free key
+    return pixbuf ? g_object_ref (pixbuf) : NULL;       // ++ ref pixbuf
+  }
+
+  pixbuf = gtk_icon_theme_load_icon_for_scale (iconTheme, name, size, scale, 0, NULL);     // ++ new pixbuf
+  g_hash_table_insert (iconCache, key, pixbuf ? g_object_ref (pixbuf) : NULL);  // !! takes over key, ++ ref pixbuf
+
+  return pixbuf;
+}
+
+// Idle callback to render the displayed topic again after an icon theme change
+static gboolean
+markdown_browser_icon_refresh_idle (gpointer data)
+{
+  MarkdownBrowser *browser = MARKDOWN_BROWSER (data);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  priv->iconRefreshId = 0;
+  markdown_browser_refresh_topic (browser);
+
+  return FALSE;
+}
+
+// Drop rendered buffers which use icons, the displayed one is rendered again once the icon cache was cleared
+static void
+markdown_browser_icon_theme_changed (GtkIconTheme *iconTheme, MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserCachedBuffer *cached;
+  GList *link, *next;
+
+  if (priv->renderJob && g_object_get_data (G_OBJECT (priv->renderJob->textBuf), "uses-icons"))
+    markdown_browser_render_cancel (browser);
+
+  for (link = priv->renderCache->head; link; link = next)
+  {
+    next = link->next;
+    cached = link->data;
+
+    if (g_object_get_data (G_OBJECT (cached->buffer), "uses-icons"))
+    {
+      g_queue_delete_link (priv->renderCache, link);
+      g_object_unref (cached->buffer);                  // -- unref cached text buffer
+      g_slice_free (MarkdownBrowserCachedBuffer, cached);       // -- free cache entry
+    }
   }
+
+  if (g_object_get_data (G_OBJECT (priv->textBuffer), "uses-icons") && !priv->iconRefreshId)
+    priv->iconRefreshId = g_idle_add (markdown_browser_icon_refresh_idle, browser);
 }
 
 static gboolean
@@ -467,7 +871,6 @@ markdown_browser_text_view_query_tooltip (GtkTextView *textView, int x, int y, g
                                           GtkTooltip *tooltip, MarkdownBrowser *browser)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  GdkPixbuf *pixbuf;
   GtkTextIter iter;
   GSList *marks, *p;
   char *link;
@@ -480,10 +883,20 @@ markdown_browser_text_view_query_tooltip (GtkTextView *textView, int x, int y, g
   // Get a buffer iterator at motion position and check if cursor on text
   if (gtk_text_view_get_iter_at_location (textView, &iter, bufx, bufy))
   { // Is this an image?
-    if ((pixbuf = gtk_text_iter_get_pixbuf (&iter)) && (alt = g_object_get_data (G_OBJECT (pixbuf), "alt")))
+    if (gtk_text_iter_get_pixbuf (&iter))
     {
-      gtk_tooltip_set_text (tooltip, alt);
-      return TRUE;
+      marks = gtk_text_iter_get_marks (&iter);          // ++ allocate list of marks
+
+      for (p = marks, alt = NULL; p && !alt; p = p->next)
+        alt = g_object_get_data (G_OBJECT (p->data), "alt");
+
+      g_slist_free (marks);                             // -- free list of marks
+
+      if (alt)
+      {
+        gtk_tooltip_set_text (tooltip, alt);
+        return TRUE;
+      }
     }
     else if (gtk_text_iter_has_tag (&iter, priv->tags[MARKDOWN_BROWSER_TAG_LINK]))
     { // If position is already at the beginning of link tag or the beginning of the link tag is found..
@@ -522,7 +935,7 @@ markdown_browser_text_view_button_press (GtkTextView *textView, GdkEventButton *
   GtkTextIter iter;
   GSList *marks, *p;
   char *link;
-  int x, y, topic;
+  int x, y;
 
   // Convert window coordinates of motion position to buffer coordinates
   gtk_text_view_window_to_buffer_coords (textView, GTK_TEXT_WINDOW_TEXT,
@@ -551,8 +964,7 @@ markdown_browser_text_view_button_press (GtkTextView *textView, GdkEventButton *
                 g_clear_error (&err);
               }
             }
-            else if ((topic = markdown_browser_get_topic_by_name (browser, link)) != -1)          // Local URI
-              markdown_browser_navigate (browser, 0, topic);
+            else markdown_browser_navigate_to_link (browser, link);     // Local URI
 
             g_slist_free (marks);                       // -- free list of marks
             return TRUE;        // We handled this event
@@ -583,12 +995,15 @@ markdown_browser_set_property (GObject *object, guint property_id,
     case PROP_IMAGES_PATH:
       g_free (priv->imagesPath);
       priv->imagesPath = g_value_dup_string (value);
+      markdown_browser_render_cache_trim (browser, 0);  // Rendered images are no longer valid
       break;
     case PROP_TOPIC_INDEX:
-      markdown_browser_real_navigate (browser, 0, g_value_get_int (value));
+      priv->navigateSerial++;   // Supersede any pending async navigation
+      markdown_browser_real_navigate (browser, 0, g_value_get_int (value), 0);
       break;
     case PROP_HISTORY_POSITION:
-      markdown_browser_real_navigate (browser, g_value_get_int (value), MARKDOWN_BROWSER_TOPIC_NONE);
+      priv->navigateSerial++;
+      markdown_browser_real_navigate (browser, g_value_get_int (value), MARKDOWN_BROWSER_TOPIC_NONE, 0);
       break;
     case PROP_HISTORY_MAX:
       priv->historyMax = g_value_get_int (value);
@@ -596,11 +1011,46 @@ markdown_browser_set_property (GObject *object, guint property_id,
     case PROP_BULLET_CHARS:
       g_free (priv->bulletChars);
       priv->bulletChars = g_value_dup_string (value);
+      markdown_browser_update_bullets (priv);
+      markdown_browser_render_cache_trim (browser, 0);  // Rendered bullets are no longer valid
       break;
     case PROP_HOME_TOPIC:
       g_free (priv->homeTopic);
       priv->homeTopic = g_value_dup_string (value);
       break;
+    case PROP_RENDER_CACHE_SIZE:
+      priv->renderCacheSize = g_value_get_int (value);
+      markdown_browser_render_cache_trim (browser, priv->renderCacheSize);
+      break;
+    case PROP_RENDER_DEADLINE:
+      priv->renderDeadline = g_value_get_int (value);
+      break;
+    case PROP_PAGINATE_LEVEL:
+      priv->paginateLevel = g_value_get_int (value);
+
+      // Rendered buffers are no longer valid, show current topic from the start (history sections get clamped)
+      markdown_browser_render_cancel (browser);
+      markdown_browser_render_cache_trim (browser, 0);
+
+      if (priv->textView)
+      {
+        markdown_browser_show_topic (browser, priv->topicIndex, 0, 0);
+        markdown_browser_update_section_buttons (browser);
+      }
+      break;
+    case PROP_LAZY_LOAD:
+      priv->lazyLoad = g_value_get_boolean (value);
+      break;
+    case PROP_CONTENT_BUDGET:
+      priv->contentBudget = g_value_get_int (value);
+      markdown_browser_topics_trim (browser, NULL);
+      break;
+    case PROP_RECURSIVE:
+      priv->recursive = g_value_get_boolean (value);
+      break;
+    case PROP_WATCH:
+      priv->watch = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -640,6 +1090,33 @@ markdown_browser_get_property (GObject *object, guint property_id,
     case PROP_HOME_TOPIC:
       g_value_set_string (value, priv->homeTopic);
       break;
+    case PROP_RENDER_CACHE_SIZE:
+      g_value_set_int (value, priv->renderCacheSize);
+      break;
+    case PROP_RENDER_DEADLINE:
+      g_value_set_int (value, priv->renderDeadline);
+      break;
+    case PROP_PAGINATE_LEVEL:
+      g_value_set_int (value, priv->paginateLevel);
+      break;
+    case PROP_SECTION:
+      g_value_set_int (value, priv->section);
+      break;
+    case PROP_SECTION_COUNT:
+      g_value_set_int (value, priv->topicIndex >= 0 ? priv->sections->len : 0);
+      break;
+    case PROP_LAZY_LOAD:
+      g_value_set_boolean (value, priv->lazyLoad);
+      break;
+    case PROP_CONTENT_BUDGET:
+      g_value_set_int (value, priv->contentBudget);
+      break;
+    case PROP_RECURSIVE:
+      g_value_set_boolean (value, priv->recursive);
+      break;
+    case PROP_WATCH:
+      g_value_set_boolean (value, priv->watch);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -651,809 +1128,3044 @@ markdown_browser_topic_selection_changed (GtkTreeSelection *selection, gpointer
 {
   MarkdownBrowser *browser = MARKDOWN_BROWSER (user_data);
   GtkTreeModel *model;
+  GtkTreePath *path;
   GtkTreeIter iter;
-  guint index;
+  int index;
 
   if (gtk_tree_selection_get_selected (selection, &model, &iter))
   {
     gtk_tree_model_get (model, &iter, TOPIC_COLUMN_INDEX, &index, -1);
 
+    if (index < 0)      // Directory row?  Expand it.
+    {
+      path = gtk_tree_model_get_path (model, &iter);   // ++ alloc path
+      gtk_tree_view_expand_row (gtk_tree_selection_get_tree_view (selection), path, FALSE);
+      gtk_tree_path_free (path);                        // -- free path
+      return;
+    }
+
     g_signal_handlers_block_by_func (G_OBJECT (selection), markdown_browser_topic_selection_changed, user_data);
-    markdown_browser_navigate (browser, 0, index);
+    markdown_browser_navigate_async (browser, 0, index, NULL, NULL, NULL);
     g_signal_handlers_unblock_by_func (G_OBJECT (selection), markdown_browser_topic_selection_changed, user_data);
   }
 }
 
-// Markdown parse bag (for passing between functions)
-typedef struct
+// Insert the pending text run into the content buffer with all the tags of its span style at once
+static void
+markdown_browser_buffer_flush (MarkdownBrowserRenderBag *bag)
 {
-  MarkdownBrowserPrivate *priv;
-  GtkTextBuffer *textBuf;       // The text content buffer
-  GtkTextIter iter;             // GtkTextBuffer append iterator
+  MarkdownBrowserPrivate *priv = bag->priv;
+  guint style = bag->runStyle;
+  GtkTextTag *tags[5] = { NULL };
+  int count = 0;
+
+  if (bag->run->len == 0)
+    return;
+
+  // List tag for the level (accumulative)
+  if (MARKDOWN_BROWSER_STYLE_LIST (style) > 0)
+    tags[count++] = priv->tags[MARKDOWN_BROWSER_TAG_L1 + MARKDOWN_BROWSER_STYLE_LIST (style) - 1];
+
+  // Header tag
+  if (MARKDOWN_BROWSER_STYLE_HEADER (style) > 0)
+    tags[count++] = priv->tags[MARKDOWN_BROWSER_TAG_H1 + MARKDOWN_BROWSER_STYLE_HEADER (style) - 1];
 
-  GMatchInfo *nextRegexMatch[REGEX_COUNT];      // Match info for next match for each regular expression or NULL if no matches remaining
+  if (style & MARKDOWN_BROWSER_STYLE_ITALIC)
+    tags[count++] = priv->tags[MARKDOWN_BROWSER_TAG_ITALIC];
 
-  gboolean listItem;            // TRUE if currently in a list item
-  int listLevel;                // Current list level (0=none)
-  gboolean isBullet;            // TRUE if currently appending bullet or number for list item
-  guint8 listSpacing[MAX_LIST_LEVELS];          // Number of spaces used for each level
-  guint8 numListCounts[MAX_LIST_LEVELS];        // Current counts for numbered list levels ([0] == 0 if unnumbered list or no list active)
+  if (style & MARKDOWN_BROWSER_STYLE_BOLD)
+    tags[count++] = priv->tags[MARKDOWN_BROWSER_TAG_BOLD];
 
-  int headerSize;               // Current header size (0 for none)
-  gboolean italic;              // True if italic active
-  gboolean bold;                // True if bold active
-  gboolean link;                // True if link active
-} MarkdownBrowserParseBag;
+  if (style & MARKDOWN_BROWSER_STYLE_LINK)
+    tags[count++] = priv->tags[MARKDOWN_BROWSER_TAG_LINK];
 
+  // Tag list is NULL terminated by the first unused entry
+  gtk_text_buffer_insert_with_tags (bag->textBuf, &bag->iter, bag->run->str, bag->run->len,
+                                    tags[0], tags[1], tags[2], tags[3], tags[4], NULL);
+  g_string_truncate (bag->run, 0);
+}
+
+#ifdef DEBUG
+// Insert text into the content buffer and apply each tag of a span style to it separately, like the renderer did
+// before text runs were coalesced (see markdown_browser_set_coalesce_runs(), for comparing the two in benchmarks)
 static void
-markdown_browser_buffer_append (MarkdownBrowserParseBag *bag, const char *string, int len)
+markdown_browser_buffer_insert_span (MarkdownBrowserRenderBag *bag, const char *string, int len, guint style)
 {
+  MarkdownBrowserPrivate *priv = bag->priv;
+  GtkTextBuffer *textBuf = bag->textBuf;
+  GtkTextIter *iter = &bag->iter;
   GtkTextIter start;
-  char *unescaped = NULL, *dest = NULL;
-  const char *src, *prev, *end;
-  int startOfs, count;
+  int startOfs;
 
-  if (len == -1)
-    len = strlen (string);
+  // Append string to text buffer and get a start iterator to apply tags to
+  startOfs = gtk_text_iter_get_offset (iter);
+  gtk_text_buffer_insert (textBuf, iter, string, len);
+  gtk_text_buffer_get_iter_at_offset (textBuf, &start, startOfs);
 
-  end = string + len;
+  // Apply list tag for each level (accumulative)
+  if (MARKDOWN_BROWSER_STYLE_LIST (style) > 0)
+    gtk_text_buffer_apply_tag (textBuf, priv->tags[MARKDOWN_BROWSER_TAG_L1 + MARKDOWN_BROWSER_STYLE_LIST (style) - 1],
+                               &start, iter);
+  // Apply header tag
+  if (MARKDOWN_BROWSER_STYLE_HEADER (style) > 0)
+    gtk_text_buffer_apply_tag (textBuf, priv->tags[MARKDOWN_BROWSER_TAG_H1 + MARKDOWN_BROWSER_STYLE_HEADER (style) - 1],
+                               &start, iter);
+  // Italic
+  if (style & MARKDOWN_BROWSER_STYLE_ITALIC)
+    gtk_text_buffer_apply_tag (textBuf, priv->tags[MARKDOWN_BROWSER_TAG_ITALIC], &start, iter);
 
-  // Unescape string (optimize case where no escaping occurs)
-  for (src = prev = string; src < end; )
-  { // Is this a backslash and next char is a valid character to escape?
-    if (*src == '\\' && strchr (valid_escaped_chars, src[1]))
-    {
-      if (!unescaped)
-      {
-        unescaped = g_malloc (len + 1);
-        dest = unescaped;
-      }
+  // Bold
+  if (style & MARKDOWN_BROWSER_STYLE_BOLD)
+    gtk_text_buffer_apply_tag (textBuf, priv->tags[MARKDOWN_BROWSER_TAG_BOLD], &start, iter);
 
-      // Any previous string data to copy?
-      if (src > prev)
-      {
-        count = src - prev;
-        memcpy (dest, prev, count);
-        dest += count;
-      }
+  // Link
+  if (style & MARKDOWN_BROWSER_STYLE_LINK)
+    gtk_text_buffer_apply_tag (textBuf, priv->tags[MARKDOWN_BROWSER_TAG_LINK], &start, iter);
+}
+#endif
 
-      prev = src + 1;
-      src += 2;
-    }
-    else src = g_utf8_next_char (src);
+// Append text to the content buffer with the tags of a span style.  Text is accumulated into runs of the same style,
+// which are inserted when the style changes, to minimize the number of tag toggles in the text buffer.
+static void
+markdown_browser_buffer_append (MarkdownBrowserRenderBag *bag, const char *string, int len, guint style)
+{
+#ifdef DEBUG
+  if (!bag->priv->coalesceRuns)
+  {
+    markdown_browser_buffer_insert_span (bag, string, len, style);
+    return;
   }
+#endif
 
-  // Did any escaping occur?
-  if (unescaped)
+  if (style != bag->runStyle)
   {
-    if (src > prev)
-    {
-      count = src - prev;
-      memcpy (dest, prev, count);
-      dest += count;
-    }
-
-    string = unescaped;
-    len = dest - unescaped;
+    markdown_browser_buffer_flush (bag);
+    bag->runStyle = style;
   }
 
-  // Append string to text buffer and get a start iterator to apply tags to
-  startOfs = gtk_text_iter_get_offset (&bag->iter);
-  gtk_text_buffer_insert (bag->textBuf, &bag->iter, string, len);
-  gtk_text_buffer_get_iter_at_offset (bag->textBuf, &start, startOfs);
+  if (len < 0)
+    g_string_append (bag->run, string);
+  else g_string_append_len (bag->run, string, len);
+}
 
-  // Apply list tag for each level (accumulative)
-  if (bag->listItem)
-    gtk_text_buffer_apply_tag (bag->textBuf, bag->priv->tags[MARKDOWN_BROWSER_TAG_L1 + bag->listLevel - 1], &start, &bag->iter);
+// Assign a newly parsed document to a topic and notify if it exceeded the render deadline
+static void
+markdown_browser_topic_set_document (MarkdownBrowser *browser, MarkdownBrowserTopic *topic,
+                                     MarkdownBrowserDocument *doc)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
 
-  // Apply header tag
-  if (bag->headerSize > 0)
-    gtk_text_buffer_apply_tag (bag->textBuf, bag->priv->tags[MARKDOWN_BROWSER_TAG_H1 + bag->headerSize - 1],
-                               &start, &bag->iter);
-  // Italic
-  if (bag->italic)
-    gtk_text_buffer_apply_tag (bag->textBuf, bag->priv->tags[MARKDOWN_BROWSER_TAG_ITALIC], &start, &bag->iter);
+  markdown_browser_topic_info (priv, topic)->document = markdown_browser_document_ref (doc);   // ++ ref document (topic owns it)
 
-  // Bold
-  if (bag->bold)
-    gtk_text_buffer_apply_tag (bag->textBuf, bag->priv->tags[MARKDOWN_BROWSER_TAG_BOLD], &start, &bag->iter);
+  if (doc->timedOut)
+  {
+    g_warning ("Markdown topic '%s' exceeded render deadline, showing the rest as plain text", topic->name);
+    g_signal_emit (browser, markdown_browser_signals[RENDER_TIMEOUT], 0, topic->name);
+  }
+}
 
-  // Link
-  if (bag->link)
-    gtk_text_buffer_apply_tag (bag->textBuf, bag->priv->tags[MARKDOWN_BROWSER_TAG_LINK], &start, &bag->iter);
+// Read the file of a lazily loaded topic, returns NULL if it fails (callable from any thread)
+static char *
+markdown_browser_topic_read (const char *path, GError **err)
+{
+  GError *local_err = NULL;
+  char *content;
+
+  if (!g_file_get_contents (path, &content, NULL, &local_err))         // ++ alloc content
+  {
+    g_warning ("Failed to load markdown file '%s': %s", path, local_err->message);
+    g_propagate_error (err, local_err);
+    return NULL;
+  }
 
-  if (unescaped)
-    g_free (unescaped);
+  return content;
 }
 
+// Update the memory usage accounted to a lazily loaded topic
 static void
-markdown_browser_render_topic (MarkdownBrowser *browser, MarkdownBrowserTopic *topic)
+markdown_browser_topic_charge (MarkdownBrowser *browser, MarkdownBrowserTopic *topic)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  MarkdownBrowserParseBag bag = { 0 };
-  GMatchInfo *matchInfo, *nextMatchInfo;
-  GtkTextIter endIter;
-  GtkTextMark *mark;
-  MarkdownBrowserRegexEnum nextRegexEnum;      // Enum of next match
-  int startPos, endPos;
-  int nextMatchPos;                     // Next position in content of a regular expression match
-  const char *content;
-  int contentLen;
-  int contentPos;               // Current content position
-  gboolean newLevel;
-  GError *err = NULL;
-  MarkdownBrowserRegexEnum regexEnum;
-  int spaceCount, count, i;
-  char *s;
+  MarkdownBrowserTopicInfo *info = markdown_browser_topic_info (priv, topic);
+  gsize size = 0;
 
-  // Clear out text buffer contents and get end iterator to append content
-  gtk_text_buffer_get_bounds (priv->textBuffer, &bag.iter, &endIter);
-  gtk_text_buffer_delete (priv->textBuffer, &bag.iter, &endIter);
-  gtk_text_buffer_get_end_iter (priv->textBuffer, &bag.iter);
-
-  if (topic == NULL)
+  if (!info->path)
     return;
 
-  bag.priv = priv;
-  bag.textBuf = priv->textBuffer;
+  if (topic->content)
+    size += strlen (topic->content);
+
+  if (info->document)
+    size += info->document->textLen + info->document->spanCount * sizeof (MarkdownBrowserSpan);
 
-  content = topic->content;
-  contentLen = strlen (content);
+  priv->lazyBytes = priv->lazyBytes - info->size + size;
+  info->size = size;
+}
 
-  nextMatchPos = contentLen;
-  nextMatchInfo = NULL;
+// Unload content and documents of least recently used lazily loaded topics until within the content budget.
+// The current topic, topics being parsed and the topic in use (can be NULL) are kept.
+static void
+markdown_browser_topics_trim (MarkdownBrowser *browser, MarkdownBrowserTopic *inUse)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo *info, *oldestInfo = NULL;
+  MarkdownBrowserTopic *topic, *oldest;
+  int i;
 
-  // Initialize nextRegexPosition array with first matches of each regular expression and find first match position
-  for (regexEnum = 0; regexEnum < REGEX_FIRST_END_MATCH; regexEnum++)
+  while (priv->lazyBytes > priv->contentBudget)
   {
-    if (g_regex_match (regexes[regexEnum], content, 0, &matchInfo))     // ++ allocate match info
+    oldest = NULL;
+
+    for (i = 0; i < priv->topics->len; i++)
     {
-      bag.nextRegexMatch[regexEnum] = matchInfo;                        // !! nextRegexMatch array takes over match info
-      g_match_info_fetch_pos (matchInfo, 0, &startPos, NULL);
+      topic = &g_array_index (priv->topics, MarkdownBrowserTopic, i);
+      info = &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, i);
+
+      if (info->size == 0 || topic == inUse || info->pinCount > 0 || i == priv->topicIndex)
+        continue;
 
-      if (startPos < nextMatchPos)
+      if (!oldest || info->lastUsed < oldestInfo->lastUsed)
       {
-        nextMatchInfo = matchInfo;
-        nextMatchPos = startPos;
-        nextRegexEnum = regexEnum;
+        oldest = topic;
+        oldestInfo = info;
       }
     }
-    else g_match_info_free (matchInfo);         // -- free match info
-  }
 
-  // No matches?  Just append the entire content
-  if (!nextMatchInfo)
-  {
-    gtk_text_buffer_insert (priv->textBuffer, &bag.iter, content, contentLen);
-    return;
+    if (!oldest)
+      break;
+
+    // Rendered buffers and render jobs hold their own document references
+    g_clear_pointer (&oldest->content, g_free);
+    g_clear_pointer (&oldestInfo->document, markdown_browser_document_unref);
+    priv->lazyBytes -= oldestInfo->size;
+    oldestInfo->size = 0;
   }
+}
 
-  contentPos = 0;
+// Mark a topic as most recently used and load its content if it is lazily loaded and not loaded (content stays NULL
+// if loading fails)
+static void
+markdown_browser_topic_use (MarkdownBrowser *browser, MarkdownBrowserTopic *topic)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo *info = markdown_browser_topic_info (priv, topic);
 
-  // Process content and convert Markdown to GtkTextBuffer
-  while (contentPos < contentLen)
-  { // Any content prior to next match? - Append it
-    if (nextMatchPos > contentPos)
-      markdown_browser_buffer_append (&bag, content + contentPos, nextMatchPos - contentPos);
+  info->lastUsed = ++priv->topicUseSerial;
 
-    switch (nextRegexEnum)
-    {
-      case REGEX_EMPHASIS_START:
-        g_match_info_fetch_pos (nextMatchInfo, 1, &startPos, &endPos);         // Get start/end position of emphasis chars
-        count = endPos - startPos;
-        bag.italic |= (count & 1) ? 1 : 0;      // 1 or 3 * or _ characters enables italic
-        bag.bold |= (count & 2) ? 1 : 0;        // 2 or 3 * or _ characters enables bold
-        break;
-      case REGEX_HEADER_START:
-        g_match_info_fetch_pos (nextMatchInfo, 1, &startPos, &endPos);         // Get start/end position of header chars
-        bag.headerSize = endPos - startPos;     // Count header characters
-        break;
-      case REGEX_BULLET_ITEM_START:
-      case REGEX_NUMERIC_ITEM_START:
-        g_match_info_fetch_pos (nextMatchInfo, 1, &startPos, &endPos);         // Get start/end position of space chars
-        spaceCount = endPos - startPos;
+  if (!topic->content && info->path)
+  {
+    if (!(topic->content = markdown_browser_topic_read (info->path, NULL)))    // ++ alloc content (topic owns it)
+      return;
 
-        // Too many spaces for first level item?
-        if (bag.listLevel == 0 && spaceCount > MAX_FIRST_LEVEL_SPACES)
-          break;
+    markdown_browser_topic_charge (browser, topic);
+    markdown_browser_topics_trim (browser, topic);
+  }
+}
 
-        bag.listItem = TRUE;
+// Parse topic content into a document (safe to call from any thread).  The documents of topics from files (cached) are
+// loaded from or saved to the on-disk parse cache by content hash (computed if hash is NULL).
+static MarkdownBrowserDocument *
+markdown_browser_parse_content (const char *content, int len, int timeLimit, gboolean cached, const char *hash)
+{
+  MarkdownBrowserDocument *doc;
+  char *contentHash = NULL;
 
-        if (bag.listLevel > 0)
-        { // Loop over levels looking for matching spacing
-          for (i = 0; i < bag.listLevel - 1; i++)
-            if (spaceCount - bag.listSpacing[i] < bag.listSpacing[i + 1] - spaceCount)
-              break;
+  if (!cached || markdown_browser_parse_cache_get_budget () == 0)
+    return markdown_browser_document_new (content, len, timeLimit);    // ++ new document
 
-          newLevel = (i == bag.listLevel - 1 && spaceCount >= bag.listSpacing[i] + MIN_LEVEL_SPACING
-                      && bag.listLevel < MAX_LIST_LEVELS);
+  if (!hash)
+    hash = contentHash = markdown_browser_parse_cache_hash (content, len);     // ++ alloc content hash
 
-          if (!newLevel)
-            bag.listLevel = i + 1;
-        }
-        else newLevel = TRUE;
-
-        // Is this a new level?
-        if (newLevel)
-        {
-          bag.listSpacing[bag.listLevel] = spaceCount;
-          bag.numListCounts[bag.listLevel] = 0;
-          bag.listLevel++;
-        }
+  if (!(doc = markdown_browser_parse_cache_lookup (hash)))             // ++ new document
+  {
+    doc = markdown_browser_document_new (content, len, timeLimit);     // ++ new document
+    markdown_browser_parse_cache_save (hash, doc);
+  }
 
-        bag.isBullet = TRUE;
+  g_free (contentHash);                                 // -- free content hash
 
-        // Bullet list?
-        if (nextRegexEnum == REGEX_BULLET_ITEM_START)
-        { // Append bullet character, taking into account UTF-8 characters
-          if (priv->bulletChars && (i = g_utf8_strlen (priv->bulletChars, -1)) > 0)
-          {
-            if (i > bag.listLevel)
-              i = bag.listLevel;
+  return doc;
+}
 
-            s = g_utf8_offset_to_pointer (priv->bulletChars, i - 1);
-            s = g_strdup_printf ("%.*s ", (int)(g_utf8_find_next_char (s, NULL) - s), s);        // ++ alloc bullet string and space
-            markdown_browser_buffer_append (&bag, s, -1);
-            g_free (s);         // -- free bullet string
-          }
-        }
-        else    // Numeric list
-        {
-          bag.numListCounts[bag.listLevel - 1]++;
+// Get the parsed document of a topic, parsing the content if it hasn't been already.  A topic whose file failed to load
+// gets the empty document, which is not kept, so loading is tried again next time.
+static MarkdownBrowserDocument *
+markdown_browser_topic_get_document (MarkdownBrowser *browser, MarkdownBrowserTopic *topic)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo *info = markdown_browser_topic_info (priv, topic);
+  MarkdownBrowserDocument *doc;
 
-          s = g_strdup_printf ("%d. ", bag.numListCounts[bag.listLevel - 1]);   // ++ allocate number string
-          markdown_browser_buffer_append (&bag, s, -1);
-          g_free (s);           // -- free number string
-        }
+  markdown_browser_topic_use (browser, topic);
 
-        bag.isBullet = FALSE;
+  if (!info->document && info->bundle)         // Uses the parsed spans in the mapped bundle, nothing to parse
+  {
+    if (!(doc = markdown_browser_bundle_get_document (info->bundle, info->bundleIndex)))      // ++ new document
+    {
+      g_warning ("Help bundle topic '%s' is corrupt", topic->name);
+      doc = markdown_browser_document_new ("", 0, 0);                                         // ++ new document
+    }
 
-        break;
-      case REGEX_IMAGE:
-      {
-        char *basename, *imageName;
-        GdkPixbuf *pixbuf;
-        char **fields;
-        int size;
+    markdown_browser_topic_set_document (browser, topic, doc);
+    markdown_browser_document_unref (doc);              // -- unref document
+  }
+  else if (!info->document && !topic->content)
+    return priv->emptyDocument;
+  else if (!info->document)
+  {
+    doc = markdown_browser_parse_content (topic->content, markdown_browser_topic_content_len (info),  // ++ new document
+                                          priv->renderDeadline, info->hash || info->path, info->hash);
+    markdown_browser_topic_set_document (browser, topic, doc);
+    markdown_browser_document_unref (doc);              // -- unref document
 
-        imageName = g_match_info_fetch (nextMatchInfo, 2);      // ++ allocate image name
+    markdown_browser_topic_charge (browser, topic);
+    markdown_browser_topics_trim (browser, topic);
+  }
 
-        // Request for an icon?
-        if (g_str_has_prefix (imageName, "icon:"))
-        { // Split icon name into fields
-          fields = g_strsplit (imageName, ":", -1);     // ++ allocate array of string fields
-          count = g_strv_length (fields);
+  return info->document;
+}
 
-          // Was size provided?
-          if (count > 2)
-          {
-            size = strtol (fields[1], &s, 10);
+// Free the anchored image data of a child anchor
+static void
+markdown_browser_anchored_image_free (MarkdownBrowserAnchoredImage *image)
+{
+  g_free (image->filename);                             // -- free file name
+  g_clear_object (&image->pixbuf);                      // -- unref pixbuf
+  g_clear_object (&image->animation);                   // -- unref animation
+  g_clear_object (&image->animationIter);               // -- unref animation iterator
+  g_clear_object (&image->cancellable);                 // -- unref cancellable
+  g_slice_free (MarkdownBrowserAnchoredImage, image);
+}
 
-            if (*s || size < 8 || size > 1024)
-              size = DEFAULT_ICON_SIZE;
-          }
-          else size = DEFAULT_ICON_SIZE;
+// Text buffer destroy notify of its anchored images array, cancels decodes in progress
+static void
+markdown_browser_anchored_images_free (GPtrArray *anchoredImages)
+{
+  MarkdownBrowserAnchoredImage *image;
+  guint i;
 
-          // FIXME - Might want to attach to Widget::style-set signal to update icon after theme changes (as per docs for this function)
-          pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (), fields[count - 1], size, 0, NULL);      // ++ new pixbuf image
+  for (i = 0; i < anchoredImages->len; i++)
+  {
+    image = g_object_get_data (G_OBJECT (g_ptr_array_index (anchoredImages, i)), "image");
+    image->buffer = NULL;
 
-          g_strfreev (fields);          // -- free array of string fields
-        }
-        else
-        { // Strip off path component of image name for potential security issue if content not trusted
-          basename = g_path_get_basename (imageName);     // ++ allocate basename
+    if (image->cancellable)
+      g_cancellable_cancel (image->cancellable);
+  }
 
-          s = g_build_filename (priv->imagesPath, basename, NULL);        // ++ allocate image file name
-          g_free (basename);                              // -- free basename
+  g_ptr_array_free (anchoredImages, TRUE);              // -- free array and unref anchors
+}
 
-          pixbuf = gdk_pixbuf_new_from_file (s, &err);    // ++ new pixbuf image
+// Insert a child anchor for an image.  If the image is not decoded yet, the text view shows a placeholder widget
+// with the size of the image, which is decoded asynchronously once it nears the visible area.
+static void
+markdown_browser_render_anchored_image (MarkdownBrowserRenderBag *bag, MarkdownBrowserAnchoredImage *image)    // !! takes over image
+{
+  GtkTextChildAnchor *anchor;
+  GPtrArray *anchoredImages;
 
-          if (!pixbuf)
-          {
-            g_warning ("Failed to load image file '%s': %s", s, err->message);
-            g_clear_error (&err);
+  if (!(anchoredImages = g_object_get_data (G_OBJECT (bag->textBuf), "anchored-images")))
+  {
+    anchoredImages = g_ptr_array_new_with_free_func (g_object_unref);         // ++ alloc image anchor array
+    g_object_set_data_full (G_OBJECT (bag->textBuf), "anchored-images", anchoredImages,      // !! takes over array
+                            (GDestroyNotify)markdown_browser_anchored_images_free);
+  }
 
-            pixbuf = gtk_icon_theme_load_icon (gtk_icon_theme_get_default (), "image-missing",  // ++ new pixbuf image
-                                               DEFAULT_ICON_SIZE, 0, NULL);
-          }
+  anchor = gtk_text_buffer_create_child_anchor (bag->textBuf, &bag->iter);
 
-          g_free (s);           // -- free image file name
-        }
+  image->buffer = bag->textBuf;
+  g_object_set_data_full (G_OBJECT (anchor), "image", image,           // !! takes over image
+                          (GDestroyNotify)markdown_browser_anchored_image_free);
+  g_ptr_array_add (anchoredImages, g_object_ref (anchor));             // ++ ref anchor
+}
 
-        g_free (imageName);     // -- free image name
+// Create the widget of an anchored image, the decoded image at device resolution or a placeholder
+static GtkWidget *
+markdown_browser_anchored_image_widget (MarkdownBrowserAnchoredImage *image)
+{
+  cairo_surface_t *surface;
+  GtkWidget *widget;
 
-        // Insert the pixbuf and update current iterator
-        if (pixbuf)
-        { // Add marker for image alt tooltip
-          s = g_match_info_fetch (nextMatchInfo, 1);    // ++ allocate image alt text
+  if (image->pixbuf)
+  {
+    surface = gdk_cairo_surface_create_from_pixbuf (image->pixbuf, image->scale, NULL);   // ++ new surface
+    widget = gtk_image_new_from_surface (surface);
+    cairo_surface_destroy (surface);                    // -- destroy surface
+  }
+  else if (image->animation)    // Current frame
+    widget = gtk_image_new_from_pixbuf (image->animationIter ? gdk_pixbuf_animation_iter_get_pixbuf (image->animationIter)
+                                        : gdk_pixbuf_animation_get_static_image (image->animation));
+  else widget = gtk_image_new_from_icon_name ("image-loading", GTK_ICON_SIZE_DIALOG);
 
-          if (strlen (s) > 0)
-            g_object_set_data_full (G_OBJECT (pixbuf), "alt", s, g_free);
-          else g_free (s);      // -- Free empty alt text
+  gtk_widget_set_size_request (widget, image->width, image->height);
 
-          // Insert the pixbuf
-          gtk_text_buffer_insert_pixbuf (priv->textBuffer, &bag.iter, pixbuf);
-          g_object_unref (pixbuf);              // -- unref pixbuf
-        }
+  if (image->alt)
+    gtk_widget_set_tooltip_text (widget, image->alt);
+
+  return widget;
+}
+
+// Add widgets for the image anchors of the displayed text buffer which don't have one yet.
+// The text view destroys anchored widgets when its buffer is changed.
+static void
+markdown_browser_attach_image_widgets (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GtkTextChildAnchor *anchor;
+  GPtrArray *anchoredImages;
+  GtkWidget *widget;
+  GList *widgets;
+  guint i;
+
+  if (!(anchoredImages = g_object_get_data (G_OBJECT (priv->textBuffer), "anchored-images")))
+    return;
+
+  for (i = 0; i < anchoredImages->len; i++)
+  {
+    anchor = g_ptr_array_index (anchoredImages, i);
+    widgets = gtk_text_child_anchor_get_widgets (anchor);      // ++ alloc widget list
+
+    if (!widgets)
+    {
+      widget = markdown_browser_anchored_image_widget (g_object_get_data (G_OBJECT (anchor), "image"));
+      gtk_text_view_add_child_at_anchor (priv->textView, widget, anchor);
+      gtk_widget_show (widget);
+    }
+
+    g_list_free (widgets);                                      // -- free widget list
+  }
+}
+
+// Replace an image placeholder by the decoded image (if its buffer still exists).
+// The image has the size of the placeholder, so the scroll position is not disturbed.
+static void
+markdown_browser_replace_placeholder (GtkTextChildAnchor *anchor, GdkPixbuf *pixbuf)
+{
+  MarkdownBrowserAnchoredImage *image = g_object_get_data (G_OBJECT (anchor), "image");
+  GtkTextBuffer *textBuf = image->buffer;
+  cairo_surface_t *surface;
+  GtkTextIter start, end;
+  GList *widgets, *p;
+
+  if (!textBuf || gtk_text_child_anchor_get_deleted (anchor))
+    return;
+
+  // HiDPI images remain anchored widgets, update them with the decoded image
+  if (pixbuf && image->scale > 1)
+  {
+    image->pixbuf = g_object_ref (pixbuf);              // ++ ref pixbuf
+    surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, image->scale, NULL);   // ++ new surface
+    widgets = gtk_text_child_anchor_get_widgets (anchor);      // ++ alloc widget list
+
+    for (p = widgets; p; p = p->next)
+      gtk_image_set_from_surface (GTK_IMAGE (p->data), surface);
+
+    g_list_free (widgets);                              // -- free widget list
+    cairo_surface_destroy (surface);                    // -- destroy surface
+    return;
+  }
+
+  gtk_text_buffer_get_iter_at_child_anchor (textBuf, &start, anchor);
+  end = start;
+  gtk_text_iter_forward_char (&end);
+  gtk_text_buffer_delete (textBuf, &start, &end);
+
+  if (pixbuf)
+    gtk_text_buffer_insert_pixbuf (textBuf, &start, pixbuf);
+
+  // -- unref anchor (anchored image remains valid, caller holds a reference)
+  g_ptr_array_remove_fast (g_object_get_data (G_OBJECT (textBuf), "anchored-images"), anchor);
+}
+
+// Async image decode callback
+static void
+markdown_browser_image_loaded (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  GtkTextChildAnchor *anchor = user_data;               // !! takes over anchor ref
+  MarkdownBrowserAnchoredImage *image = g_object_get_data (G_OBJECT (anchor), "image");
+  GdkPixbuf *pixbuf;
+  GError *err = NULL;
+
+  if (!(pixbuf = markdown_browser_image_cache_decode_finish (result, &err))         // ++ ref shared pixbuf image
+      && !g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    g_warning ("Failed to load image file '%s': %s", image->filename, err->message);
+
+    pixbuf = markdown_browser_icon_cache_load (gtk_icon_theme_get_default (), "image-missing",      // ++ ref shared pixbuf
+                                               DEFAULT_ICON_SIZE, 1);
+    image->scale = 1;
+  }
+
+  g_clear_error (&err);
+
+  if (pixbuf)
+  {
+    markdown_browser_replace_placeholder (anchor, pixbuf);
+    g_object_unref (pixbuf);                            // -- unref pixbuf
+  }
+
+  g_object_unref (anchor);                              // -- unref anchor
+}
+
+// Show a frame of an animation in the anchored widgets
+static void
+markdown_browser_set_animation_frame (GtkTextChildAnchor *anchor, GdkPixbuf *frame)
+{
+  GList *widgets, *p;
+
+  widgets = gtk_text_child_anchor_get_widgets (anchor);        // ++ alloc widget list
+
+  for (p = widgets; p; p = p->next)
+    gtk_image_set_from_pixbuf (GTK_IMAGE (p->data), frame);
+
+  g_list_free (widgets);                                        // -- free widget list
+}
+
+// Async animation decode callback
+static void
+markdown_browser_animation_loaded (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  GtkTextChildAnchor *anchor = user_data;               // !! takes over anchor ref
+  MarkdownBrowserAnchoredImage *image = g_object_get_data (G_OBJECT (anchor), "image");
+  GdkPixbufAnimation *animation;
+  GdkPixbuf *pixbuf;
+  GtkWidget *browser;
+  GList *widgets;
+  GError *err = NULL;
+
+  if (!(animation = markdown_browser_image_cache_decode_animation_finish (result, &err)))      // ++ ref shared animation
+  {
+    if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_warning ("Failed to load image file '%s': %s", image->filename, err->message);
+
+      if ((pixbuf = markdown_browser_icon_cache_load (gtk_icon_theme_get_default (), "image-missing",   // ++ ref shared pixbuf
+                                                      DEFAULT_ICON_SIZE, 1)))
+      {
+        image->scale = 1;
+        markdown_browser_replace_placeholder (anchor, pixbuf);
+        g_object_unref (pixbuf);                        // -- unref pixbuf
+      }
+    }
+
+    g_clear_error (&err);
+  }
+  else if (gdk_pixbuf_animation_is_static_image (animation))  // Not animated after all, insert as a plain image
+  {
+    markdown_browser_replace_placeholder (anchor, gdk_pixbuf_animation_get_static_image (animation));
+    g_object_unref (animation);                         // -- unref animation
+  }
+  else if (image->buffer && !gtk_text_child_anchor_get_deleted (anchor))
+  {
+    image->animation = animation;                       // !! takes over animation
+    markdown_browser_set_animation_frame (anchor, gdk_pixbuf_animation_get_static_image (animation));
+
+    // Start ticking if the animation is shown
+    widgets = gtk_text_child_anchor_get_widgets (anchor);      // ++ alloc widget list
+
+    if (widgets && (browser = gtk_widget_get_ancestor (widgets->data, TYPE_MARKDOWN_BROWSER)))
+      markdown_browser_update_animations (MARKDOWN_BROWSER (browser));
+
+    g_list_free (widgets);                              // -- free widget list
+  }
+  else g_object_unref (animation);                      // -- unref animation
+
+  g_object_unref (anchor);                              // -- unref anchor
+}
+
+// Check if an anchored image of the displayed buffer is within the visible area, expanded by a number of pages
+static gboolean
+markdown_browser_anchor_is_visible (MarkdownBrowser *browser, GtkTextChildAnchor *anchor, int height, int pages)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GdkRectangle visible, location;
+  GtkTextIter iter;
+
+  gtk_text_view_get_visible_rect (priv->textView, &visible);
+  gtk_text_buffer_get_iter_at_child_anchor (priv->textBuffer, &iter, anchor);
+  gtk_text_view_get_iter_location (priv->textView, &iter, &location);
+
+  return location.y + height >= visible.y - pages * visible.height
+    && location.y <= visible.y + (pages + 1) * visible.height;
+}
+
+// Text view tick callback which advances the visible animations of the displayed buffer, removed once none are visible
+static gboolean
+markdown_browser_animation_tick (GtkWidget *widget, GdkFrameClock *frameClock, gpointer data)
+{
+  MarkdownBrowser *browser = MARKDOWN_BROWSER (data);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserAnchoredImage *image;
+  GtkTextChildAnchor *anchor;
+  GPtrArray *anchoredImages;
+  gboolean visible = FALSE;
+  gint64 frameTime;
+  GTimeVal timeVal;
+  int delay;
+  guint i;
+
+  anchoredImages = g_object_get_data (G_OBJECT (priv->textBuffer), "anchored-images");
+  frameTime = gdk_frame_clock_get_frame_time (frameClock);
+  timeVal.tv_sec = frameTime / G_USEC_PER_SEC;
+  timeVal.tv_usec = frameTime % G_USEC_PER_SEC;
+
+  for (i = 0; anchoredImages && i < anchoredImages->len; i++)
+  {
+    anchor = g_ptr_array_index (anchoredImages, i);
+    image = g_object_get_data (G_OBJECT (anchor), "image");
+
+    if (!image->animation || !markdown_browser_anchor_is_visible (browser, anchor, image->height, 0))
+      continue;
+
+    visible = TRUE;
+
+    if (image->animationIter && frameTime < image->nextFrameTime)
+      continue;
+
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS            // GdkPixbufAnimation API uses GTimeVal
+    if (!image->animationIter)
+      image->animationIter = gdk_pixbuf_animation_get_iter (image->animation, &timeVal);      // ++ new iterator
+    else gdk_pixbuf_animation_iter_advance (image->animationIter, &timeVal);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+
+    markdown_browser_set_animation_frame (anchor, gdk_pixbuf_animation_iter_get_pixbuf (image->animationIter));
+
+    // Delay is -1 if the last frame is shown forever, it is only checked again when scrolled into view
+    delay = gdk_pixbuf_animation_iter_get_delay_time (image->animationIter);
+    image->nextFrameTime = delay >= 0 ? frameTime + delay * 1000 : G_MAXINT64;
+  }
+
+  if (!visible)
+    priv->animationTickId = 0;
+
+  return visible ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+// Start ticking if animations are visible and the text view is mapped, stop otherwise
+static void
+markdown_browser_update_animations (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserAnchoredImage *image;
+  GtkTextChildAnchor *anchor;
+  GPtrArray *anchoredImages;
+  gboolean visible = FALSE;
+  guint i;
+
+  anchoredImages = g_object_get_data (G_OBJECT (priv->textBuffer), "anchored-images");
+
+  if (anchoredImages && gtk_widget_get_mapped (GTK_WIDGET (priv->textView)))
+  {
+    for (i = 0; i < anchoredImages->len && !visible; i++)
+    {
+      anchor = g_ptr_array_index (anchoredImages, i);
+      image = g_object_get_data (G_OBJECT (anchor), "image");
+      visible = image->animation && markdown_browser_anchor_is_visible (browser, anchor, image->height, 0);
+    }
+  }
+
+  if (visible && !priv->animationTickId)
+    priv->animationTickId = gtk_widget_add_tick_callback (GTK_WIDGET (priv->textView), markdown_browser_animation_tick,
+                                                          browser, NULL);
+  else if (!visible && priv->animationTickId)
+  {
+    gtk_widget_remove_tick_callback (GTK_WIDGET (priv->textView), priv->animationTickId);
+    priv->animationTickId = 0;
+  }
+}
+
+static void
+markdown_browser_text_view_map_changed (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  markdown_browser_update_animations (browser);
+}
+
+// Start decoding the placeholder images of the displayed text buffer which are near the visible area
+static void
+markdown_browser_load_visible_images (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserAnchoredImage *image;
+  GtkTextChildAnchor *anchor;
+  GPtrArray *anchoredImages;
+  guint i;
+
+  if (!(anchoredImages = g_object_get_data (G_OBJECT (priv->textBuffer), "anchored-images")))
+    return;
+
+  for (i = 0; i < anchoredImages->len; i++)
+  {
+    anchor = g_ptr_array_index (anchoredImages, i);
+    image = g_object_get_data (G_OBJECT (anchor), "image");
+
+    if (image->cancellable || image->pixbuf || image->animation)       // Already decoding or decoded?
+      continue;
+
+    if (!markdown_browser_anchor_is_visible (browser, anchor, image->height, IMAGE_LOAD_AHEAD))
+      continue;
+
+    image->cancellable = g_cancellable_new ();                  // ++ new cancellable
+
+    if (image->animated)
+      markdown_browser_image_cache_decode_animation_async (image->filename, image->cancellable,
+                                                           markdown_browser_animation_loaded,
+                                                           g_object_ref (anchor));     // ++ ref anchor
+    else markdown_browser_image_cache_decode_async (image->filename, image->decodeWidth, image->decodeHeight,
+                                                    image->cancellable, markdown_browser_image_loaded,
+                                                    g_object_ref (anchor));            // ++ ref anchor
+  }
+
+  markdown_browser_update_animations (browser);
+}
+
+// Parse an optional " =WIDTHxHEIGHT" size hint at the end of an image name, either dimension can be omitted.
+// Returns the length of the image name without the hint, width and height are 0 if not given.
+static int
+markdown_browser_parse_size_hint (const char *imageName, int *width, int *height)
+{
+  const char *hint;
+  char *s;
+  int len;
+
+  *width = *height = 0;
+  len = strlen (imageName);
+
+  if (!(hint = strrchr (imageName, '=')) || hint == imageName || hint[-1] != ' ')
+    return len;
+
+  s = (char *)hint + 1;
+
+  if (g_ascii_isdigit (*s))
+    *width = MIN (strtol (s, &s, 10), MAX_IMAGE_SIZE);
+
+  if (*s == 'x' && g_ascii_isdigit (*++s))
+    *height = MIN (strtol (s, &s, 10), MAX_IMAGE_SIZE);
+
+  if (*s != '\0')               // Not a size hint
+  {
+    *width = *height = 0;
+    return len;
+  }
+
+  for (len = hint - imageName; len > 0 && imageName[len - 1] == ' '; len--);
+
+  return len;
+}
+
+// Get the name@2x HiDPI variant of an image file name
+static char *
+markdown_browser_hidpi_filename (const char *filename)  // ++ alloc variant file name
+{
+  const char *ext;
+
+  ext = strrchr (filename, '.');
+
+  if (!ext || strchr (ext, G_DIR_SEPARATOR))
+    return g_strconcat (filename, "@2x", NULL);
+
+  return g_strdup_printf ("%.*s@2x%s", (int)(ext - filename), filename, ext);
+}
+
+// Render an animated image file (GIF), at its natural size since frames are not scaled.
+// Returns a pixbuf to insert if it was already decoded and is not animated, or NULL if an anchored image was rendered.
+static GdkPixbuf *
+markdown_browser_render_animation_file (MarkdownBrowserRenderBag *bag, char *filename,        // !! takes over filename
+                                        const char *alt, int width, int height)
+{
+  MarkdownBrowserAnchoredImage *image;
+  GdkPixbufAnimation *animation;
+  GdkPixbuf *pixbuf;
+
+  animation = markdown_browser_image_cache_lookup_animation (filename);        // ++ ref shared animation
+
+  if (animation && gdk_pixbuf_animation_is_static_image (animation))
+  {
+    pixbuf = g_object_ref (gdk_pixbuf_animation_get_static_image (animation));  // ++ ref pixbuf
+    g_object_unref (animation);                         // -- unref animation
+    g_free (filename);                                  // -- free file name
+    return pixbuf;                                      // !! caller takes over pixbuf
+  }
+
+  image = g_slice_new0 (MarkdownBrowserAnchoredImage);
+  image->filename = filename;                           // !! takes over file name
+  image->alt = alt;
+  image->width = width;
+  image->height = height;
+  image->scale = 1;
+  image->animated = TRUE;
+  image->animation = animation;                         // !! takes over animation (NULL if not decoded yet)
+
+  markdown_browser_render_anchored_image (bag, image);  // !! takes over image
+  return NULL;
+}
+
+// Render an image file at its display size: its natural size unless a size hint was given, scaled down to fit the
+// text view width.  It is decoded at that size times the scale factor of the text view, if the file has enough pixels.
+// Returns a pixbuf to insert, or NULL if an anchored image was rendered.
+static GdkPixbuf *
+markdown_browser_render_image_file (MarkdownBrowserRenderBag *bag, char *filename,     // !! takes over filename
+                                    const char *alt, int fileWidth, int fileHeight, int fileScale,
+                                    int hintWidth, int hintHeight)
+{
+  MarkdownBrowserPrivate *priv = bag->priv;
+  MarkdownBrowserAnchoredImage *image;
+  GdkRectangle visible;
+  GdkPixbuf *pixbuf;
+  int width, height, maxWidth, scale;
+
+  width = MAX (fileWidth / fileScale, 1);
+  height = MAX (fileHeight / fileScale, 1);
+
+  if (hintWidth > 0 && hintHeight > 0)
+  {
+    width = hintWidth;
+    height = hintHeight;
+  }
+  else if (hintWidth > 0)
+  {
+    height = MAX ((gint64)height * hintWidth / width, 1);
+    width = hintWidth;
+  }
+  else if (hintHeight > 0)
+  {
+    width = MAX ((gint64)width * hintHeight / height, 1);
+    height = hintHeight;
+  }
+
+  // Fit to view width (not limited if not allocated yet)
+  gtk_text_view_get_visible_rect (priv->textView, &visible);
+  maxWidth = visible.width - gtk_text_view_get_left_margin (priv->textView)
+    - gtk_text_view_get_right_margin (priv->textView);
+
+  if (visible.width > 1 && maxWidth > 0 && width > maxWidth)
+  {
+    height = MAX ((gint64)height * maxWidth / width, 1);
+    width = maxWidth;
+  }
+
+  scale = gtk_widget_get_scale_factor (GTK_WIDGET (priv->textView));
+
+  if (fileWidth < width * scale || fileHeight < height * scale)       // Not enough pixels for HiDPI?
+    scale = 1;
+
+  image = g_slice_new0 (MarkdownBrowserAnchoredImage);
+  image->filename = filename;                           // !! takes over file name
+  image->alt = alt;
+  image->width = width;
+  image->height = height;
+  image->scale = scale;
+
+  if (width * scale == fileWidth && height * scale == fileHeight)
+    image->decodeWidth = image->decodeHeight = -1;      // Natural size
+  else
+  {
+    image->decodeWidth = width * scale;
+    image->decodeHeight = height * scale;
+  }
+
+  pixbuf = markdown_browser_image_cache_lookup (filename, image->decodeWidth, image->decodeHeight);   // ++ ref shared pixbuf
+
+  if (pixbuf && scale == 1)
+  {
+    markdown_browser_anchored_image_free (image);       // -- free image
+    return pixbuf;                                      // !! caller takes over pixbuf
+  }
+
+  image->pixbuf = pixbuf;                               // !! takes over pixbuf (NULL if not decoded yet)
+  markdown_browser_render_anchored_image (bag, image);  // !! takes over image
+  return NULL;
+}
+
+// Insert an image span into the content buffer
+static void
+markdown_browser_render_image (MarkdownBrowserRenderBag *bag, const char *imageName, const char *alt)
+{
+  MarkdownBrowserPrivate *priv = bag->priv;
+  char *name, *basename, *filename, *s;
+  GtkTextMark *mark;
+  GdkPixbuf *pixbuf;
+  GError *err = NULL;
+  MarkdownBrowserAnchoredImage *image;
+  GdkPixbufFormat *format;
+  char **fields;
+  int count, size, width, height, hintWidth, hintHeight, fileScale, scale;
+
+  // Add marker for image alt tooltip (pixbufs are shared, so alt text can't be attached to them)
+  if (alt)
+  {
+    mark = gtk_text_buffer_create_mark (bag->textBuf, NULL, &bag->iter, TRUE);
+    g_object_set_data (G_OBJECT (mark), "alt", (gpointer)alt);         // Document text pool outlives the buffer
+  }
+
+  // Request for an icon?
+  if (g_str_has_prefix (imageName, "icon:"))
+  { // Split icon name into fields
+    fields = g_strsplit (imageName, ":", -1);     // ++ allocate array of string fields
+    count = g_strv_length (fields);
+
+    // Was size provided?
+    if (count > 2)
+    {
+      size = strtol (fields[1], &s, 10);
+
+      if (*s || size < 8 || size > 1024)
+        size = DEFAULT_ICON_SIZE;
+    }
+    else size = DEFAULT_ICON_SIZE;
+
+    // Rendered buffers using icons are dropped when the icon theme changes
+    g_object_set_data (G_OBJECT (bag->textBuf), "uses-icons", GINT_TO_POINTER (TRUE));
+
+    scale = gtk_widget_get_scale_factor (GTK_WIDGET (priv->textView));
+    pixbuf = markdown_browser_icon_cache_load (gtk_icon_theme_get_default (), fields[count - 1], size, scale);  // ++ ref shared pixbuf
+
+    g_strfreev (fields);          // -- free array of string fields
+
+    if (pixbuf && scale > 1)      // HiDPI icons are anchored widgets
+    {
+      image = g_slice_new0 (MarkdownBrowserAnchoredImage);
+      image->alt = alt;
+      image->width = MAX (gdk_pixbuf_get_width (pixbuf) / scale, 1);
+      image->height = MAX (gdk_pixbuf_get_height (pixbuf) / scale, 1);
+      image->scale = scale;
+      image->pixbuf = pixbuf;                           // !! takes over pixbuf
+      markdown_browser_render_anchored_image (bag, image);     // !! takes over image
+      return;
+    }
+  }
+  else
+  { // Split off size hint and strip off path component of image name for potential security issue if content not trusted
+    name = g_strndup (imageName, markdown_browser_parse_size_hint (imageName, &hintWidth, &hintHeight));   // ++ alloc name
+    basename = g_path_get_basename (name);          // ++ allocate basename
+    g_free (name);                                  // -- free name
+
+    filename = g_build_filename (markdown_browser_topic_images_path (priv, bag->topic), basename, NULL);   // ++ allocate image file name
+    g_free (basename);                              // -- free basename
+    fileScale = 1;
+
+    // Prefer a name@2x variant on HiDPI displays
+    if (gtk_widget_get_scale_factor (GTK_WIDGET (priv->textView)) > 1)
+    {
+      s = markdown_browser_hidpi_filename (filename);  // ++ alloc variant file name
+
+      if (markdown_browser_image_cache_file_exists (s))
+      {
+        g_free (filename);                          // -- free image file name
+        filename = s;                               // !! takes over variant file name
+        fileScale = 2;
+      }
+      else g_free (s);                              // -- free variant file name
+    }
+
+    if ((format = markdown_browser_image_cache_get_file_info (filename, &width, &height))
+        && g_strcmp0 (gdk_pixbuf_format_get_name (format), "gif") == 0)
+      pixbuf = markdown_browser_render_animation_file (bag, filename, alt, width, height);     // !! takes over filename
+    else if (format)
+      pixbuf = markdown_browser_render_image_file (bag, filename, alt, width, height, fileScale,   // !! takes over filename
+                                                   hintWidth, hintHeight);
+    else
+    { // Not a recognized image, load it anyways to get the error
+      pixbuf = markdown_browser_image_cache_load (filename, -1, -1, &err); // ++ ref pixbuf image
+
+      if (!pixbuf)
+      {
+        g_warning ("Failed to load image file '%s': %s", filename, err->message);
+        g_clear_error (&err);
+
+        pixbuf = markdown_browser_icon_cache_load (gtk_icon_theme_get_default (), "image-missing",  // ++ ref shared pixbuf
+                                                   DEFAULT_ICON_SIZE, 1);
+      }
+
+      g_free (filename);    // -- free image file name
+    }
+  }
+
+  // Insert the pixbuf and update current iterator
+  if (pixbuf)
+  {
+    gtk_text_buffer_insert_pixbuf (bag->textBuf, &bag->iter, pixbuf);
+    g_object_unref (pixbuf);              // -- unref pixbuf
+  }
+}
+
+// Render a slice of a topic by replaying its parsed document into its content text buffer, continuing where the last
+// slice left off.  Stops once the time budget (microseconds) is used up and at least minLines lines have been rendered.
+// Returns TRUE if rendering is complete.
+static gboolean
+markdown_browser_render_topic (MarkdownBrowserRenderBag *bag, gint64 budget, int minLines)
+{
+  MarkdownBrowserPrivate *priv = bag->priv;
+  MarkdownBrowserDocument *doc = bag->doc;
+  GtkTextBuffer *textBuf = bag->textBuf;
+  const MarkdownBrowserSpan *span;
+  GtkTextMark *mark;
+  const char *text;
+  gint64 endTime;
+  int level;
+
+  endTime = g_get_monotonic_time () + budget;
+  gtk_text_buffer_get_end_iter (textBuf, &bag->iter);
+
+  for (; bag->spanIndex < bag->spanEnd; bag->spanIndex++)
+  {
+    if (g_get_monotonic_time () >= endTime && gtk_text_iter_get_line (&bag->iter) >= minLines)
+    {
+      markdown_browser_buffer_flush (bag);
+      return FALSE;
+    }
+
+    span = &doc->spans[bag->spanIndex];
+    text = markdown_browser_document_span_text (doc, span);
+
+    switch (span->type)
+    {
+      case MARKDOWN_BROWSER_SPAN_TEXT:
+        markdown_browser_buffer_append (bag, text, span->len, span->style);
+        break;
+      case MARKDOWN_BROWSER_SPAN_BULLET:
+        // Append precomputed bullet string of list level (empty if no bullet characters)
+        level = MARKDOWN_BROWSER_STYLE_LIST (span->style);
+
+        if (level > 0 && priv->bullets[level - 1][0])
+          markdown_browser_buffer_append (bag, priv->bullets[level - 1], -1, span->style);
+        break;
+      case MARKDOWN_BROWSER_SPAN_IMAGE:
+        markdown_browser_buffer_flush (bag);
+        markdown_browser_render_image (bag, text,
+                                       span->arg != MARKDOWN_BROWSER_SPAN_NO_ARG ? doc->text + span->arg : NULL);
+        break;
+      case MARKDOWN_BROWSER_SPAN_LINK:
+        // Add mark for link URL, linked text follows
+        markdown_browser_buffer_flush (bag);
+        mark = gtk_text_buffer_create_mark (textBuf, NULL, &bag->iter, TRUE);
+        g_object_set_data (G_OBJECT (mark), "link", (gpointer)text);   // URL is NUL terminated in text pool (buffer holds document)
+        break;
+    }
+  }
+
+  markdown_browser_buffer_flush (bag);
+
+  return TRUE;
+}
+
+// Precompute the bullet string (bullet character and a space) of each list level from the bullet-chars property
+static void
+markdown_browser_update_bullets (MarkdownBrowserPrivate *priv)
+{
+  const char *s, *next;
+  int count, i;
+
+  count = priv->bulletChars ? g_utf8_strlen (priv->bulletChars, -1) : 0;
+
+  for (i = 0; i < MARKDOWN_BROWSER_MAX_LIST_LEVELS; i++)
+  {
+    if (count > 0)
+    { // Last bullet character is used for remaining levels
+      s = g_utf8_offset_to_pointer (priv->bulletChars, MIN (i, count - 1));
+      next = g_utf8_find_next_char (s, NULL);
+      g_snprintf (priv->bullets[i], MAX_BULLET_LEN, "%.*s ", (int)(next - s), s);
+    }
+    else priv->bullets[i][0] = '\0';
+  }
+}
+
+// Idle callback to render the next slice of a progressive render
+static gboolean
+markdown_browser_render_idle (gpointer data)
+{
+  MarkdownBrowser *browser = MARKDOWN_BROWSER (data);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  gboolean done;
+
+  done = markdown_browser_render_topic (priv->renderJob, RENDER_SLICE_TIME, 0);
+
+  if (priv->renderJob->textBuf == priv->textBuffer)    // Add widgets of images rendered into displayed buffer
+  {
+    markdown_browser_attach_image_widgets (browser);
+    markdown_browser_load_visible_images (browser);
+  }
+
+  if (!done)
+    return TRUE;        // More to render
+
+  // Rendering complete, release render job
+  priv->renderIdleId = 0;
+  markdown_browser_render_cancel (browser);
+  return FALSE;
+}
+
+// Stop a progressive render in progress (if any).  A partially rendered buffer is removed from the render cache.
+static void
+markdown_browser_render_cancel (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserRenderBag *bag = priv->renderJob;
+  MarkdownBrowserCachedBuffer *cached;
+  GList *link;
+
+  if (!bag)
+    return;
+
+  if (priv->renderIdleId)
+  {
+    g_source_remove (priv->renderIdleId);
+    priv->renderIdleId = 0;
+
+    for (link = priv->renderCache->head; link; link = link->next)
+    {
+      cached = link->data;
+
+      if (cached->buffer == bag->textBuf)
+      {
+        g_queue_delete_link (priv->renderCache, link);
+        g_object_unref (cached->buffer);                        // -- unref cached text buffer
+        g_slice_free (MarkdownBrowserCachedBuffer, cached);     // -- free cache entry
+        break;
+      }
+    }
+  }
+
+  markdown_browser_render_bag_free (bag);
+  priv->renderJob = NULL;
+}
+
+static void
+markdown_browser_render_bag_free (MarkdownBrowserRenderBag *bag)
+{
+  markdown_browser_document_unref (bag->doc);           // -- unref document
+  g_object_unref (bag->textBuf);                        // -- unref text buffer
+  g_slice_free (MarkdownBrowserRenderBag, bag);         // -- free render bag
+}
+
+// Remove least recently used rendered topic buffers from the render cache until it holds at most size entries
+static void
+markdown_browser_render_cache_trim (MarkdownBrowser *browser, int size)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserCachedBuffer *cached;
+
+  while (g_queue_get_length (priv->renderCache) > size)
+  {
+    cached = g_queue_pop_tail (priv->renderCache);
+    g_object_unref (cached->buffer);                    // -- unref cached text buffer
+    g_slice_free (MarkdownBrowserCachedBuffer, cached); // -- free cache entry
+  }
+}
+
+// Remove the rendered buffers of all sections of a topic from the render cache
+static void
+markdown_browser_render_cache_remove_topic (MarkdownBrowser *browser, int topicIndex)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserCachedBuffer *cached;
+  GList *link, *next;
+
+  for (link = priv->renderCache->head; link; link = next)
+  {
+    next = link->next;
+    cached = link->data;
+
+    if (cached->topic == topicIndex)
+    {
+      g_queue_delete_link (priv->renderCache, link);
+      g_object_unref (cached->buffer);                  // -- unref cached text buffer
+      g_slice_free (MarkdownBrowserCachedBuffer, cached);       // -- free cache entry
+    }
+  }
+}
+
+// Get the rendered text buffer of a topic section from the render cache, rendering it if not cached (priv->sections
+// must be set for the topic).  At least the lines up to line plus a screenful are rendered before returning, the rest
+// is rendered progressively.
+static GtkTextBuffer *
+markdown_browser_render_cache_get (MarkdownBrowser *browser, int topicIndex, int section, int line)    // ++ ref text buffer (caller owns)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserCachedBuffer *cached;
+  MarkdownBrowserRenderBag *bag;
+  GtkTextBuffer *textBuf;
+  GList *link;
+
+  // Topic is being rendered progressively?  Make sure the requested line is available.
+  if ((bag = priv->renderJob) && bag->topic == topicIndex && bag->section == section)
+  {
+    if (markdown_browser_render_topic (bag, 0, line + RENDER_FIRST_LINES))
+    {
+      textBuf = g_object_ref (bag->textBuf);            // ++ ref text buffer
+      g_source_remove (priv->renderIdleId);
+      priv->renderIdleId = 0;
+      markdown_browser_render_cancel (browser);         // Release completed render job
+      return textBuf;
+    }
+
+    return g_object_ref (bag->textBuf);                 // ++ ref text buffer
+  }
+
+  // Cache hit?  Move it to the most recently used position.
+  for (link = priv->renderCache->head; link; link = link->next)
+  {
+    cached = link->data;
+
+    if (cached->topic == topicIndex && cached->section == section)
+    {
+      g_queue_unlink (priv->renderCache, link);
+      g_queue_push_head_link (priv->renderCache, link);
+      return g_object_ref (cached->buffer);             // ++ ref text buffer
+    }
+  }
+
+  markdown_browser_render_cancel (browser);
+
+  // Buffers share the tag table, so tags looked up at construction apply to all of them
+  textBuf = gtk_text_buffer_new (priv->tagTable);      // ++ new text buffer
+
+  bag = g_slice_new (MarkdownBrowserRenderBag);        // ++ alloc render bag
+  bag->priv = priv;
+  bag->textBuf = g_object_ref (textBuf);                // ++ ref text buffer (render bag owns)
+  bag->doc = markdown_browser_document_ref              // ++ ref document (render bag owns)
+    (markdown_browser_topic_get_document (browser, &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex)));
+  bag->topic = topicIndex;
+  bag->section = section;
+  bag->spanIndex = g_array_index (priv->sections, guint, section);
+  bag->spanEnd = section + 1 < priv->sections->len ? g_array_index (priv->sections, guint, section + 1)
+                                                   : bag->doc->spanCount;
+  bag->run = priv->renderRun;
+  g_string_truncate (bag->run, 0);
+  bag->runStyle = 0;
+
+  // Link URLs of marks point into the document text pool, so the text buffer holds a reference to the document
+  g_object_set_data_full (G_OBJECT (textBuf), "document", markdown_browser_document_ref (bag->doc),
+                          (GDestroyNotify)markdown_browser_document_unref);     // ++ ref document (text buffer owns)
+
+  // Render the first screenful now and continue in idle time slices if there is more
+  if (markdown_browser_render_topic (bag, RENDER_SLICE_TIME, line + RENDER_FIRST_LINES))
+    markdown_browser_render_bag_free (bag);
+  else
+  { // Lower priority than redraw and input events, so the UI stays responsive
+    priv->renderJob = bag;
+    priv->renderIdleId = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, markdown_browser_render_idle, browser, NULL);
+  }
+
+  // Topics whose file failed to load are not cached, so loading is tried again next time
+  if (priv->renderCacheSize > 0 && g_object_get_data (G_OBJECT (textBuf), "document") != priv->emptyDocument)
+  {
+    cached = g_slice_new (MarkdownBrowserCachedBuffer);     // ++ alloc cache entry
+    cached->topic = topicIndex;
+    cached->section = section;
+    cached->buffer = g_object_ref (textBuf);            // ++ ref text buffer (cache owns)
+    g_queue_push_head (priv->renderCache, cached);
+    markdown_browser_render_cache_trim (browser, priv->renderCacheSize);
+  }
+
+  return textBuf;
+}
+
+// Display a topic section in the text view (MARKDOWN_BROWSER_TOPIC_NONE for empty content), line is the line to be shown.
+// Section is clamped to the sections of the topic.
+static void
+markdown_browser_show_topic (MarkdownBrowser *browser, int topicIndex, int section, int line)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserDocument *doc;
+  GtkTextBuffer *textBuf;
+
+  if (topicIndex >= 0)
+  {
+    doc = markdown_browser_topic_get_document (browser, &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex));
+    markdown_browser_document_get_sections (doc, priv->paginateLevel, priv->sections);
+    section = CLAMP (section, 0, (int)priv->sections->len - 1);
+  }
+  else section = 0;
+
+  // Navigating away from a topic section being rendered cancels the rest of the render
+  if (priv->renderJob && (priv->renderJob->topic != topicIndex || priv->renderJob->section != section))
+    markdown_browser_render_cancel (browser);
+
+  priv->section = section;
+
+  if (topicIndex >= 0)
+    textBuf = markdown_browser_render_cache_get (browser, topicIndex, section, line);  // ++ ref text buffer
+  else textBuf = g_object_ref (priv->emptyBuffer);     // ++ ref text buffer
+
+  if (textBuf != priv->textBuffer)
+    gtk_text_view_set_buffer (priv->textView, textBuf);
+
+  g_object_unref (priv->textBuffer);                    // -- unref previous displayed text buffer
+  priv->textBuffer = textBuf;                           // !! Displayed text buffer takes over reference
+
+  markdown_browser_attach_image_widgets (browser);
+  markdown_browser_load_visible_images (browser);
+}
+
+/**
+ * markdown_browser_navigate:
+ * @browser: Markdown browser
+ * @historyOfs: History position offset (0: go to new @topicIndex, -1: back 1 in history, 1: forward 1 in history, etc)
+ * @topicIndex: Topic index to go to (if @historyOfs == 0)
+ *
+ * Navigate to new topic or forward/back in history.
+ */
+void
+markdown_browser_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  priv->navigateSerial++;       // Supersede any pending async navigation
+
+  if (markdown_browser_real_navigate (browser, historyOfs, topicIndex, 0))
+    g_object_notify (G_OBJECT (browser), "topic-index");
+}
+
+/**
+ * markdown_browser_navigate_to_section:
+ * @browser: Markdown browser
+ * @topicIndex: Topic index to go to
+ * @section: Section of topic to go to (see paginate-level property), clamped to valid sections
+ *
+ * Navigate to a section of a topic.  Only one section of a topic is shown at a time, if the
+ * paginate-level property is set.
+ */
+void
+markdown_browser_navigate_to_section (MarkdownBrowser *browser, int topicIndex, int section)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+
+  priv->navigateSerial++;       // Supersede any pending async navigation
+
+  if (markdown_browser_real_navigate (browser, 0, topicIndex, section))
+    g_object_notify (G_OBJECT (browser), "topic-index");
+}
+
+/**
+ * markdown_browser_navigate_to_link:
+ * @browser: Markdown browser
+ * @link: Link in the form "name", "name#anchor" or "#anchor" (section of current topic)
+ *
+ * Navigate to a local link.  An anchor selects the section of the topic whose header matches it
+ * (lower case with spaces as '-' and punctuation removed), if the paginate-level property is set.
+ * The topic is parsed in a worker thread if it hasn't been already, see markdown_browser_navigate_async().
+ *
+ * Returns: TRUE on success, FALSE if the topic was not found
+ */
+gboolean
+markdown_browser_navigate_to_link (MarkdownBrowser *browser, const char *link)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  const char *anchor;
+  char *name;
+  int topicIndex;
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
+  g_return_val_if_fail (link != NULL, FALSE);
+
+  if (!(anchor = strchr (link, '#')))
+  {
+    if ((topicIndex = markdown_browser_get_topic_by_name (browser, link)) == -1)
+      return FALSE;
+
+    markdown_browser_navigate_async (browser, 0, topicIndex, NULL, NULL, NULL);
+    return TRUE;
+  }
+
+  if (anchor == link)
+    topicIndex = priv->topicIndex;
+  else
+  {
+    name = g_strndup (link, anchor - link);             // ++ alloc topic name
+    topicIndex = markdown_browser_get_topic_by_name (browser, name);
+    g_free (name);                                      // -- free topic name
+  }
+
+  if (topicIndex < 0)
+    return FALSE;
+
+  // The section is resolved once the topic is parsed, in a worker thread if it hasn't been already
+  markdown_browser_real_navigate_async (browser, 0, topicIndex, anchor + 1, NULL, NULL, NULL);
+  return TRUE;
+}
+
+// Navigate to a topic whose document is available (doc, or NULL to get the topic document), going to the section whose
+// header matches an anchor if paginated.  Sections are found in a separate array, priv->sections belongs to the
+// displayed topic until the navigation.
+static void
+markdown_browser_navigate_to_anchor (MarkdownBrowser *browser, int historyOfs, int topicIndex, const char *anchor,
+                                     MarkdownBrowserDocument *doc)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GArray *sections;
+  int section;
+
+  if (!anchor || historyOfs != 0 || priv->paginateLevel <= 0 || topicIndex < 0 || topicIndex >= priv->topics->len)
+  {
+    markdown_browser_navigate (browser, historyOfs, topicIndex);
+    return;
+  }
+
+  if (!doc)     // Already parsed or a help bundle topic
+    doc = markdown_browser_topic_get_document (browser, &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex));
+
+  sections = g_array_new (FALSE, FALSE, sizeof (guint));       // ++ new sections array
+  markdown_browser_document_get_sections (doc, priv->paginateLevel, sections);
+  section = MAX (markdown_browser_document_find_anchor (doc, sections, anchor), 0);
+  g_array_free (sections, TRUE);                                // -- free sections array
+
+  markdown_browser_navigate_to_section (browser, topicIndex, section);
+}
+
+/**
+ * markdown_browser_navigate_async:
+ * @browser: Markdown browser
+ * @historyOfs: History position offset (0: go to new @topicIndex, -1: back 1 in history, 1: forward 1 in history, etc)
+ * @topicIndex: Topic index to go to (if @historyOfs == 0)
+ * @cancellable: (nullable): Optional cancellable object
+ * @callback: (nullable): Callback to call when navigation is complete
+ * @user_data: User data to pass to @callback
+ *
+ * Navigate to new topic or forward/back in history, like markdown_browser_navigate(), but parse the
+ * topic Markdown content in a worker thread if it hasn't been already.  Only the insertion of content into the
+ * text buffer is done in the main thread.  A newer navigation request supersedes a pending one, which then
+ * completes with %G_IO_ERROR_CANCELLED.  Call markdown_browser_navigate_finish() from @callback to get the result.
+ */
+void
+markdown_browser_navigate_async (MarkdownBrowser *browser, int historyOfs, int topicIndex,
+                                 GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+  markdown_browser_real_navigate_async (browser, historyOfs, topicIndex, NULL, cancellable, callback, user_data);
+}
+
+// Navigate asynchronously, going to the section of an anchor if not NULL (see markdown_browser_navigate_to_link())
+static void
+markdown_browser_real_navigate_async (MarkdownBrowser *browser, int historyOfs, int topicIndex, const char *anchor,
+                                      GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserNavigateData *data;
+  MarkdownBrowserTopicInfo *info;
+  MarkdownBrowserTopic *topic;
+  GTask *task, *parseTask;
+  int newHistoryPos, index;
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+
+  task = g_task_new (browser, cancellable, callback, user_data);        // ++ new task
+  g_task_set_source_tag (task, markdown_browser_navigate_async);
+
+  // Determine the topic which will be displayed
+  if (historyOfs != 0)
+  {
+    newHistoryPos = priv->historyPos + historyOfs;
+
+    if (newHistoryPos >= 0 && newHistoryPos < priv->history->len)
+      index = g_array_index (priv->history, MarkdownBrowserVisit, newHistoryPos).topic;
+    else index = MARKDOWN_BROWSER_TOPIC_NONE;
+  }
+  else index = topicIndex;
+
+  // Nothing to parse?  Navigate now (invalid values are ignored, same as markdown_browser_navigate()).
+  if (index < 0 || index >= priv->topics->len
+      || g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, index).document
+      || g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, index).bundle)
+  {
+    markdown_browser_navigate_to_anchor (browser, historyOfs, topicIndex, anchor, NULL);
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);      // -- unref task
+    return;
+  }
+
+  topic = &g_array_index (priv->topics, MarkdownBrowserTopic, index);
+  info = &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, index);
+
+  data = g_slice_new (MarkdownBrowserNavigateData);    // ++ alloc navigate data
+  data->historyOfs = historyOfs;
+  data->topicIndex = topicIndex;
+  data->topicId = info->id;
+  data->content = topic->content;
+  data->contentLen = markdown_browser_topic_content_len (info);
+  data->path = g_strdup (info->path);                  // ++ alloc path
+  data->loadedContent = NULL;
+  data->timeLimit = priv->renderDeadline;
+  data->cached = info->hash || info->path;
+  data->hash = g_strdup (info->hash);                  // ++ alloc hash
+  data->anchor = g_strdup (anchor);                    // ++ alloc anchor
+  data->serial = ++priv->navigateSerial;
+  info->pinCount++;             // Keep content of a lazily loaded topic while it is being parsed
+
+  parseTask = g_task_new (browser, cancellable, markdown_browser_navigate_parsed, task);    // ++ new task (!! takes over task)
+  g_task_set_task_data (parseTask, data, markdown_browser_navigate_data_free);     // !! parse task takes over navigate data
+  g_task_run_in_thread (parseTask, markdown_browser_parse_thread);
+  g_object_unref (parseTask);   // -- unref parse task (running thread holds a ref)
+}
+
+/**
+ * markdown_browser_navigate_finish:
+ * @browser: Markdown browser
+ * @result: Async result passed to the #GAsyncReadyCallback of markdown_browser_navigate_async()
+ * @err: Location to store error or NULL
+ *
+ * Finish an asynchronous navigation started with markdown_browser_navigate_async().
+ *
+ * Returns: TRUE on success, FALSE if the navigation was cancelled or superseded or the file of a lazily loaded topic
+ *   failed to load (@err is set)
+ */
+gboolean
+markdown_browser_navigate_finish (MarkdownBrowser *browser, GAsyncResult *result, GError **err)
+{
+  g_return_val_if_fail (g_task_is_valid (result, browser), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), err);
+}
+
+static void
+markdown_browser_navigate_data_free (gpointer data)
+{
+  MarkdownBrowserNavigateData *navigateData = data;
+
+  g_free (navigateData->path);                          // -- free path
+  g_free (navigateData->hash);                          // -- free hash
+  g_free (navigateData->anchor);                        // -- free anchor
+  g_free (navigateData->loadedContent);                 // -- free loaded content (if not taken over by topic)
+  g_slice_free (MarkdownBrowserNavigateData, data);
+}
+
+// Worker thread which parses topic content into a document (no GTK calls allowed here)
+static void
+markdown_browser_parse_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+  MarkdownBrowserNavigateData *data = task_data;
+  MarkdownBrowserDocument *doc;
+  GError *err = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (!data->content
+      && !(data->loadedContent = markdown_browser_topic_read (data->path, &err)))   // ++ alloc content (data owns it)
+  {
+    g_task_return_error (task, err);                    // !! task takes over error
+    return;
+  }
+
+  doc = markdown_browser_parse_content (data->content ? data->content : data->loadedContent,     // ++ new document
+                                        data->content ? data->contentLen : -1, data->timeLimit, data->cached, data->hash);
+  g_task_return_pointer (task, doc, (GDestroyNotify)markdown_browser_document_unref);  // !! task takes over document
+}
+
+// Main thread callback for completion of parser thread task, caches the document and navigates to the topic
+static void
+markdown_browser_navigate_parsed (GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+  MarkdownBrowser *browser = MARKDOWN_BROWSER (source_object);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserNavigateData *data = g_task_get_task_data (G_TASK (res));
+  GTask *task = user_data;
+  MarkdownBrowserDocument *doc;
+  MarkdownBrowserTopicInfo *info;
+  MarkdownBrowserTopic *topic;
+  GError *err = NULL;
+  int i, index = MARKDOWN_BROWSER_TOPIC_NONE;
+
+  doc = g_task_propagate_pointer (G_TASK (res), &err);  // ++ take document
+
+  // Find the topic by ID, its index changes if topics were re-sorted while parsing
+  for (i = 0; i < priv->topics->len; i++)
+  {
+    topic = &g_array_index (priv->topics, MarkdownBrowserTopic, i);
+    info = &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, i);
+
+    if (info->id == data->topicId)
+    {
+      info->pinCount--;
+
+      if (doc && !topic->content)
+      {
+        topic->content = data->loadedContent;           // !! topic takes over loaded content
+        data->loadedContent = NULL;
+      }
+
+      if (doc && !info->document)
+        markdown_browser_topic_set_document (browser, topic, doc);
+
+      info->lastUsed = ++priv->topicUseSerial;
+      markdown_browser_topic_charge (browser, topic);
+      markdown_browser_topics_trim (browser, topic);
+
+      index = i;
+      break;
+    }
+  }
+
+  if (!doc)
+  {
+    g_task_return_error (task, err);                    // !! task takes over error
+    g_object_unref (task);      // -- unref task
+    return;
+  }
+
+  if (data->serial != priv->navigateSerial)
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Navigation superseded by a newer request");
+  else if (!g_task_return_error_if_cancelled (task))
+  {
+    markdown_browser_navigate_to_anchor (browser, data->historyOfs, data->historyOfs != 0 ? 0 : index, data->anchor,
+                                         doc);
+    g_task_return_boolean (task, TRUE);
+  }
+
+  markdown_browser_document_unref (doc);                // -- unref document
+
+  g_object_unref (task);        // -- unref task
+}
+
+// Scroll the text view to a line of the displayed buffer.  Adds a marker and scrolls to it, supposedly this is the most
+// reliable method to scroll in a text view.
+static void
+markdown_browser_scroll_to_line (MarkdownBrowser *browser, int line)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GtkTextIter textIter;
+  GtkTextMark *mark;
+
+  gtk_text_buffer_get_iter_at_line (priv->textBuffer, &textIter, line);
+
+  if ((mark = gtk_text_buffer_get_mark (priv->textBuffer, "scroll")))
+    gtk_text_buffer_move_mark (priv->textBuffer, mark, &textIter);
+  else gtk_text_buffer_create_mark (priv->textBuffer, "scroll", &textIter, TRUE);
+
+  // FIXME - Unfortunately attempting to scroll at this point does not work, we try later in the size-allocate signal of GtkTextView
+  priv->scrollToLine = TRUE;
+}
+
+// Show the current topic section again after its rendered buffer was dropped, keeping the scroll position
+static void
+markdown_browser_refresh_topic (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GtkTextIter textIter;
+  GdkRectangle rect;
+  int line;
+
+  if (priv->topicIndex < 0)
+    return;
+
+  gtk_text_view_get_visible_rect (priv->textView, &rect);
+  gtk_text_view_get_iter_at_location (priv->textView, &textIter, 0, rect.y);
+  line = gtk_text_iter_get_line (&textIter);
+
+  markdown_browser_show_topic (browser, priv->topicIndex, priv->section, line);
+  markdown_browser_scroll_to_line (browser, line);
+}
+
+
+static gboolean
+markdown_browser_real_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex, int section)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserVisit *visit;
+  GtkTreeIter *treeIter;
+  GtkTreePath *treePath;
+  GtkTextIter textIter;
+  GdkRectangle rect;
+  int newHistoryPos;
+
+  newHistoryPos = priv->historyPos + historyOfs;
+
+  // Ignore invalid history offset or topicIndex values
+  if ((historyOfs != 0 && (newHistoryPos < 0 || newHistoryPos >= priv->history->len))
+      || (historyOfs == 0 && ((topicIndex < 0 && topicIndex != MARKDOWN_BROWSER_TOPIC_NONE)
+                              || topicIndex >= priv->topics->len)))
+    return FALSE;
+
+  // Save current topic state in history if set
+  if (priv->topicIndex != MARKDOWN_BROWSER_TOPIC_NONE)
+  {
+    if (priv->historyPos < priv->history->len)
+    { // Overwrite the entry at the current position
+      visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos);
+
+      // Go to operation truncates forward history
+      if (historyOfs == 0)
+        g_array_set_size (priv->history, priv->historyPos + 1);
+    }
+    else        // Append entry on end of history
+    {
+      g_array_set_size (priv->history, priv->history->len + 1);
+      visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->history->len - 1);
+    }
+
+    visit->topic = priv->topicIndex;
+    visit->section = priv->section;
+
+    gtk_text_view_get_visible_rect (priv->textView, &rect);
+    gtk_text_view_get_iter_at_location (priv->textView, &textIter, 0, rect.y);
+    visit->line = gtk_text_iter_get_line (&textIter);
+
+    // Remove old entries if history size exceeded
+    if (priv->history->len > priv->historyMax)
+    {
+      newHistoryPos -= priv->history->len - priv->historyMax;          // Adjust new history position after deletion
+      g_array_remove_range (priv->history, 0, priv->history->len - priv->historyMax);
+
+      // Could happen..  Original history being navigated to is now gone..  Just stay where we are (adjust for deletion)
+      if (newHistoryPos < 0)
+      {
+        priv->historyPos -= priv->historyMax - priv->history->len;
+        return FALSE;
+      }
+    }
+  }
+
+  // A go forward or back operation?
+  if (historyOfs != 0)
+  {
+    priv->historyPos = newHistoryPos;
+    visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos);
+    topicIndex = visit->topic;
+    section = visit->section;
+  }
+  else priv->historyPos = priv->history->len;   // Go to operation, set history position to after end of array
+
+  priv->topicIndex = topicIndex;
+  visit = historyOfs != 0 ? &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos) : NULL;
+
+  // Display the rendered Markdown topic content (rendered on cache miss)
+  markdown_browser_show_topic (browser, topicIndex, section, visit ? visit->line : 0);
+  markdown_browser_update_section_buttons (browser);
+
+  // Restore vertical position if this is a forward/back operation, otherwise go to the top (cached buffers retain old marks)
+  markdown_browser_scroll_to_line (browser, visit ? visit->line : 0);
+
+  // Update topic tree selection, expanding its directory rows (topic might not be in the tree yet)
+  if (topicIndex >= 0 && topicIndex < priv->topicIters->len
+      && (treeIter = &g_array_index (priv->topicIters, GtkTreeIter, topicIndex))->user_data)
+  {
+    g_signal_handlers_block_by_func (priv->treeSelection, markdown_browser_topic_selection_changed, browser);
+    treePath = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->topicTreeStore), treeIter);     // ++ alloc tree path
+    gtk_tree_view_expand_to_path (gtk_tree_selection_get_tree_view (priv->treeSelection), treePath);
+    gtk_tree_selection_select_iter (priv->treeSelection, treeIter);
+    gtk_tree_path_free (treePath);                      // -- free tree path
+    g_signal_handlers_unblock_by_func (priv->treeSelection, markdown_browser_topic_selection_changed, browser);
+  }
+
+  return TRUE;
+}
+
+/**
+ * markdown_browser_navigate_to_topic_by_name:
+ * @browser: Markdown browser
+ * @name: Topic name or NULL to unset
+ *
+ * Navigate to a topic by name ID.
+ *
+ * Returns: TRUE on success, FALSE if a topic by @name was not found
+ */
+gboolean
+markdown_browser_navigate_to_topic_by_name (MarkdownBrowser *browser, const char *name)
+{
+  int index;
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
+
+  if (name)
+  {
+    index = markdown_browser_get_topic_by_name (browser, name);
+
+    if (index == MARKDOWN_BROWSER_TOPIC_NONE)
+      return FALSE;
+  }
+  else index = MARKDOWN_BROWSER_TOPIC_NONE;
+
+  markdown_browser_navigate (browser, 0, index);
+
+  return TRUE;
+}
+
+// Navigate to the home topic (if set and found), parsing it in a worker thread if it hasn't been already
+static void
+markdown_browser_navigate_home (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  int index;
+
+  if (priv->homeTopic && (index = markdown_browser_get_topic_by_name (browser, priv->homeTopic)) >= 0)
+    markdown_browser_navigate_async (browser, 0, index, NULL, NULL, NULL);
+}
+
+static void
+markdown_browser_back_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  markdown_browser_navigate_async (browser, -1, 0, NULL, NULL, NULL);
+}
+
+static void
+markdown_browser_forward_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  markdown_browser_navigate_async (browser, 1, 0, NULL, NULL, NULL);
+}
+
+static void
+markdown_browser_home_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  markdown_browser_navigate_home (browser);
+}
+
+static void
+markdown_browser_clicker_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  // FIXME - Implement click for topic feature
+}
+
+static void
+markdown_browser_prev_section_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  if (priv->topicIndex >= 0 && priv->section > 0)
+    markdown_browser_navigate_to_section (browser, priv->topicIndex, priv->section - 1);
+}
+
+static void
+markdown_browser_next_section_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  if (priv->topicIndex >= 0 && priv->section + 1 < priv->sections->len)
+    markdown_browser_navigate_to_section (browser, priv->topicIndex, priv->section + 1);
+}
+
+// Update visibility and sensitivity of previous/next section buttons
+static void
+markdown_browser_update_section_buttons (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  gtk_widget_set_visible (priv->prevSectionBtn, priv->paginateLevel > 0);
+  gtk_widget_set_visible (priv->nextSectionBtn, priv->paginateLevel > 0);
+  gtk_widget_set_sensitive (priv->prevSectionBtn, priv->topicIndex >= 0 && priv->section > 0);
+  gtk_widget_set_sensitive (priv->nextSectionBtn, priv->topicIndex >= 0 && priv->section + 1 < priv->sections->len);
+}
+
+/**
+ * markdown_browser_new:
+ * @uiFile: (optional): Optional external user interface (.ui) file to use or NULL to use default builtin data
+ *
+ * Create a new markdown browser widget.
+ * 
+ * Returns: New browser widget
+ */
+GtkWidget *
+markdown_browser_new (const char *uiFile)
+{
+  return GTK_WIDGET (g_object_new (TYPE_MARKDOWN_BROWSER, "ui-file", uiFile, NULL));
+}
+
+/**
+ * markdown_browser_get_topic_by_name:
+ * @browser: Markdown browser
+ * @name: Name of topic
+ *
+ * Get topic index by name ID.  Names of topics in sub directories added by a recursive
+ * markdown_browser_add_files() are qualified with their path ("dir/name") and their directories
+ * are enumerated on demand.
+ *
+ * Returns: Topic index or -1 if not found
+ */
+int
+markdown_browser_get_topic_by_name (MarkdownBrowser *browser, const char *name)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  gpointer index;
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), -1);
+
+  if (!name)
+    return -1;
+
+  if (g_hash_table_lookup_extended (priv->topicNames, name, NULL, &index))
+    return GPOINTER_TO_INT (index);
+
+  // Topic in a sub directory which has not been enumerated yet?
+  if (strchr (name, '/') && markdown_browser_directory_enumerate_path (browser, name)
+      && g_hash_table_lookup_extended (priv->topicNames, name, NULL, &index))
+    return GPOINTER_TO_INT (index);
+
+  return -1;
+}
+
+/**
+ * markdown_browser_get_topics:
+ * @browser: Markdown browser
+ * @count: Location to store length of returned topic array
+ *
+ * Get array of topics in a markdown browser widget.
+ *
+ * Returns: (transfer-none): Array of topic information which is internal to @browser
+ *   and is only valid for the widget lifetime and provided the topic data is not changed.
+ */
+MarkdownBrowserTopic *
+markdown_browser_get_topics (MarkdownBrowser *browser, guint *count)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), NULL);
+  g_return_val_if_fail (count != NULL, NULL);
+
+  *count = priv->topics->len;
+  return (MarkdownBrowserTopic *)(priv->topics->data);
+}
+
+/**
+ * markdown_browser_get_topic_content:
+ * @browser: Markdown browser
+ * @topicIndex: Topic index
+ *
+ * Get the Markdown content of a topic, loading it if it is a lazily loaded topic which is not loaded
+ * (see the lazy-load property).  The @content field of topics returned by markdown_browser_get_topics()
+ * is NULL in that case.
+ *
+ * Returns: (transfer none): Topic content, which is only valid until more lazily loaded topic content is loaded
+ *   (least recently used topics are unloaded when the content-budget property is exceeded), or NULL if
+ *   @topicIndex is invalid, the file of a lazily loaded topic failed to load or the topic was added with
+ *   markdown_browser_add_bundle() (which only contains parsed content).  Content of topics added with markdown_browser_add_topic_bytes() is not necessarily
+ *   NUL terminated, its length is the size of the added #GBytes.
+ */
+const char *
+markdown_browser_get_topic_content (MarkdownBrowser *browser, int topicIndex)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopic *topic;
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), NULL);
+  g_return_val_if_fail (topicIndex >= 0 && topicIndex < priv->topics->len, NULL);
+
+  topic = &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex);
+  markdown_browser_topic_use (browser, topic);
+
+  return topic->content;
+}
+
+#ifdef DEBUG
+
+// Render all of a document of a topic into a new text buffer at once
+static GtkTextBuffer *
+markdown_browser_render_document (MarkdownBrowser *browser, int topicIndex, MarkdownBrowserDocument *doc)  // ++ new text buffer (caller owns)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserRenderBag *bag;
+  GtkTextBuffer *textBuf;
+
+  textBuf = gtk_text_buffer_new (priv->tagTable);      // ++ new text buffer
+
+  bag = g_slice_new (MarkdownBrowserRenderBag);        // ++ alloc render bag
+  bag->priv = priv;
+  bag->textBuf = g_object_ref (textBuf);                // ++ ref text buffer (render bag owns)
+  bag->doc = markdown_browser_document_ref (doc);       // ++ ref document (render bag owns)
+  bag->topic = topicIndex;
+  bag->section = 0;
+  bag->spanIndex = 0;
+  bag->spanEnd = doc->spanCount;
+  bag->run = g_string_new (NULL);                       // ++ new run, priv->renderRun may be in use by a render job
+  bag->runStyle = 0;
+
+  g_object_set_data_full (G_OBJECT (textBuf), "document", markdown_browser_document_ref (doc),
+                          (GDestroyNotify)markdown_browser_document_unref);     // ++ ref document (text buffer owns)
+
+  markdown_browser_render_topic (bag, G_MAXINT64 / 2, 0);
+
+  g_string_free (bag->run, TRUE);                       // -- free run
+  markdown_browser_render_bag_free (bag);
+
+  return textBuf;
+}
+
+// Compare the text and style tags of two rendered text buffers, returns the character offset of the first difference
+// or -1 if they are the same.  Images are compared as the object replacement character of their pixbuf or widget.
+static int
+markdown_browser_compare_buffers (MarkdownBrowserPrivate *priv, GtkTextBuffer *textBuf, GtkTextBuffer *otherTextBuf)
+{
+  GtkTextIter iter, otherIter;
+  int i;
+
+  gtk_text_buffer_get_start_iter (textBuf, &iter);
+  gtk_text_buffer_get_start_iter (otherTextBuf, &otherIter);
+
+  while (TRUE)
+  { // The end iterator has a character of 0, so a shorter buffer differs at its end
+    if (gtk_text_iter_get_char (&iter) != gtk_text_iter_get_char (&otherIter))
+      return gtk_text_iter_get_offset (&iter);
+
+    for (i = 0; i < MARKDOWN_BROWSER_TAG_COUNT; i++)
+      if (gtk_text_iter_has_tag (&iter, priv->tags[i]) != gtk_text_iter_has_tag (&otherIter, priv->tags[i]))
+        return gtk_text_iter_get_offset (&iter);
+
+    if (gtk_text_iter_is_end (&iter))
+      return -1;
+
+    gtk_text_iter_forward_char (&iter);
+    gtk_text_iter_forward_char (&otherIter);
+  }
+}
+
+/**
+ * markdown_browser_check_topic:
+ * @browser: Markdown browser
+ * @topicIndex: Topic index
+ *
+ * Render a topic parsed with the single pass lexer and parsed with the regular expressions the renderer originally
+ * used (see markdown_browser_document_new_regex()) and compare the text and style tags of the two rendered text
+ * buffers.  Only available in debug builds, for checking the lexer.
+ *
+ * Returns: Character offset of the first difference in the rendered text buffers, or -1 if they are the same or the
+ *   topic has no Markdown content (added with markdown_browser_add_bundle())
+ */
+int
+markdown_browser_check_topic (MarkdownBrowser *browser, int topicIndex)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserDocument *doc, *regexDoc;
+  GtkTextBuffer *textBuf, *regexTextBuf;
+  MarkdownBrowserTopicInfo *info;
+  MarkdownBrowserTopic *topic;
+  int ofs;
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), -1);
+  g_return_val_if_fail (topicIndex >= 0 && topicIndex < priv->topics->len, -1);
+
+  topic = &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex);
+  info = &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, topicIndex);
+  markdown_browser_topic_use (browser, topic);          // Load content of a lazily loaded topic
+
+  if (!topic->content)
+    return -1;
+
+  // Parse without a time limit, so the end of the content is never plain text
+  doc = markdown_browser_document_new (topic->content, markdown_browser_topic_content_len (info), 0);      // ++ new document
+  regexDoc = markdown_browser_document_new_regex (topic->content, markdown_browser_topic_content_len (info));  // ++ new document
+
+  textBuf = markdown_browser_render_document (browser, topicIndex, doc);               // ++ new text buffer
+  regexTextBuf = markdown_browser_render_document (browser, topicIndex, regexDoc);     // ++ new text buffer
+
+  ofs = markdown_browser_compare_buffers (priv, textBuf, regexTextBuf);
+
+  g_object_unref (regexTextBuf);                        // -- unref text buffer
+  g_object_unref (textBuf);                             // -- unref text buffer
+  markdown_browser_document_unref (regexDoc);           // -- unref document
+  markdown_browser_document_unref (doc);                // -- unref document
+
+  return ofs;
+}
+
+/**
+ * markdown_browser_set_coalesce_runs:
+ * @browser: Markdown browser
+ * @coalesce: TRUE to insert same-style text as runs with all tags at once (default), FALSE to insert each parsed
+ *   span and apply its tags one by one
+ *
+ * Select how rendered text is inserted into text buffers.  Only available in debug builds, for comparing the two in
+ * benchmarks.  Rendered text buffers are dropped.
+ */
+void
+markdown_browser_set_coalesce_runs (MarkdownBrowser *browser, gboolean coalesce)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+
+  priv->coalesceRuns = coalesce;
+  markdown_browser_render_cancel (browser);
+  markdown_browser_render_cache_trim (browser, 0);      // Rendered the other way
+}
+
+#endif
+
+/**
+ * markdown_browser_get_history:
+ * @browser: Markdown browser
+ * @count: Location to store length of returned history visit array
+ *
+ * Get array of topic history visits in a markdown browser widget.
+ *
+ * Returns: (transfer-none): Array of topic visit history information which is internal to @browser
+ *   and is only valid for the widget lifetime and provided the topic data is not changed.
+ */
+MarkdownBrowserVisit *
+markdown_browser_get_history (MarkdownBrowser *browser, guint *count)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), NULL);
+  g_return_val_if_fail (count != NULL, NULL);
+
+  *count = priv->history->len;
+  return (MarkdownBrowserVisit *)(priv->history->data);
+}
+
+/**
+ * markdown_browser_add_topic:
+ * @browser: Markdown browser
+ * @name: Name identifier of the topic
+ * @title: Title of the topic
+ * @content: Markdown content of the topic
+ *
+ * Add a single topic to a browser widget.
+ */
+void
+markdown_browser_add_topic (MarkdownBrowser *browser, const char *name, const char *title, const char *content)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+
+  markdown_browser_add_topic_take (browser, g_strdup (name), g_strdup (title), g_strdup (content));
+
+  // Do the topic update in an idle function for optimization purposes with multiple topic adds
+  if (!priv->idleId)
+    priv->idleId = g_idle_add (markdown_browser_topics_update, browser);
+}
+
+/**
+ * markdown_browser_add_topic_bytes:
+ * @browser: Markdown browser
+ * @name: Name identifier of the topic
+ * @title: Title of the topic
+ * @content: Markdown content of the topic (need not be NUL terminated)
+ *
+ * Add a single topic to a browser widget, referencing the content data instead of copying it.
+ */
+void
+markdown_browser_add_topic_bytes (MarkdownBrowser *browser, const char *name, const char *title, GBytes *content)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo *info;
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+  g_return_if_fail (content != NULL);
+  g_return_if_fail (g_bytes_get_size (content) <= G_MAXINT);
+
+  // Empty bytes may have NULL data, the content field is always set
+  info = markdown_browser_add_topic_take (browser, g_strdup (name), g_strdup (title),
+                                          g_bytes_get_size (content) > 0 ? (char *)g_bytes_get_data (content, NULL) : "");
+  info->bytes = g_bytes_ref (content);                  // ++ ref bytes (topic owns it, content points into it)
+
+  // Do the topic update in an idle function for optimization purposes with multiple topic adds
+  if (!priv->idleId)
+    priv->idleId = g_idle_add (markdown_browser_topics_update, browser);
+}
+
+/**
+ * markdown_browser_add_topic_static:
+ * @browser: Markdown browser
+ * @name: Name identifier of the topic
+ * @title: Title of the topic
+ * @content: Markdown content of the topic, must remain valid for the lifetime of @browser (a string literal for example)
+ *
+ * Add a single topic to a browser widget without copying its content.
+ */
+void
+markdown_browser_add_topic_static (MarkdownBrowser *browser, const char *name, const char *title, const char *content)
+{
+  GBytes *bytes;
+
+  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+  g_return_if_fail (content != NULL);
+
+  bytes = g_bytes_new_static (content, strlen (content));      // ++ new bytes
+  markdown_browser_add_topic_bytes (browser, name, title, bytes);
+  g_bytes_unref (bytes);                                        // -- unref bytes
+}
+
+// Add a topic, taking over the allocated strings (content is NULL for a lazily loaded topic), returns the private data
+// of the new topic, which is cleared (the document is parsed on first render).  The topic tree is not updated.
+static MarkdownBrowserTopicInfo *
+markdown_browser_add_topic_take (MarkdownBrowser *browser, char *name, char *title, char *content)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo info = { 0 };
+  MarkdownBrowserTopic *topic;
+
+  g_array_set_size (priv->topics, priv->topics->len + 1);
+  topic = &g_array_index (priv->topics, MarkdownBrowserTopic, priv->topics->len - 1);
+  topic->name = name;           // !! takes over name
+  topic->title = title;         // !! takes over title
+  topic->content = content;     // !! takes over content
+  info.id = ++priv->topicIdSerial;
+  g_array_append_val (priv->topicInfo, info);
+
+  // First topic with a given name wins, same as when topics are sorted
+  if (topic->name && !g_hash_table_contains (priv->topicNames, topic->name))
+    g_hash_table_insert (priv->topicNames, topic->name, GINT_TO_POINTER (priv->topics->len - 1));
+
+  return markdown_browser_topic_info (priv, topic);
+}
+
+/**
+ * markdown_browser_add_files:
+ * @browser: Markdown browser
+ * @path: Path to add markdown content files from
+ * @fileMatch: File matching Perl compatible regular expression
+ *   (NULL for default of "(.*)\\.(md|markdown)$", group capture is used as topic name)
+ * @titleMatch: Perl compatible regular expression to extract title from file content
+ *   (NULL for default of "^ {0,3}\# (.*)" for h1 header), group capture is the title text
+ *
+ * Add markdown files in a directory.  Files are read and their titles extracted by a pool of threads,
+ * one per processor.  If the lazy-load property is set, only the start of each file is read for the title
+ * and content is loaded when the topic is shown.  If the recursive property is set, sub directories are
+ * added as directory rows of the topic tree which are enumerated when expanded, or when a topic in
+ * them is looked up by its path qualified name ("dir/name").  If the watch property is set, the
+ * directory (and sub directories once enumerated) is monitored and topics are reloaded when their
+ * files change, new files are appended as topics.
+ */
+gboolean
+markdown_browser_add_files (MarkdownBrowser *browser, const char *path, const char *fileMatch,
+                     const char *titleMatch, GError **err)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GRegex *fileRegex, *titleRegex;
+  gboolean retval;
 
-        break;
-      }
-      case REGEX_LINK:
-        // Add mark for link URL
-        s = g_match_info_fetch (nextMatchInfo, 2);      // ++ allocate link URL
-        mark = gtk_text_buffer_create_mark (priv->textBuffer, NULL, &bag.iter, TRUE);
-        g_object_set_data_full (G_OBJECT (mark), "link", s, g_free);            // !! Mark object takes over link URL
-
-        bag.link = TRUE;
-        s = g_match_info_fetch (nextMatchInfo, 1);      // ++ allocate linked text
-        markdown_browser_buffer_append (&bag, s, -1);
-        g_free (s);                                     // -- free linked text
-        bag.link = FALSE;
-        break;
-      case REGEX_EMPHASIS_END:
-        g_match_info_fetch_pos (nextMatchInfo, 0, &startPos, &endPos);          // Get start/end position of emphasis chars
-        count = endPos - startPos;
-        bag.italic &= (count & 1) ? 0 : 1;      // 1 or 3 * or _ characters disables italic
-        bag.bold &= (count & 2) ? 0 : 1;        // 2 or 3 * or _ characters enables bold
-        break;
-      case REGEX_HEADER_OR_LIST_ITEM_END:
-        bag.headerSize = 0;
-        bag.listItem = FALSE;
-        break;
-    }
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (!err || !*err, FALSE);
+
+  if (!(fileRegex = g_regex_new (fileMatch ? fileMatch : DEFAULT_FILE_MATCH, 0, 0, err)))       // ++ new fileRegex
+    return FALSE;
+
+  if (!(titleRegex = g_regex_new (titleMatch ? titleMatch : DEFAULT_TITLE_MATCH,        // ++ new titleRegex
+                                  G_REGEX_MULTILINE, 0, err)))
+  {
+    g_regex_unref (fileRegex);  // -- unref fileRegex
+    return FALSE;
+  }
 
-    // Skip "matched" portion of last match pattern (does not include look ahead patterns)
-    g_match_info_fetch_pos (nextMatchInfo, 0, NULL, &contentPos);
+  retval = markdown_browser_directory_load (browser, path, "", fileRegex, titleRegex, priv->lazyLoad,
+                                            priv->recursive, NULL, err);
 
-    // Free last processed match and search for next match of the same type
-    g_match_info_free (nextMatchInfo);
-    nextMatchInfo = NULL;
+  if (retval && priv->watch)
+    markdown_browser_watch_directory (browser, path, "", fileRegex, titleRegex, priv->lazyLoad);
 
-    if (nextRegexEnum < REGEX_FIRST_END_MATCH)
-    {
-      if (!g_regex_match_full (regexes[nextRegexEnum], content, contentLen, contentPos, 0, &matchInfo, NULL))
-      {
-        g_match_info_free (matchInfo);
-        matchInfo = NULL;
-      }
+  g_regex_unref (titleRegex);   // -- unref titleRegex
+  g_regex_unref (fileRegex);    // -- unref fileRegex
 
-      bag.nextRegexMatch[nextRegexEnum] = matchInfo;
-    }
-    else bag.nextRegexMatch[nextRegexEnum] = NULL;     // End tags are checked conditionally below
+  if (retval)
+    markdown_browser_topics_added (browser);
 
-    // Process next END matches according to current open tags
-    for (regexEnum = REGEX_FIRST_END_MATCH; regexEnum < REGEX_COUNT; regexEnum++)
-    {
-      if (!bag.nextRegexMatch[regexEnum]
-          && ((regexEnum == REGEX_EMPHASIS_END && (bag.italic || bag.bold))
-              || (regexEnum == REGEX_HEADER_OR_LIST_ITEM_END && (bag.headerSize > 0 || bag.listItem))))
-      {
-        if (!g_regex_match_full (regexes[regexEnum], content, contentLen, contentPos, 0, &matchInfo, NULL))
-        {
-          g_match_info_free (matchInfo);
-          matchInfo = NULL;
-        }
+  return retval;
+}
 
-        bag.nextRegexMatch[regexEnum] = matchInfo;
-      }
-    }
+// Add the markdown files of a directory as topics with a name prefix (appended in directory order, topic tree is not
+// updated).  If recursive, sub directories are registered for enumeration on demand and added to subdirs (if not NULL).
+static gboolean
+markdown_browser_directory_load (MarkdownBrowser *browser, const char *path, const char *prefix,
+                                 GRegex *fileRegex, GRegex *titleRegex, gboolean lazy, gboolean recursive,
+                                 GPtrArray *subdirs, GError **err)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserDirectory *directory;
+  MarkdownBrowserFileLoad *load;
+  MarkdownBrowserTopicInfo *info;
+  GMatchInfo *fileMatchInfo;
+  GThreadPool *pool;
+  GPtrArray *loads;
+  const char *filename;
+  char *fullpath, *name;
+  GDir *dir;
+  guint i;
 
-    nextMatchPos = contentLen;
+  if (!(dir = g_dir_open (path, 0, err)))       // ++ open GDir
+    return FALSE;
 
-    // Find next tag
-    for (regexEnum = 0; regexEnum < REGEX_COUNT; regexEnum++)
+  loads = g_ptr_array_new ();   // ++ new array of file loads
+
+  // Loop over files
+  while ((filename = g_dir_read_name (dir)))
+  {
+    if (g_regex_match (fileRegex, filename, 0, &fileMatchInfo)) // ++ allocate file
     {
-      if (bag.nextRegexMatch[regexEnum])
-      {
-        g_match_info_fetch_pos (bag.nextRegexMatch[regexEnum], 0, &startPos, NULL);
+      load = g_slice_new0 (MarkdownBrowserFileLoad);                    // ++ alloc file load
+      load->fullpath = g_build_filename (path, filename, NULL);         // ++ alloc full path
+      name = g_match_info_fetch (fileMatchInfo, 1);                     // ++ alloc topic name in file match
+      load->name = g_strconcat (prefix, name, NULL);                    // ++ alloc path qualified topic name
+      g_free (name);                                                    // -- free topic name
+      load->lazy = lazy;
+      g_ptr_array_add (loads, load);
+    }
+    else if (recursive)
+    {
+      fullpath = g_build_filename (path, filename, NULL);              // ++ alloc full path
+      name = g_strconcat (prefix, filename, "/", NULL);                // ++ alloc directory prefix
 
-        if (startPos < nextMatchPos)
-        {
-          nextMatchInfo = bag.nextRegexMatch[regexEnum];
-          nextMatchPos = startPos;
-          nextRegexEnum = regexEnum;
-        }
+      if (g_file_test (fullpath, G_FILE_TEST_IS_DIR) && !g_hash_table_contains (priv->directories, name))
+      {
+        directory = g_slice_new0 (MarkdownBrowserDirectory);           // ++ alloc directory
+        directory->prefix = name;                                      // !! takes over directory prefix
+        directory->path = fullpath;                                    // !! takes over full path
+        directory->fileRegex = g_regex_ref (fileRegex);                // ++ ref fileRegex
+        directory->titleRegex = g_regex_ref (titleRegex);              // ++ ref titleRegex
+        directory->lazy = lazy;
+        g_hash_table_insert (priv->directories, directory->prefix, directory);      // !! takes over directory
+
+        if (subdirs)
+          g_ptr_array_add (subdirs, directory);
+      }
+      else
+      {
+        g_free (name);          // -- free directory prefix
+        g_free (fullpath);      // -- free full path
       }
     }
 
-    // No more tags?
-    if (!nextMatchInfo)
-    {
-      if (contentPos < contentLen)
-        markdown_browser_buffer_append (&bag, content + contentPos, contentLen - contentPos);
+    g_match_info_free (fileMatchInfo);  // -- free file match info
+  }
 
-      break;
+  g_dir_close (dir);            // -- close GDir
+
+  // Load files in parallel, regexes are safe to match from multiple threads
+  if (loads->len > 0)
+  {
+    pool = g_thread_pool_new (markdown_browser_file_load_thread, titleRegex,     // ++ new thread pool
+                              MIN (g_get_num_processors (), loads->len), FALSE, NULL);
+
+    for (i = 0; i < loads->len; i++)
+      g_thread_pool_push (pool, g_ptr_array_index (loads, i), NULL);
+
+    g_thread_pool_free (pool, FALSE, TRUE);     // -- free thread pool, waiting for all files to load
+  }
+
+  // Add topics in directory order
+  for (i = 0; i < loads->len; i++)
+  {
+    load = g_ptr_array_index (loads, i);
+
+    if (load->err)
+    {
+      g_warning ("Failed to load markdown file '%s': %s", load->fullpath, load->err->message);
+      g_clear_error (&load->err);
+      g_free (load->name);      // -- free name
+      g_free (load->fullpath);  // -- free full path
+    }
+    else if (load->lazy)
+    {
+      info = markdown_browser_add_topic_take (browser, load->name, load->title, NULL);         // !! takes over strings
+      info->path = load->fullpath;                      // !! topic takes over full path
+    }
+    else
+    {
+      info = markdown_browser_add_topic_take (browser, load->name, load->title, load->content);   // !! takes over strings
+      info->hash = load->hash;                          // !! topic takes over content hash
+      g_free (load->fullpath);  // -- free full path
     }
 
-    // If list is active and end of list item, but this is not the start of another list item, deactivate list
-    if (bag.listLevel > 0 && !bag.listItem && nextRegexEnum != REGEX_BULLET_ITEM_START
-        && nextRegexEnum != REGEX_NUMERIC_ITEM_START)
-      bag.listLevel = 0;
-  }     // for content
+    g_slice_free (MarkdownBrowserFileLoad, load);       // -- free file load
+  }
+
+  g_ptr_array_free (loads, TRUE);       // -- free array of file loads
+
+  return TRUE;
+}
+
+// Sort topics after adding a set of topics and reset state which depends on topic indexes
+static void
+markdown_browser_topics_added (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  GArray *order, *topics, *topicInfo;
+  int index;
+  guint i;
+
+  // Sort topics alphabetically, private topic data is kept at the same indexes
+  order = g_array_sized_new (FALSE, FALSE, sizeof (int), priv->topics->len);  // ++ new order array
+
+  for (index = 0; index < priv->topics->len; index++)
+    g_array_append_val (order, index);
+
+  g_array_sort_with_data (order, markdown_browser_topic_index_sort, priv->topics);
+
+  topics = g_array_sized_new (FALSE, FALSE, sizeof (MarkdownBrowserTopic), priv->topics->len);          // ++ new topics
+  topicInfo = g_array_sized_new (FALSE, FALSE, sizeof (MarkdownBrowserTopicInfo), priv->topics->len);   // ++ new topic info
+
+  for (i = 0; i < order->len; i++)
+  {
+    index = g_array_index (order, int, i);
+    g_array_append_val (topics, g_array_index (priv->topics, MarkdownBrowserTopic, index));
+    g_array_append_val (topicInfo, g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, index));
+  }
+
+  g_array_free (order, TRUE);                   // -- free order array
+  g_array_free (priv->topics, TRUE);            // -- free old topics (entries were moved)
+  g_array_free (priv->topicInfo, TRUE);         // -- free old topic info (entries were moved)
+  priv->topics = topics;                        // !! takes over topics
+  priv->topicInfo = topicInfo;                  // !! takes over topic info
+  markdown_browser_topic_names_rebuild (browser);
+
+  // Rendered topic buffers are keyed by topic index which is no longer valid
+  markdown_browser_render_cancel (browser);
+  markdown_browser_render_cache_trim (browser, 0);
+  g_array_set_size (priv->topicIters, 0);       // Topic tree is rebuilt in idle callback
+
+  // Reset selected topic and history which is no longer valid
+  g_array_set_size (priv->history, 0);
+  priv->historyPos = 0;
+  priv->topicIndex = -1;
+
+  // Do the topic update in an idle function for optimization purposes with multiple topic adds
+  if (!priv->idleId)
+    priv->idleId = g_idle_add (markdown_browser_topics_update, browser);
 }
 
 /**
- * markdown_browser_navigate:
+ * markdown_browser_add_resources:
  * @browser: Markdown browser
- * @historyOfs: History position offset (0: go to new @topicIndex, -1: back 1 in history, 1: forward 1 in history, etc)
- * @topicIndex: Topic index to go to (if @historyOfs == 0)
+ * @path: GResource path to add markdown content from, such as "/com/example/help/"
+ * @fileMatch: File matching Perl compatible regular expression
+ *   (NULL for default of "(.*)\\.(md|markdown)$", group capture is used as topic name)
+ * @titleMatch: Perl compatible regular expression to extract title from file content
+ *   (NULL for default of "^ {0,3}\# (.*)" for h1 header), group capture is the title text
+ * @err: Location to store error or NULL
  *
- * Navigate to new topic or forward/back in history.
+ * Add markdown files of a registered GResource path (not recursive), like markdown_browser_add_files().
+ * Topic content references the resource data without copying it.  Images of these topics are loaded from
+ * the resource path instead of the images-path property (see markdown_browser_compile_resources() in
+ * MarkdownBrowserResources.cmake to compile a directory of topics and images).
+ *
+ * Returns: TRUE on success, FALSE on error (@err is set)
  */
-void
-markdown_browser_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex)
-{
-  if (markdown_browser_real_navigate (browser, historyOfs, topicIndex))
-    g_object_notify (G_OBJECT (browser), "topic-index");
-}
-
-static gboolean
-markdown_browser_real_navigate (MarkdownBrowser *browser, int historyOfs, int topicIndex)
+gboolean
+markdown_browser_add_resources (MarkdownBrowser *browser, const char *path, const char *fileMatch,
+                                const char *titleMatch, GError **err)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  MarkdownBrowserTopic *topic;
-  MarkdownBrowserVisit *visit;
-  GtkTreeIter treeIter;
-  GtkTextIter textIter;
-  GdkRectangle rect;
-  int newHistoryPos;
+  MarkdownBrowserTopicInfo *info;
+  GRegex *fileRegex, *titleRegex;
+  GMatchInfo *fileMatchInfo, *titleMatchInfo;
+  char **children, *fullpath, *name, *title;
+  const char *content;
+  GError *local_err = NULL;
+  GBytes *bytes;
+  gsize len;
+  int i;
 
-  newHistoryPos = priv->historyPos + historyOfs;
+  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (!err || !*err, FALSE);
 
-  // Ignore invalid history offset or topicIndex values
-  if ((historyOfs != 0 && (newHistoryPos < 0 || newHistoryPos >= priv->history->len))
-      || (historyOfs == 0 && ((topicIndex < 0 && topicIndex != MARKDOWN_BROWSER_TOPIC_NONE)
-                              || topicIndex >= priv->topics->len)))
+  if (!(children = g_resources_enumerate_children (path, G_RESOURCE_LOOKUP_FLAGS_NONE, err)))  // ++ alloc children
     return FALSE;
 
-  // Save current topic state in history if set
-  if (priv->topicIndex != MARKDOWN_BROWSER_TOPIC_NONE)
+  if (!(fileRegex = g_regex_new (fileMatch ? fileMatch : DEFAULT_FILE_MATCH, 0, 0, err)))       // ++ new fileRegex
   {
-    if (priv->historyPos < priv->history->len)
-    { // Overwrite the entry at the current position
-      visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos);
+    g_strfreev (children);      // -- free children
+    return FALSE;
+  }
 
-      // Go to operation truncates forward history
-      if (historyOfs == 0)
-        g_array_set_size (priv->history, priv->historyPos + 1);
-    }
-    else        // Append entry on end of history
+  if (!(titleRegex = g_regex_new (titleMatch ? titleMatch : DEFAULT_TITLE_MATCH,        // ++ new titleRegex
+                                  G_REGEX_MULTILINE, 0, err)))
+  {
+    g_regex_unref (fileRegex);  // -- unref fileRegex
+    g_strfreev (children);      // -- free children
+    return FALSE;
+  }
+
+  // Loop over resources, sub directories end with a '/' and don't match
+  for (i = 0; children[i]; i++)
+  {
+    if (g_regex_match (fileRegex, children[i], 0, &fileMatchInfo))     // ++ allocate file match info
     {
-      g_array_set_size (priv->history, priv->history->len + 1);
-      visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->history->len - 1);
-    }
+      fullpath = g_build_path ("/", path, children[i], NULL);          // ++ alloc full path
 
-    visit->topic = priv->topicIndex;
+      // Resource data is NUL terminated, but the terminator is not included in its size
+      if ((bytes = g_resources_lookup_data (fullpath, G_RESOURCE_LOOKUP_FLAGS_NONE, &local_err)))     // ++ ref data
+      {
+        content = g_bytes_get_data (bytes, &len);
+        name = g_match_info_fetch (fileMatchInfo, 1);           // ++ alloc topic name in file match
 
-    gtk_text_view_get_visible_rect (priv->textView, &rect);
-    gtk_text_view_get_iter_at_location (priv->textView, &textIter, 0, rect.y);
-    visit->line = gtk_text_iter_get_line (&textIter);
+        if (content && g_regex_match_full (titleRegex, content, len, 0, 0, &titleMatchInfo, NULL))    // ++ allocate title match info
+          title = g_match_info_fetch (titleMatchInfo, 1);       // ++ allocate title
+        else title = NULL;
 
-    // Remove old entries if history size exceeded
-    if (priv->history->len > priv->historyMax)
-    {
-      newHistoryPos -= priv->history->len - priv->historyMax;          // Adjust new history position after deletion
-      g_array_remove_range (priv->history, 0, priv->history->len - priv->historyMax);
+        if (content)
+          g_match_info_free (titleMatchInfo);                   // -- free title match info
 
-      // Could happen..  Original history being navigated to is now gone..  Just stay where we are (adjust for deletion)
-      if (newHistoryPos < 0)
+        info = markdown_browser_add_topic_take (browser, name, title, content ? (char *)content : "");        // !! takes over name and title
+        info->bytes = bytes;                                    // !! topic takes over data ref
+        info->imagesPath = g_strconcat (MARKDOWN_BROWSER_RESOURCE_PREFIX, path, NULL);   // ++ alloc images path
+      }
+      else
       {
-        priv->historyPos -= priv->historyMax - priv->history->len;
-        return FALSE;
+        g_warning ("Failed to load markdown resource '%s': %s", fullpath, local_err->message);
+        g_clear_error (&local_err);
       }
-    }
-  }
-
-  // A go forward or back operation?
-  if (historyOfs != 0)
-  {
-    priv->historyPos = newHistoryPos;
-    visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos);
-    topicIndex = visit->topic;
-  }
-  else priv->historyPos = priv->history->len;   // Go to operation, set history position to after end of array
-
-  priv->topicIndex = topicIndex;
-  topic = topicIndex >= 0 ? &g_array_index (priv->topics, MarkdownBrowserTopic, topicIndex) : NULL;
 
-  // Render the Markdown topic content to the GtkTextBuffer
-  markdown_browser_render_topic (browser, topic);
+      g_free (fullpath);        // -- free full path
+    }
 
-  // Restore vertical position if this is a forward/back operation
-  if (historyOfs != 0)
-  { // Add a marker and scroll to it, supposedly this is the most reliable method to scroll in a text view
-    // FIXME - Unfortunately attempting to scroll at this point does not work, we try later in the size-allocate signal of GtkTextView
-    visit = &g_array_index (priv->history, MarkdownBrowserVisit, priv->historyPos);
-    gtk_text_buffer_get_iter_at_line (priv->textBuffer, &textIter, visit->line);
-    gtk_text_buffer_create_mark (priv->textBuffer, "scroll", &textIter, TRUE);
+    g_match_info_free (fileMatchInfo);  // -- free file match info
   }
 
-  priv->scrollToLine = historyOfs != 0;
+  g_regex_unref (titleRegex);   // -- unref titleRegex
+  g_regex_unref (fileRegex);    // -- unref fileRegex
+  g_strfreev (children);        // -- free children
 
-  // Update topic tree selection
-  if (topicIndex >= 0)
-  {
-    g_signal_handlers_block_by_func (priv->treeSelection, markdown_browser_topic_selection_changed, browser);
-    gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (priv->topicListStore), &treeIter, NULL, topicIndex);       // Get the nth node in list (parent == NULL)
-    gtk_tree_selection_select_iter (priv->treeSelection, &treeIter);
-    g_signal_handlers_unblock_by_func (priv->treeSelection, markdown_browser_topic_selection_changed, browser);
-  }
+  markdown_browser_topics_added (browser);
 
   return TRUE;
 }
 
 /**
- * markdown_browser_navigate_to_topic_by_name:
+ * markdown_browser_add_bundle:
  * @browser: Markdown browser
- * @name: Topic name or NULL to unset
+ * @filename: Help bundle file compiled by markdown-browser-compile
+ * @err: Location to store error or NULL
  *
- * Navigate to a topic by name ID.
+ * Add the topics and images of a precompiled help bundle (see markdown_browser_compile_bundle() in
+ * MarkdownBrowserBundle.cmake).  The bundle is memory mapped and topics are rendered from its parsed
+ * representation, so no Markdown is read, matched or parsed.  Images of these topics are loaded from the
+ * bundle instead of the images-path property.
  *
- * Returns: TRUE on success, FALSE if a topic by @name was not found
+ * Returns: TRUE on success, FALSE on error (@err is set)
  */
 gboolean
-markdown_browser_navigate_to_topic_by_name (MarkdownBrowser *browser, const char *name)
+markdown_browser_add_bundle (MarkdownBrowser *browser, const char *filename, GError **err)
 {
-  int index;
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopicInfo *info;
+  MarkdownBrowserBundle *bundle;
+  char *imagesPath, *imageName;
+  GBytes *data;
+  guint i, count;
 
   g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (!err || !*err, FALSE);
 
-  if (name)
+  if (!(bundle = markdown_browser_bundle_open (filename, err)))        // ++ open bundle
+    return FALSE;
+
+  // Images are registered with the image cache under an images path of the bundle, like files in an images directory
+  imagesPath = g_strconcat (MARKDOWN_BROWSER_BUNDLE_PREFIX, filename, NULL);   // ++ alloc images path
+  count = markdown_browser_bundle_get_topic_count (bundle);
+
+  for (i = 0; i < count; i++)
+  {
+    info = markdown_browser_add_topic_take (browser,
+                                            g_strdup (markdown_browser_bundle_get_topic_name (bundle, i)),     // ++ alloc name
+                                            g_strdup (markdown_browser_bundle_get_topic_title (bundle, i)),    // ++ alloc title
+                                            NULL);
+    info->bundle = markdown_browser_bundle_ref (bundle);               // ++ ref bundle (topic holds it)
+    info->bundleIndex = i;
+    info->imagesPath = g_strdup (imagesPath);                          // ++ alloc images path (topic owns it)
+  }
+
+  markdown_browser_topics_added (browser);
+
+  count = markdown_browser_bundle_get_image_count (bundle);
+
+  for (i = 0; i < count; i++)
+  {
+    imageName = g_build_filename (imagesPath, markdown_browser_bundle_get_image_name (bundle, i), NULL);   // ++ alloc image name
+    data = markdown_browser_bundle_get_image_data (bundle, i);         // ++ new image data
+    markdown_browser_image_cache_add_data (imageName, data);
+    g_bytes_unref (data);                                               // -- unref image data
+    g_free (imageName);                                                 // -- free image name
+  }
+
+  g_free (imagesPath);                         // -- free images path
+  markdown_browser_bundle_unref (bundle);      // -- unref bundle (topics hold their own references)
+
+  return TRUE;
+}
+
+// Thread pool function which loads a Markdown file and extracts its title (data is MarkdownBrowserFileLoad),
+// also called directly to reload a watched file
+static void
+markdown_browser_file_load_thread (gpointer data, gpointer user_data)
+{
+  MarkdownBrowserFileLoad *load = data;
+  GRegex *titleRegex = user_data;
+  const char *titleMatch = g_regex_get_pattern (titleRegex);
+  GMatchInfo *titleMatchInfo;
+  GMappedFile *mappedFile;
+  const char *content;
+  GStatBuf statBuf;
+  gboolean cache;
+  gsize len;
+
+  // Status is taken before reading, so a file changed while being read is not recorded as unchanged
+  cache = g_stat (load->fullpath, &statBuf) == 0;
+
+  // A lazily loaded file which has not changed is not read at all, its title is in the parse cache
+  if (cache && load->lazy
+      && markdown_browser_parse_cache_lookup_source (load->fullpath, &statBuf, titleMatch, NULL, 0, &load->title, NULL))
+    return;
+
+  if (!(mappedFile = g_mapped_file_new (load->fullpath, FALSE, &load->err)))   // ++ map file
+    return;
+
+  // Contents are NULL for an empty file and are not NUL terminated
+  content = g_mapped_file_get_contents (mappedFile);
+  len = g_mapped_file_get_length (mappedFile);
+
+  if (load->lazy)       // Only search the start of the file for the title, only those pages are read
+  {
+    if (content && g_regex_match_full (titleRegex, content, MIN (len, TITLE_SCAN_SIZE), 0, 0,    // ++ allocate title match info
+                                       &titleMatchInfo, NULL))
+      load->title = g_match_info_fetch (titleMatchInfo, 1);                     // ++ allocate title
+
+    if (content)
+      g_match_info_free (titleMatchInfo);                                       // -- free title match info
+
+    g_mapped_file_unref (mappedFile);                                           // -- unmap file
+
+    if (cache)
+      markdown_browser_parse_cache_save_source (load->fullpath, &statBuf, titleMatch, load->title, NULL);
+
+    return;
+  }
+
+  // The single copy becomes the topic content
+  load->content = content ? g_strndup (content, len) : g_strdup ("");          // ++ alloc content
+  g_mapped_file_unref (mappedFile);                                             // -- unmap file
+
+  // Title of an unchanged file is in the parse cache, the content hash identifies its parsed document
+  if (cache && markdown_browser_parse_cache_lookup_source (load->fullpath, &statBuf, titleMatch, load->content, -1,
+                                                           &load->title, &load->hash))  // ++ alloc title and hash
+    return;
+
+  if (g_regex_match (titleRegex, load->content, 0, &titleMatchInfo))           // ++ allocate title match info
+    load->title = g_match_info_fetch (titleMatchInfo, 1);                       // ++ allocate title
+
+  g_match_info_free (titleMatchInfo);                                           // -- free title match info
+
+  if (load->hash)
+    markdown_browser_parse_cache_save_source (load->fullpath, &statBuf, titleMatch, load->title, load->hash);
+}
+
+// Rebuild topic name index after topics have been re-ordered
+static void
+markdown_browser_topic_names_rebuild (MarkdownBrowser *browser)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopic *topic;
+  guint i;
+
+  g_hash_table_remove_all (priv->topicNames);
+
+  for (i = 0; i < priv->topics->len; i++)
   {
-    index = markdown_browser_get_topic_by_name (browser, name);
+    topic = &g_array_index (priv->topics, MarkdownBrowserTopic, i);
 
-    if (index == MARKDOWN_BROWSER_TOPIC_NONE)
-      return FALSE;
+    if (topic->name && !g_hash_table_contains (priv->topicNames, topic->name))
+      g_hash_table_insert (priv->topicNames, topic->name, GINT_TO_POINTER (i));
   }
-  else index = MARKDOWN_BROWSER_TOPIC_NONE;
+}
 
-  markdown_browser_navigate (browser, 0, index);
+static int
+markdown_browser_topic_index_sort (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  GArray *topics = user_data;
 
-  return TRUE;
+  return strcmp (g_array_index (topics, MarkdownBrowserTopic, *(const int *)a).name,
+                 g_array_index (topics, MarkdownBrowserTopic, *(const int *)b).name);
 }
 
-static void
-markdown_browser_back_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+static int
+markdown_browser_directory_sort (gconstpointer a, gconstpointer b)
 {
-  markdown_browser_navigate (browser, -1, 0);
+  const MarkdownBrowserDirectory *adir = *(MarkdownBrowserDirectory * const *)a, *bdir = *(MarkdownBrowserDirectory * const *)b;
+  return strcmp (adir->prefix, bdir->prefix);
 }
 
-static void
-markdown_browser_forward_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+// Get the tree row of the directory containing a topic or directory name (len excludes a directory's trailing '/').
+// Returns NULL for top level names.
+static GtkTreeIter *
+markdown_browser_topic_tree_parent (MarkdownBrowser *browser, const char *name, int len)
 {
-  markdown_browser_navigate (browser, 1, 0);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserDirectory *directory;
+  const char *slash;
+  char *prefix;
+
+  if (!(slash = g_strrstr_len (name, len, "/")))
+    return NULL;
+
+  prefix = g_strndup (name, slash - name + 1);          // ++ alloc prefix
+  directory = g_hash_table_lookup (priv->directories, prefix);
+  g_free (prefix);                                      // -- free prefix
+
+  return directory && directory->inTree ? &directory->iter : NULL;
 }
 
+// Add a directory row to the topic tree, with a placeholder child row if it hasn't been enumerated (for the expander)
 static void
-markdown_browser_home_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+markdown_browser_topic_tree_add_directory (MarkdownBrowser *browser, MarkdownBrowserDirectory *directory)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-
-  if (priv->homeTopic)
-    markdown_browser_navigate_to_topic_by_name (browser, priv->homeTopic);
+  GtkTreeIter iter;
+  char *title;
+  int len;
+
+  len = strlen (directory->prefix) - 1;
+  title = g_path_get_basename (directory->path);       // ++ alloc title
+
+  gtk_tree_store_append (priv->topicTreeStore, &directory->iter,
+                         markdown_browser_topic_tree_parent (browser, directory->prefix, len));
+  gtk_tree_store_set (priv->topicTreeStore, &directory->iter,
+                      TOPIC_COLUMN_TITLE, title,
+                      TOPIC_COLUMN_INDEX, -1,
+                      TOPIC_COLUMN_DIRECTORY, directory->prefix,
+                      -1);
+  directory->inTree = TRUE;
+  g_free (title);                                       // -- free title
+
+  if (!directory->enumerated)
+  {
+    gtk_tree_store_append (priv->topicTreeStore, &iter, &directory->iter);
+    gtk_tree_store_set (priv->topicTreeStore, &iter, TOPIC_COLUMN_INDEX, -1, -1);
+  }
 }
 
+// Add rows for topics to the topic tree in name order, under their directory rows
 static void
-markdown_browser_clicker_clicked (GtkWidget *widget, MarkdownBrowser *browser)
+markdown_browser_topic_tree_add_topics (MarkdownBrowser *browser, guint first, guint last)
 {
-  // FIXME - Implement click for topic feature
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserTopic *topic;
+  GtkTreeIter *iter;
+  GArray *order;
+  guint i;
+  int index;
+
+  if (priv->topicIters->len < priv->topics->len)
+    g_array_set_size (priv->topicIters, priv->topics->len);
+
+  // Topics are only sorted by markdown_browser_add_files(), topics of enumerated directories are appended
+  order = g_array_sized_new (FALSE, FALSE, sizeof (int), last - first);        // ++ new order array
+
+  for (index = first; index < last; index++)
+    g_array_append_val (order, index);
+
+  g_array_sort_with_data (order, markdown_browser_topic_index_sort, priv->topics);
+
+  for (i = 0; i < order->len; i++)
+  {
+    index = g_array_index (order, int, i);
+    topic = &g_array_index (priv->topics, MarkdownBrowserTopic, index);
+    iter = &g_array_index (priv->topicIters, GtkTreeIter, index);
+
+    gtk_tree_store_append (priv->topicTreeStore, iter, markdown_browser_topic_tree_parent (browser, topic->name, -1));
+    gtk_tree_store_set (priv->topicTreeStore, iter,
+                        TOPIC_COLUMN_TITLE, topic->title,
+                        TOPIC_COLUMN_INDEX, index,
+                        -1);
+  }
+
+  g_array_free (order, TRUE);                           // -- free order array
 }
 
-/**
- * markdown_browser_new:
- * @uiFile: (optional): Optional external user interface (.ui) file to use or NULL to use default builtin data
- *
- * Create a new markdown browser widget.
- * 
- * Returns: New browser widget
- */
-GtkWidget *
-markdown_browser_new (const char *uiFile)
+// Add directory rows to the topic tree in name order (parents sort before their sub directories)
+static void
+markdown_browser_topic_tree_add_directories (MarkdownBrowser *browser, GPtrArray *directories)
 {
-  return GTK_WIDGET (g_object_new (TYPE_MARKDOWN_BROWSER, "ui-file", uiFile, NULL));
+  guint i;
+
+  g_ptr_array_sort (directories, markdown_browser_directory_sort);
+
+  for (i = 0; i < directories->len; i++)
+    markdown_browser_topic_tree_add_directory (browser, g_ptr_array_index (directories, i));
 }
 
-/**
- * markdown_browser_get_topic_by_name:
- * @browser: Markdown browser
- * @name: Name of topic
- *
- * Get topic index by name ID.
- *
- * Returns: Topic index or -1 if not found
- */
-int
-markdown_browser_get_topic_by_name (MarkdownBrowser *browser, const char *name)
+// Enumerate a directory registered by a recursive markdown_browser_add_files() and add its rows to the topic tree.
+// Topics are appended, so topic indexes remain valid.
+static void
+markdown_browser_directory_enumerate (MarkdownBrowser *browser, MarkdownBrowserDirectory *directory)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  int i;
+  GPtrArray *subdirs;
+  GtkTreeIter child;
+  GError *err = NULL;
+  guint first;
 
-  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), -1);
+  if (directory->enumerated)
+    return;
 
-  if (name)
+  directory->enumerated = TRUE;
+  first = priv->topics->len;
+  subdirs = g_ptr_array_new ();                         // ++ new sub directory array
+
+  if (!markdown_browser_directory_load (browser, directory->path, directory->prefix, directory->fileRegex,
+                                        directory->titleRegex, directory->lazy, TRUE, subdirs, &err))
   {
-    for (i = 0; i < priv->topics->len; i++)
-      if (strcmp (name, g_array_index (priv->topics, MarkdownBrowserTopic, i).name) == 0)
-        return i;
+    g_warning ("Failed to load Markdown files from path '%s': %s", directory->path, err->message);
+    g_clear_error (&err);
   }
+  else if (priv->watch)
+    markdown_browser_watch_directory (browser, directory->path, directory->prefix, directory->fileRegex,
+                                      directory->titleRegex, directory->lazy);
 
-  return -1;
-}
-
-/**
- * markdown_browser_get_topics:
- * @browser: Markdown browser
- * @count: Location to store length of returned topic array
- *
- * Get array of topics in a markdown browser widget.
- *
- * Returns: (transfer-none): Array of topic information which is internal to @browser
- *   and is only valid for the widget lifetime and provided the topic data is not changed.
- */
-MarkdownBrowserTopic *
-markdown_browser_get_topics (MarkdownBrowser *browser, guint *count)
-{
-  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  // Replace placeholder row with the directory content
+  if (directory->inTree)
+  {
+    if (gtk_tree_model_iter_children (GTK_TREE_MODEL (priv->topicTreeStore), &child, &directory->iter))
+      while (gtk_tree_store_remove (priv->topicTreeStore, &child));
 
-  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), NULL);
-  g_return_val_if_fail (count != NULL, NULL);
+    markdown_browser_topic_tree_add_directories (browser, subdirs);
+    markdown_browser_topic_tree_add_topics (browser, first, priv->topics->len);
+  }
 
-  *count = priv->topics->len;
-  return (MarkdownBrowserTopic *)(priv->topics->data);
+  g_ptr_array_free (subdirs, TRUE);                     // -- free sub directory array
 }
 
-/**
- * markdown_browser_get_history:
- * @browser: Markdown browser
- * @count: Location to store length of returned history visit array
- *
- * Get array of topic history visits in a markdown browser widget.
- *
- * Returns: (transfer-none): Array of topic visit history information which is internal to @browser
- *   and is only valid for the widget lifetime and provided the topic data is not changed.
- */
-MarkdownBrowserVisit *
-markdown_browser_get_history (MarkdownBrowser *browser, guint *count)
+// Enumerate the directories of a path qualified topic name ("dir/sub/name"), returns TRUE if any were enumerated
+static gboolean
+markdown_browser_directory_enumerate_path (MarkdownBrowser *browser, const char *name)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserDirectory *directory;
+  gboolean enumerated = FALSE;
+  const char *slash;
+  char *prefix;
 
-  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), NULL);
-  g_return_val_if_fail (count != NULL, NULL);
+  for (slash = strchr (name, '/'); slash; slash = strchr (slash + 1, '/'))
+  {
+    prefix = g_strndup (name, slash - name + 1);        // ++ alloc prefix
+    directory = g_hash_table_lookup (priv->directories, prefix);
+    g_free (prefix);                                    // -- free prefix
 
-  *count = priv->history->len;
-  return (MarkdownBrowserVisit *)(priv->history->data);
+    if (!directory)
+      break;
+
+    if (!directory->enumerated)
+    {
+      markdown_browser_directory_enumerate (browser, directory);
+      enumerated = TRUE;
+    }
+  }
+
+  return enumerated;
 }
 
-/**
- * markdown_browser_add_topic:
- * @browser: Markdown browser
- * @name: Name identifier of the topic
- * @title: Title of the topic
- * @content: Markdown content of the topic
- *
- * Add a single topic to a browser widget.
- */
-void
-markdown_browser_add_topic (MarkdownBrowser *browser, const char *name, const char *title, const char *content)
+// Topic tree "test-expand-row" signal, enumerates a directory before its row is expanded
+static gboolean
+markdown_browser_topic_tree_test_expand_row (GtkTreeView *treeView, GtkTreeIter *iter, GtkTreePath *path,
+                                             MarkdownBrowser *browser)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  MarkdownBrowserTopic *topic;
+  MarkdownBrowserDirectory *directory;
+  char *prefix;
 
-  g_return_if_fail (IS_MARKDOWN_BROWSER (browser));
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->topicTreeStore), iter, TOPIC_COLUMN_DIRECTORY, &prefix, -1);  // ++ alloc prefix
 
-  g_array_set_size (priv->topics, priv->topics->len + 1);
-  topic = &g_array_index (priv->topics, MarkdownBrowserTopic, priv->topics->len - 1);
-  topic->name = g_strdup (name);
-  topic->title = g_strdup (title);
-  topic->content = g_strdup (content);
+  if (prefix && (directory = g_hash_table_lookup (priv->directories, prefix)))
+    markdown_browser_directory_enumerate (browser, directory);
 
-  // Do the topic update in an idle function for optimization purposes with multiple topic adds
-  if (!priv->idleId)
-    priv->idleId = g_idle_add (markdown_browser_topics_update, browser);
+  g_free (prefix);                                      // -- free prefix
+
+  return FALSE;         // Allow expansion
 }
 
-/**
- * markdown_browser_add_files:
- * @browser: Markdown browser
- * @path: Path to add markdown content files from
- * @fileMatch: File matching Perl compatible regular expression
- *   (NULL for default of "(.*)\\.(md|markdown)$", group capture is used as topic name)
- * @titleMatch: Perl compatible regular expression to extract title from file content
- *   (NULL for default of "^ {0,3}\# (.*)" for h1 header), group capture is the title text
- *
- * Add markdown files in a directory (not recursive).
- */
-gboolean
-markdown_browser_add_files (MarkdownBrowser *browser, const char *path, const char *fileMatch,
-                     const char *titleMatch, GError **err)
+static void
+markdown_browser_watch_free (MarkdownBrowserWatch *watch)
+{
+  g_signal_handlers_disconnect_by_data (watch->monitor, watch);
+  g_file_monitor_cancel (watch->monitor);
+  g_object_unref (watch->monitor);                      // -- unref monitor
+  g_free (watch->prefix);
+  g_regex_unref (watch->fileRegex);
+  g_regex_unref (watch->titleRegex);
+  g_slice_free (MarkdownBrowserWatch, watch);
+}
+
+// Reload a changed or created file of a watched directory, sets refresh if it is the displayed topic.  Returns FALSE
+// if the topic is being parsed and has to be reloaded later.
+static gboolean
+markdown_browser_watch_reload (MarkdownBrowser *browser, MarkdownBrowserWatch *watch, const char *path,
+                               gboolean *refresh)
 {
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  GRegex *fileRegex, *titleRegex;
-  GMatchInfo *fileMatchInfo, *titleMatchInfo;
-  char *fullpath, *name, *title, *content;
-  const char *filename;
-  GError *local_err = NULL;
-  GDir *dir;
+  MarkdownBrowserFileLoad load = { NULL };
+  MarkdownBrowserTopicInfo *info = NULL;
+  MarkdownBrowserTopic *topic = NULL;
+  GMatchInfo *fileMatchInfo;
+  GtkTreeIter *iter;
+  gpointer value;
+  char *basename, *name;
+  int index = MARKDOWN_BROWSER_TOPIC_NONE;
+
+  basename = g_path_get_basename (path);                // ++ alloc base name
+
+  if (g_regex_match (watch->fileRegex, basename, 0, &fileMatchInfo))   // ++ allocate file match info
+  {
+    name = g_match_info_fetch (fileMatchInfo, 1);                       // ++ alloc topic name in file match
+    load.name = g_strconcat (watch->prefix, name, NULL);                // ++ alloc path qualified topic name
+    g_free (name);                                                      // -- free topic name
+  }
 
-  g_return_val_if_fail (IS_MARKDOWN_BROWSER (browser), FALSE);
-  g_return_val_if_fail (path != NULL, FALSE);
-  g_return_val_if_fail (!err || !*err, FALSE);
+  g_match_info_free (fileMatchInfo);                    // -- free file match info
+  g_free (basename);                                    // -- free base name
 
-  if (!(dir = g_dir_open (path, 0, err)))       // ++ open GDir
-    return FALSE;
+  if (!load.name)               // Not a Markdown file
+    return TRUE;
 
-  if (!(fileRegex = g_regex_new (fileMatch ? fileMatch : DEFAULT_FILE_MATCH, 0, 0, err)))       // ++ new fileRegex
+  if (g_hash_table_lookup_extended (priv->topicNames, load.name, NULL, &value))
   {
-    g_dir_close (dir);          // -- close GDir
-    return FALSE;
+    index = GPOINTER_TO_INT (value);
+    topic = &g_array_index (priv->topics, MarkdownBrowserTopic, index);
+    info = &g_array_index (priv->topicInfo, MarkdownBrowserTopicInfo, index);
+
+    if (info->pinCount > 0)     // Content is in use by a parser thread
+    {
+      g_free (load.name);       // -- free name
+      return FALSE;
+    }
   }
 
-  if (!(titleRegex = g_regex_new (titleMatch ? titleMatch : DEFAULT_TITLE_MATCH,        // ++ new titleRegex
-                                  G_REGEX_MULTILINE, 0, err)))
+  // Read the file and its title the same way as markdown_browser_add_files()
+  load.fullpath = (char *)path;
+  load.lazy = topic ? info->path != NULL : watch->lazy;
+  markdown_browser_file_load_thread (&load, watch->titleRegex);
+
+  if (load.err)                 // Keep the current content if the file was removed again
   {
-    g_regex_unref (fileRegex);  // -- unref fileRegex
-    g_dir_close (dir);          // -- close GDir
-    return FALSE;
+    g_clear_error (&load.err);
+    g_free (load.name);         // -- free name
+    return TRUE;
   }
 
-  // Loop over files
-  while ((filename = g_dir_read_name (dir)))
+  // New file, topic is appended so topic indexes and history remain valid
+  if (!topic)
   {
-    if (g_regex_match (fileRegex, filename, 0, &fileMatchInfo)) // ++ allocate file
-    {
-      fullpath = g_build_filename (path, filename, NULL);       // ++ alloc full path
+    info = markdown_browser_add_topic_take (browser, load.name, load.title, load.content);    // !! takes over strings
 
-      if (g_file_get_contents (fullpath, &content, NULL, &local_err))   // ++ allocate content
-      {
-        name = g_match_info_fetch (fileMatchInfo, 1);           // ++ alloc topic name in file match
+    if (load.lazy)
+      info->path = g_strdup (path);                     // ++ alloc path (topic owns it)
+    else info->hash = load.hash;                        // !! topic takes over content hash
 
-        if (g_regex_match (titleRegex, content, 0, &titleMatchInfo))    // ++ allocate title match info
-          title = g_match_info_fetch (titleMatchInfo, 1);       // ++ allocate title
-        else title = NULL;
+    if (!priv->idleId)          // Otherwise the topic tree is rebuilt by the pending topics update
+      markdown_browser_topic_tree_add_topics (browser, priv->topics->len - 1, priv->topics->len);
 
-        g_match_info_free (titleMatchInfo);                     // -- free title match info
+    return TRUE;
+  }
 
-        markdown_browser_add_topic (browser, name, title, content);
-        g_free (name);          // -- free name
-        g_free (title);         // -- free title
-        g_free (content);       // -- free content
-      }
-      else
-      {
-        g_warning ("Failed to load markdown file '%s': %s", fullpath, local_err->message);
-        g_clear_error (&local_err);
-      }
+  g_free (load.name);           // -- free name
+  g_free (topic->title);
+  topic->title = load.title;    // !! takes over title
 
-      g_free (fullpath);        // -- free full path
-    }
+  if (info->bytes)
+    g_clear_pointer (&info->bytes, g_bytes_unref);     // Content pointed into bytes
+  else g_free (topic->content);
 
-    g_match_info_free (fileMatchInfo);  // -- free file match info
-  }
+  g_clear_pointer (&info->bundle, markdown_browser_bundle_unref);      // Parsed from the file from now on
+  g_clear_pointer (&info->imagesPath, g_free);                         // Images of files are in images-path
 
-  g_regex_unref (titleRegex);   // -- unref titleRegex
-  g_regex_unref (fileRegex);    // -- unref fileRegex
-  g_dir_close (dir);            // -- close GDir
+  // Content is NULL for a lazily loaded topic and is read again when shown.  Rendered buffers and render jobs hold
+  // their own document references.
+  topic->content = load.content;                        // !! takes over content
+  g_free (info->hash);
+  info->hash = load.hash;                               // !! takes over content hash
+  g_clear_pointer (&info->document, markdown_browser_document_unref);
+  markdown_browser_topic_charge (browser, topic);
 
-  // Sort topics alphabetically
-  g_array_sort (priv->topics, markdown_browser_topic_sort);
+  if (index < priv->topicIters->len && (iter = &g_array_index (priv->topicIters, GtkTreeIter, index))->user_data)
+    gtk_tree_store_set (priv->topicTreeStore, iter, TOPIC_COLUMN_TITLE, topic->title, -1);
 
-  // Reset selected topic and history which is no longer valid
-  g_array_set_size (priv->history, 0);
-  priv->historyPos = 0;
-  priv->topicIndex = -1;
+  if (priv->renderJob && priv->renderJob->topic == index)
+    markdown_browser_render_cancel (browser);
 
-  // Do the topic update in an idle function for optimization purposes with multiple topic adds
-  if (!priv->idleId)
-    priv->idleId = g_idle_add (markdown_browser_topics_update, browser);
+  markdown_browser_render_cache_remove_topic (browser, index);
+
+  if (index == priv->topicIndex)
+    *refresh = TRUE;
 
   return TRUE;
 }
 
-static int
-markdown_browser_topic_sort (gconstpointer a, gconstpointer b)
+// Timeout callback once watched files have stopped changing, reloads them
+static gboolean
+markdown_browser_watch_timeout (gpointer data)
+{
+  MarkdownBrowser *browser = MARKDOWN_BROWSER (data);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserWatch *watch;
+  GHashTableIter hashIter;
+  gboolean refresh = FALSE;
+  const char *path;
+
+  g_hash_table_iter_init (&hashIter, priv->watchChanges);
+
+  while (g_hash_table_iter_next (&hashIter, (gpointer *)&path, (gpointer *)&watch))
+    if (markdown_browser_watch_reload (browser, watch, path, &refresh))
+      g_hash_table_iter_remove (&hashIter);
+
+  // Render the displayed topic again, keeping the section and scroll position
+  if (refresh)
+  {
+    markdown_browser_refresh_topic (browser);
+    markdown_browser_update_section_buttons (browser);
+  }
+
+  // Files of topics which are being parsed are retried on the next timeout
+  if (g_hash_table_size (priv->watchChanges) > 0)
+    return TRUE;
+
+  priv->watchTimeoutId = 0;
+  return FALSE;
+}
+
+// Directory monitor "changed" signal, queues changed and new files and restarts the debounce timeout
+static void
+markdown_browser_watch_changed (GFileMonitor *monitor, GFile *file, GFile *otherFile, GFileMonitorEvent event,
+                                MarkdownBrowserWatch *watch)
+{
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (watch->browser);
+  char *path;
+
+  // Deleted files are ignored, removing topics would invalidate topic indexes (atomic saves create the file again)
+  if (event != G_FILE_MONITOR_EVENT_CHANGED && event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT
+      && event != G_FILE_MONITOR_EVENT_CREATED)
+    return;
+
+  if (!(path = g_file_get_path (file)))                 // ++ alloc path
+    return;
+
+  g_hash_table_replace (priv->watchChanges, path, watch);      // !! takes over path
+
+  // Editors often write a file in several steps, reload once changes have settled
+  if (priv->watchTimeoutId)
+    g_source_remove (priv->watchTimeoutId);
+
+  priv->watchTimeoutId = g_timeout_add (WATCH_DEBOUNCE_TIME, markdown_browser_watch_timeout, watch->browser);
+}
+
+// Watch a directory loaded by markdown_browser_directory_load() for changed and new files
+static void
+markdown_browser_watch_directory (MarkdownBrowser *browser, const char *path, const char *prefix,
+                                  GRegex *fileRegex, GRegex *titleRegex, gboolean lazy)
 {
-  const MarkdownBrowserTopic *atopic = a, *btopic = b;
-  return strcmp (atopic->name, btopic->name);
+  MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
+  MarkdownBrowserWatch *watch;
+  GFileMonitor *monitor;
+  GError *err = NULL;
+  GFile *file;
+
+  file = g_file_new_for_path (path);                    // ++ new file
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, &err);  // ++ new monitor
+  g_object_unref (file);                                // -- unref file
+
+  if (!monitor)
+  {
+    g_warning ("Failed to watch Markdown files in path '%s': %s", path, err->message);
+    g_clear_error (&err);
+    return;
+  }
+
+  watch = g_slice_new (MarkdownBrowserWatch);           // ++ alloc watch
+  watch->browser = browser;
+  watch->monitor = monitor;                             // !! takes over monitor
+  watch->prefix = g_strdup (prefix);                    // ++ alloc prefix
+  watch->fileRegex = g_regex_ref (fileRegex);           // ++ ref fileRegex
+  watch->titleRegex = g_regex_ref (titleRegex);         // ++ ref titleRegex
+  watch->lazy = lazy;
+  g_signal_connect (monitor, "changed", G_CALLBACK (markdown_browser_watch_changed), watch);
+  g_ptr_array_add (priv->watches, watch);               // !! takes over watch
 }
 
 // Idle callback to update topics tree view and select home topic (if no topic selected)
@@ -1462,26 +4174,33 @@ markdown_browser_topics_update (gpointer data)
 {
   MarkdownBrowser *browser = MARKDOWN_BROWSER (data);
   MarkdownBrowserPrivate *priv = markdown_browser_get_instance_private (browser);
-  MarkdownBrowserTopic *topic;
-  GtkTreeIter iter;
-  int i;
+  MarkdownBrowserDirectory *directory;
+  GHashTableIter hashIter;
+  GPtrArray *directories;
 
-  gtk_list_store_clear (priv->topicListStore);
+  gtk_tree_store_clear (priv->topicTreeStore);
+  g_array_set_size (priv->topicIters, 0);               // Clears iterators of topics not in the tree
 
-  // Populate topic list store
-  for (i = priv->topics->len - 1; i >= 0; i--)
-  {
-    topic = &g_array_index (priv->topics, MarkdownBrowserTopic, i);
-    gtk_list_store_insert (priv->topicListStore, &iter, 0);
+  // Populate topic tree store, directories first
+  directories = g_ptr_array_new ();                     // ++ new directory array
+  g_hash_table_iter_init (&hashIter, priv->directories);
 
-    gtk_list_store_set (priv->topicListStore, &iter,
-                        TOPIC_COLUMN_TITLE, topic->title,
-                        TOPIC_COLUMN_INDEX, i,
-                        -1);
+  while (g_hash_table_iter_next (&hashIter, NULL, (gpointer *)&directory))
+  {
+    directory->inTree = FALSE;
+    g_ptr_array_add (directories, directory);
   }
 
-  if (priv->topicIndex == MARKDOWN_BROWSER_TOPIC_NONE && priv->homeTopic)
-    markdown_browser_navigate_to_topic_by_name (browser, priv->homeTopic);
+  markdown_browser_topic_tree_add_directories (browser, directories);
+  g_ptr_array_free (directories, TRUE);                 // -- free directory array
+
+  markdown_browser_topic_tree_add_topics (browser, 0, priv->topics->len);
+
+  gtk_tree_view_set_show_expanders (gtk_tree_selection_get_tree_view (priv->treeSelection),
+                                    g_hash_table_size (priv->directories) > 0);
+
+  if (priv->topicIndex == MARKDOWN_BROWSER_TOPIC_NONE)
+    markdown_browser_navigate_home (browser);
 
   // Clear idle callback ID and return FALSE to remove idle
   priv->idleId = 0;
@@ -52,7 +52,8 @@ struct _MarkdownBrowserClass
  * MarkdownBrowserTopic:
  * @name: Name identifier
  * @title: Topic title
- * @content: Markdown topic content
+ * @content: Markdown topic content, NULL if lazily loaded and not loaded (see markdown_browser_get_topic_content())
+ *   or added from a help bundle, not necessarily NUL terminated if added with markdown_browser_add_topic_bytes()
  *
  * Markdown browser topic information.
  */
@@ -67,6 +68,7 @@ typedef struct
  * MarkdownBrowserVisit:
  * @topic: Topic index for this visit
  * @line: Line number of text view
+ * @section: Topic section (if paginate-level property is set)
  *
  * Defines data for a visit in the markdown link history.
  */
@@ -74,6 +76,7 @@ typedef struct
 {
   int topic;
   int line;
+  int section;
 } MarkdownBrowserVisit;
 
 /**
@@ -86,12 +89,28 @@ typedef struct
 GType markdown_browser_get_type (void);
 GtkWidget *markdown_browser_new (const char *uiFile);
 void markdown_browser_navigate (MarkdownBrowser *help, int historyOfs, int topicIndex);
+void markdown_browser_navigate_async (MarkdownBrowser *browser, int historyOfs, int topicIndex,
+                                      GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean markdown_browser_navigate_finish (MarkdownBrowser *browser, GAsyncResult *result, GError **err);
 gboolean markdown_browser_navigate_to_topic_by_name (MarkdownBrowser *help, const char *name);
+void markdown_browser_navigate_to_section (MarkdownBrowser *browser, int topicIndex, int section);
+gboolean markdown_browser_navigate_to_link (MarkdownBrowser *browser, const char *link);
 int markdown_browser_get_topic_by_name (MarkdownBrowser *help, const char *name);
 MarkdownBrowserTopic *markdown_browser_get_topics (MarkdownBrowser *browser, guint *count);
+const char *markdown_browser_get_topic_content (MarkdownBrowser *browser, int topicIndex);
 MarkdownBrowserVisit *markdown_browser_get_history (MarkdownBrowser *browser, guint *count);
 void markdown_browser_add_topic (MarkdownBrowser *help, const char *name, const char *title, const char *content);
+void markdown_browser_add_topic_bytes (MarkdownBrowser *browser, const char *name, const char *title, GBytes *content);
+void markdown_browser_add_topic_static (MarkdownBrowser *browser, const char *name, const char *title,
+                                        const char *content);
 gboolean markdown_browser_add_files (MarkdownBrowser *help, const char *path, const char *fileMatch,
                               const char *titleMatch, GError **err);
+gboolean markdown_browser_add_resources (MarkdownBrowser *browser, const char *path, const char *fileMatch,
+                                         const char *titleMatch, GError **err);
+gboolean markdown_browser_add_bundle (MarkdownBrowser *browser, const char *filename, GError **err);
+#ifdef DEBUG
+int markdown_browser_check_topic (MarkdownBrowser *browser, int topicIndex);
+void markdown_browser_set_coalesce_runs (MarkdownBrowser *browser, gboolean coalesce);
+#endif
 #endif
 
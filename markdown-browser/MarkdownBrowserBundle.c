@@ -0,0 +1,313 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserBundle.c - Precompiled help bundle file format.
+ *
+ * A help bundle is a single file compiled by markdown-browser-compile, which contains a
+ * MarkdownBrowserBundleHeader, the topic table sorted by name, the image table sorted by
+ * name, the string pool, the span array and text pool of each parsed topic and the packed
+ * image file data.  Opening a bundle maps the file and only checks its header and tables,
+ * documents use the mapped spans and text directly.
+ */
+#include <string.h>
+
+#include "MarkdownBrowserBundle.h"
+
+struct _MarkdownBrowserBundle
+{
+  int refCount;
+  GBytes *data;                                 // Mapped bundle file (ref held)
+  const char *base;                             // Start of mapped file
+  const MarkdownBrowserBundleHeader *header;
+  const MarkdownBrowserBundleTopic *topics;     // Topic table
+  const MarkdownBrowserBundleImage *images;     // Image table
+  const char *strings;                          // String pool
+};
+
+// TRUE if a range of len bytes at ofs is within a file of a given size
+#define markdown_browser_bundle_range_valid(ofs, len, size)     ((guint64)(ofs) + (guint64)(len) <= (guint64)(size))
+
+// Check the header and tables of a mapped bundle, returns a description of the problem or NULL if valid
+static const char *
+markdown_browser_bundle_check (const char *base, gsize size)
+{
+  const MarkdownBrowserBundleHeader *header = (const MarkdownBrowserBundleHeader *)base;
+  const MarkdownBrowserBundleTopic *topic;
+  const MarkdownBrowserBundleImage *image;
+  guint i;
+
+  if (size < sizeof (MarkdownBrowserBundleHeader)
+      || memcmp (header->magic, MARKDOWN_BROWSER_BUNDLE_MAGIC, sizeof (header->magic)) != 0)
+    return "Not a help bundle";
+
+  if (header->byteOrder != MARKDOWN_BROWSER_BUNDLE_BYTE_ORDER || header->spanSize != sizeof (MarkdownBrowserSpan))
+    return "Compiled for a different architecture";
+
+  if (header->version != MARKDOWN_BROWSER_BUNDLE_VERSION)
+    return "Unsupported version";
+
+  if (!markdown_browser_bundle_range_valid (sizeof (MarkdownBrowserBundleHeader),
+                                            (guint64)header->topicCount * sizeof (MarkdownBrowserBundleTopic)
+                                            + (guint64)header->imageCount * sizeof (MarkdownBrowserBundleImage), size))
+    return "Truncated tables";
+
+  // Last byte of the string pool terminates all strings in it
+  if (header->stringsLen == 0 || !markdown_browser_bundle_range_valid (header->stringsOfs, header->stringsLen, size)
+      || base[header->stringsOfs + header->stringsLen - 1] != '\0')
+    return "Invalid string pool";
+
+  topic = (const MarkdownBrowserBundleTopic *)(base + sizeof (MarkdownBrowserBundleHeader));
+
+  for (i = 0; i < header->topicCount; i++, topic++)
+  {
+    if (topic->name >= header->stringsLen
+        || (topic->title != MARKDOWN_BROWSER_BUNDLE_NONE && topic->title >= header->stringsLen))
+      return "Invalid topic name";
+
+    if (topic->spansOfs % MARKDOWN_BROWSER_BUNDLE_ALIGN != 0
+        || !markdown_browser_bundle_range_valid (topic->spansOfs,
+                                                 (guint64)topic->spanCount * sizeof (MarkdownBrowserSpan), size)
+        || !markdown_browser_bundle_range_valid (topic->textOfs, topic->textLen, size))
+      return "Truncated topic";
+  }
+
+  image = (const MarkdownBrowserBundleImage *)topic;
+
+  for (i = 0; i < header->imageCount; i++, image++)
+  {
+    if (image->name >= header->stringsLen)
+      return "Invalid image name";
+
+    if (!markdown_browser_bundle_range_valid (image->dataOfs, image->dataLen, size))
+      return "Truncated image";
+  }
+
+  return NULL;
+}
+
+/**
+ * markdown_browser_bundle_open:
+ * @filename: Help bundle file name
+ * @err: Location to store error or NULL
+ *
+ * Open a help bundle compiled by markdown-browser-compile.  The file is memory mapped and only its
+ * header and tables are checked, nothing is parsed.  The spans of a topic are checked when its
+ * document is created with markdown_browser_bundle_get_document().
+ *
+ * Returns: (transfer full): New bundle with a reference count of 1 or NULL on error (@err is set)
+ */
+MarkdownBrowserBundle *
+markdown_browser_bundle_open (const char *filename, GError **err)
+{
+  MarkdownBrowserBundle *bundle;
+  GMappedFile *mappedFile;
+  const char *message;
+  gsize size;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (!err || !*err, NULL);
+
+  if (!(mappedFile = g_mapped_file_new (filename, FALSE, err)))         // ++ map file
+    return NULL;
+
+  bundle = g_new0 (MarkdownBrowserBundle, 1);                           // ++ alloc bundle
+  bundle->refCount = 1;
+  bundle->data = g_mapped_file_get_bytes (mappedFile);                  // ++ new bytes (holds the mapping)
+  g_mapped_file_unref (mappedFile);                                     // -- unref mapped file
+
+  bundle->base = g_bytes_get_data (bundle->data, &size);
+
+  if ((message = markdown_browser_bundle_check (bundle->base, size)))
+  {
+    g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Failed to open help bundle '%s': %s", filename, message);
+    markdown_browser_bundle_unref (bundle);                             // -- unref bundle
+    return NULL;
+  }
+
+  bundle->header = (const MarkdownBrowserBundleHeader *)bundle->base;
+  bundle->topics = (const MarkdownBrowserBundleTopic *)(bundle->base + sizeof (MarkdownBrowserBundleHeader));
+  bundle->images = (const MarkdownBrowserBundleImage *)(bundle->topics + bundle->header->topicCount);
+  bundle->strings = bundle->base + bundle->header->stringsOfs;
+
+  return bundle;
+}
+
+/**
+ * markdown_browser_bundle_ref:
+ * @bundle: Help bundle
+ *
+ * Add a reference to a help bundle (thread safe).
+ *
+ * Returns: @bundle
+ */
+MarkdownBrowserBundle *
+markdown_browser_bundle_ref (MarkdownBrowserBundle *bundle)
+{
+  g_return_val_if_fail (bundle != NULL, NULL);
+
+  g_atomic_int_inc (&bundle->refCount);
+  return bundle;
+}
+
+/**
+ * markdown_browser_bundle_unref:
+ * @bundle: Help bundle
+ *
+ * Remove a reference from a help bundle (thread safe), unmapping it when there are no more references.
+ * Documents created from the bundle keep the mapping until they are freed.
+ */
+void
+markdown_browser_bundle_unref (MarkdownBrowserBundle *bundle)
+{
+  g_return_if_fail (bundle != NULL);
+
+  if (!g_atomic_int_dec_and_test (&bundle->refCount))
+    return;
+
+  g_bytes_unref (bundle->data);         // -- unref mapped file
+  g_free (bundle);
+}
+
+/**
+ * markdown_browser_bundle_get_topic_count:
+ * @bundle: Help bundle
+ *
+ * Returns: Number of topics in the bundle
+ */
+guint
+markdown_browser_bundle_get_topic_count (MarkdownBrowserBundle *bundle)
+{
+  g_return_val_if_fail (bundle != NULL, 0);
+
+  return bundle->header->topicCount;
+}
+
+/**
+ * markdown_browser_bundle_get_topic_name:
+ * @bundle: Help bundle
+ * @index: Topic index (topics are sorted by name)
+ *
+ * Returns: (transfer none): Topic name, in the mapped file
+ */
+const char *
+markdown_browser_bundle_get_topic_name (MarkdownBrowserBundle *bundle, guint index)
+{
+  g_return_val_if_fail (bundle != NULL, NULL);
+  g_return_val_if_fail (index < bundle->header->topicCount, NULL);
+
+  return bundle->strings + bundle->topics[index].name;
+}
+
+/**
+ * markdown_browser_bundle_get_topic_title:
+ * @bundle: Help bundle
+ * @index: Topic index (topics are sorted by name)
+ *
+ * Returns: (transfer none): Topic title, in the mapped file, or NULL if the topic has none
+ */
+const char *
+markdown_browser_bundle_get_topic_title (MarkdownBrowserBundle *bundle, guint index)
+{
+  g_return_val_if_fail (bundle != NULL, NULL);
+  g_return_val_if_fail (index < bundle->header->topicCount, NULL);
+
+  if (bundle->topics[index].title == MARKDOWN_BROWSER_BUNDLE_NONE)
+    return NULL;
+
+  return bundle->strings + bundle->topics[index].title;
+}
+
+/**
+ * markdown_browser_bundle_get_document:
+ * @bundle: Help bundle
+ * @index: Topic index (topics are sorted by name)
+ *
+ * Create the parsed document of a topic, which uses the spans and text in the mapped file
+ * without copying them.  Safe to call from any thread.
+ *
+ * Returns: (transfer full): New document or NULL if the spans of the topic are invalid
+ */
+MarkdownBrowserDocument *
+markdown_browser_bundle_get_document (MarkdownBrowserBundle *bundle, guint index)
+{
+  const MarkdownBrowserBundleTopic *topic;
+
+  g_return_val_if_fail (bundle != NULL, NULL);
+  g_return_val_if_fail (index < bundle->header->topicCount, NULL);
+
+  topic = &bundle->topics[index];
+
+  return markdown_browser_document_new_from_data (bundle->data,
+                                                  (const MarkdownBrowserSpan *)(bundle->base + topic->spansOfs),
+                                                  topic->spanCount, bundle->base + topic->textOfs, topic->textLen,
+                                                  (topic->flags & MARKDOWN_BROWSER_BUNDLE_TIMED_OUT) != 0);
+}
+
+/**
+ * markdown_browser_bundle_get_image_count:
+ * @bundle: Help bundle
+ *
+ * Returns: Number of images in the bundle
+ */
+guint
+markdown_browser_bundle_get_image_count (MarkdownBrowserBundle *bundle)
+{
+  g_return_val_if_fail (bundle != NULL, 0);
+
+  return bundle->header->imageCount;
+}
+
+/**
+ * markdown_browser_bundle_get_image_name:
+ * @bundle: Help bundle
+ * @index: Image index (images are sorted by name)
+ *
+ * Returns: (transfer none): Image file name without directory, in the mapped file
+ */
+const char *
+markdown_browser_bundle_get_image_name (MarkdownBrowserBundle *bundle, guint index)
+{
+  g_return_val_if_fail (bundle != NULL, NULL);
+  g_return_val_if_fail (index < bundle->header->imageCount, NULL);
+
+  return bundle->strings + bundle->images[index].name;
+}
+
+/**
+ * markdown_browser_bundle_get_image_data:
+ * @bundle: Help bundle
+ * @index: Image index (images are sorted by name)
+ *
+ * Get the file data of an image, which references the mapped file without copying it.
+ *
+ * Returns: (transfer full): Image file data
+ */
+GBytes *
+markdown_browser_bundle_get_image_data (MarkdownBrowserBundle *bundle, guint index)
+{
+  g_return_val_if_fail (bundle != NULL, NULL);
+  g_return_val_if_fail (index < bundle->header->imageCount, NULL);
+
+  return g_bytes_new_from_bytes (bundle->data, bundle->images[index].dataOfs, bundle->images[index].dataLen);
+}
@@ -0,0 +1,40 @@
+# MarkdownBrowserBundle.cmake - Compile a directory of Markdown topics and images into a help bundle
+#
+# markdown_browser_compile_bundle (<target> <directory> <bundle file>)
+#
+# Adds a target, built by default, which compiles the Markdown files (.md and .markdown) of a directory
+# and the images anywhere below it into a help bundle with markdown-browser-compile.  The bundle is
+# loaded with markdown_browser_add_bundle(), which maps it without parsing anything.  The bundle is
+# recompiled when the files change.  The markdown-browser-compile target is used if it is part of
+# the build, the installed program otherwise.
+#
+# Example:
+#   include (MarkdownBrowserBundle.cmake)
+#   markdown_browser_compile_bundle (help-bundle ${CMAKE_SOURCE_DIR}/help ${CMAKE_BINARY_DIR}/help.mdb)
+
+find_program (MARKDOWN_BROWSER_COMPILE markdown-browser-compile)
+
+function (markdown_browser_compile_bundle TARGET_NAME DIRECTORY BUNDLE)
+  get_filename_component (NAME ${DIRECTORY} NAME)
+
+  if (TARGET markdown-browser-compile)
+    set (COMPILER $<TARGET_FILE:markdown-browser-compile>)
+    set (COMPILER_TARGET markdown-browser-compile)
+  else (TARGET markdown-browser-compile)
+    set (COMPILER ${MARKDOWN_BROWSER_COMPILE})
+    set (COMPILER_TARGET "")
+  endif (TARGET markdown-browser-compile)
+
+  file (GLOB TOPIC_FILES ${DIRECTORY}/*.md ${DIRECTORY}/*.markdown)
+  file (GLOB_RECURSE IMAGE_FILES ${DIRECTORY}/*.png ${DIRECTORY}/*.jpg ${DIRECTORY}/*.jpeg
+        ${DIRECTORY}/*.gif ${DIRECTORY}/*.svg)
+
+  add_custom_command (
+    OUTPUT ${BUNDLE}
+    COMMAND ${COMPILER} ${DIRECTORY} ${BUNDLE}
+    DEPENDS ${TOPIC_FILES} ${IMAGE_FILES} ${COMPILER_TARGET}
+    COMMENT "Compiling ${NAME} help bundle"
+  )
+
+  add_custom_target (${TARGET_NAME} ALL DEPENDS ${BUNDLE})
+endfunction (markdown_browser_compile_bundle)
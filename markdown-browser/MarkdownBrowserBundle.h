@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserBundle.h - Precompiled help bundle file format.
+ */
+#ifndef MARKDOWN_BROWSER_BUNDLE_H
+#define MARKDOWN_BROWSER_BUNDLE_H
+
+#include <glib.h>
+
+#include "MarkdownBrowserDocument.h"
+
+#define MARKDOWN_BROWSER_BUNDLE_MAGIC           "MDBUNDL1"      // Bundle file magic
+#define MARKDOWN_BROWSER_BUNDLE_VERSION         1               // Format version, incremented when the format or MarkdownBrowserSpan changes
+#define MARKDOWN_BROWSER_BUNDLE_BYTE_ORDER      0x01020304      // Byte order mark (bundles use the byte order of the compiling host)
+#define MARKDOWN_BROWSER_BUNDLE_ALIGN           8               // Alignment of span arrays and image data in the file
+#define MARKDOWN_BROWSER_BUNDLE_NONE            G_MAXUINT32     // String offset value when there is no string
+
+// Topic flags
+#define MARKDOWN_BROWSER_BUNDLE_TIMED_OUT       (1 << 0)        // Parse time limit was exceeded (see MarkdownBrowserDocument timedOut)
+
+/**
+ * MarkdownBrowserBundleHeader:
+ * @magic: #MARKDOWN_BROWSER_BUNDLE_MAGIC (not NUL terminated)
+ * @version: #MARKDOWN_BROWSER_BUNDLE_VERSION
+ * @byteOrder: #MARKDOWN_BROWSER_BUNDLE_BYTE_ORDER
+ * @spanSize: Size of #MarkdownBrowserSpan
+ * @topicCount: Number of entries in the topic table, which follows the header
+ * @imageCount: Number of entries in the image table, which follows the topic table
+ * @stringsOfs: File offset of the string pool (NUL terminated topic names, titles and image names)
+ * @stringsLen: Size of the string pool in bytes
+ *
+ * Header at the start of a help bundle file.  All offsets and sizes are 32 bit in the byte
+ * order of the compiling host, so span arrays can be used directly from the memory mapped file.
+ */
+typedef struct
+{
+  char magic[8];
+  guint32 version;
+  guint32 byteOrder;
+  guint32 spanSize;
+  guint32 topicCount;
+  guint32 imageCount;
+  guint32 stringsOfs;
+  guint32 stringsLen;
+  guint32 reserved;
+} MarkdownBrowserBundleHeader;
+
+/**
+ * MarkdownBrowserBundleTopic:
+ * @name: Offset of the topic name in the string pool
+ * @title: Offset of the topic title in the string pool or #MARKDOWN_BROWSER_BUNDLE_NONE
+ * @spansOfs: File offset of the parsed document span array (aligned to #MARKDOWN_BROWSER_BUNDLE_ALIGN)
+ * @spanCount: Number of spans
+ * @textOfs: File offset of the parsed document text pool
+ * @textLen: Size of the text pool in bytes
+ * @flags: Topic flags (MARKDOWN_BROWSER_BUNDLE_TIMED_OUT)
+ *
+ * Topic table entry of a help bundle.  The table is sorted by topic name.
+ */
+typedef struct
+{
+  guint32 name;
+  guint32 title;
+  guint32 spansOfs;
+  guint32 spanCount;
+  guint32 textOfs;
+  guint32 textLen;
+  guint32 flags;
+  guint32 reserved;
+} MarkdownBrowserBundleTopic;
+
+/**
+ * MarkdownBrowserBundleImage:
+ * @name: Offset of the image file name (without directory) in the string pool
+ * @dataOfs: File offset of the image file data (aligned to #MARKDOWN_BROWSER_BUNDLE_ALIGN)
+ * @dataLen: Size of the image file data in bytes
+ *
+ * Image table entry of a help bundle.  The table is sorted by image name.
+ */
+typedef struct
+{
+  guint32 name;
+  guint32 dataOfs;
+  guint32 dataLen;
+  guint32 reserved;
+} MarkdownBrowserBundleImage;
+
+typedef struct _MarkdownBrowserBundle MarkdownBrowserBundle;
+
+MarkdownBrowserBundle *markdown_browser_bundle_open (const char *filename, GError **err);
+MarkdownBrowserBundle *markdown_browser_bundle_ref (MarkdownBrowserBundle *bundle);
+void markdown_browser_bundle_unref (MarkdownBrowserBundle *bundle);
+guint markdown_browser_bundle_get_topic_count (MarkdownBrowserBundle *bundle);
+const char *markdown_browser_bundle_get_topic_name (MarkdownBrowserBundle *bundle, guint index);
+const char *markdown_browser_bundle_get_topic_title (MarkdownBrowserBundle *bundle, guint index);
+MarkdownBrowserDocument *markdown_browser_bundle_get_document (MarkdownBrowserBundle *bundle, guint index);
+guint markdown_browser_bundle_get_image_count (MarkdownBrowserBundle *bundle);
+const char *markdown_browser_bundle_get_image_name (MarkdownBrowserBundle *bundle, guint index);
+GBytes *markdown_browser_bundle_get_image_data (MarkdownBrowserBundle *bundle, guint index);
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserCompile.c - main() for markdown-browser-compile, which compiles a directory of
+ * Markdown files and images into a help bundle for markdown_browser_add_bundle()
+ */
+#include <string.h>
+#include <glib.h>
+
+#include "MarkdownBrowserBundle.h"
+#include "MarkdownBrowserDocument.h"
+
+#define CMDLINE_SUMMARY \
+  "markdown-browser-compile Compile Markdown files and images into a help bundle\n" \
+  "Copyright (C) 2021 Kymorphia, PBC\n" \
+  "MIT license"
+
+#define DEFAULT_FILE_MATCH      "(.*)\\.(md|markdown)$" // Default Markdown file match regex (first group capture is used as topic ID name)
+#define DEFAULT_TITLE_MATCH     "^ {0,3}\\# (.*)"       // Default regular expression to extract title from content
+#define IMAGE_MATCH             "\\.(png|jpe?g|gif|svg)$"       // Image file match regex (case insensitive)
+
+static char *file_match = NULL;
+static char *title_match = NULL;
+
+static GOptionEntry command_line_options[] =
+{
+  { "file-match", 'f', 0, G_OPTION_ARG_STRING, &file_match,
+    "Regex for Markdown file match, capture group is used as topic ID (defaults to '(.*)\\.(md|markdown)$')", NULL },
+  { "title-match", 't', 0, G_OPTION_ARG_STRING, &title_match,
+    "Regex to extract title from Markdown files, capture group is the title (defaults to '^ {0,3}\\# (.*)')", NULL },
+  { NULL }
+};
+
+// Topic to compile into a bundle
+typedef struct
+{
+  char *name;                           // Topic name
+  char *title;                          // Topic title or NULL
+  MarkdownBrowserDocument *doc;         // Parsed content (ref held)
+} BundleTopic;
+
+// Image to pack into a bundle
+typedef struct
+{
+  char *name;                           // Image file name without directory
+  char *path;                           // Image file path
+} BundleImage;
+
+static void
+bundle_topic_free (BundleTopic *topic)
+{
+  g_free (topic->name);
+  g_free (topic->title);
+  markdown_browser_document_unref (topic->doc);         // -- unref document
+  g_slice_free (BundleTopic, topic);
+}
+
+static void
+bundle_image_free (BundleImage *image)
+{
+  g_free (image->name);
+  g_free (image->path);
+  g_slice_free (BundleImage, image);
+}
+
+static int
+bundle_topic_sort (gconstpointer a, gconstpointer b)
+{
+  return strcmp ((*(BundleTopic * const *)a)->name, (*(BundleTopic * const *)b)->name);
+}
+
+static int
+bundle_image_sort (gconstpointer a, gconstpointer b)
+{
+  return strcmp ((*(BundleImage * const *)a)->name, (*(BundleImage * const *)b)->name);
+}
+
+// Parse the Markdown files of a directory into topics
+static gboolean
+load_topics (const char *path, GRegex *fileRegex, GRegex *titleRegex, GPtrArray *topics, GError **err)
+{
+  GMatchInfo *fileMatchInfo, *titleMatchInfo;
+  BundleTopic *topic;
+  const char *filename;
+  char *fullpath, *content;
+  gsize len;
+  GDir *dir;
+
+  if (!(dir = g_dir_open (path, 0, err)))       // ++ open GDir
+    return FALSE;
+
+  while ((filename = g_dir_read_name (dir)))
+  {
+    if (g_regex_match (fileRegex, filename, 0, &fileMatchInfo))         // ++ allocate file match info
+    {
+      fullpath = g_build_filename (path, filename, NULL);               // ++ alloc full path
+
+      if (!g_file_get_contents (fullpath, &content, &len, err))         // ++ alloc content
+      {
+        g_free (fullpath);                      // -- free full path
+        g_match_info_free (fileMatchInfo);      // -- free file match info
+        g_dir_close (dir);                      // -- close GDir
+        return FALSE;
+      }
+
+      topic = g_slice_new0 (BundleTopic);                               // ++ alloc topic
+      topic->name = g_match_info_fetch (fileMatchInfo, 1);              // ++ alloc topic name
+
+      if (g_regex_match (titleRegex, content, 0, &titleMatchInfo))     // ++ allocate title match info
+        topic->title = g_match_info_fetch (titleMatchInfo, 1);          // ++ alloc title
+
+      g_match_info_free (titleMatchInfo);                               // -- free title match info
+
+      // No parse time limit at build time, the whole topic is formatted
+      topic->doc = markdown_browser_document_new (content, len, 0);    // ++ new document
+      g_ptr_array_add (topics, topic);                                  // !! takes over topic
+
+      g_free (content);                         // -- free content
+      g_free (fullpath);                        // -- free full path
+    }
+
+    g_match_info_free (fileMatchInfo);          // -- free file match info
+  }
+
+  g_dir_close (dir);                            // -- close GDir
+
+  return TRUE;
+}
+
+// Find the images anywhere below a directory, the browser strips the directory of image names so the first image
+// found with a given file name is used
+static void
+find_images (const char *path, GRegex *imageRegex, GHashTable *images)
+{
+  BundleImage *image;
+  const char *filename;
+  char *fullpath;
+  GDir *dir;
+
+  if (!(dir = g_dir_open (path, 0, NULL)))      // ++ open GDir
+    return;
+
+  while ((filename = g_dir_read_name (dir)))
+  {
+    fullpath = g_build_filename (path, filename, NULL);                 // ++ alloc full path
+
+    if (g_file_test (fullpath, G_FILE_TEST_IS_DIR))
+      find_images (fullpath, imageRegex, images);
+    else if (g_regex_match (imageRegex, filename, 0, NULL) && !g_hash_table_contains (images, filename))
+    {
+      image = g_slice_new (BundleImage);                                // ++ alloc image
+      image->name = g_strdup (filename);
+      image->path = fullpath;                                           // !! takes over full path
+      g_hash_table_insert (images, image->name, image);                // !! takes over image
+      continue;
+    }
+
+    g_free (fullpath);                          // -- free full path
+  }
+
+  g_dir_close (dir);                            // -- close GDir
+}
+
+// Append zero bytes until the bundle data is aligned for a span array or image
+static void
+pad_to_align (GByteArray *out)
+{
+  static const guint8 zeros[MARKDOWN_BROWSER_BUNDLE_ALIGN] = { 0 };
+
+  if (out->len % MARKDOWN_BROWSER_BUNDLE_ALIGN)
+    g_byte_array_append (out, zeros, MARKDOWN_BROWSER_BUNDLE_ALIGN - out->len % MARKDOWN_BROWSER_BUNDLE_ALIGN);
+}
+
+// Append a NUL terminated string to the string pool, returns its offset
+static guint32
+add_string (GString *strings, const char *s)
+{
+  guint32 ofs = strings->len;
+
+  g_string_append_len (strings, s, strlen (s) + 1);
+  return ofs;
+}
+
+// Write topics and images sorted by name to a help bundle file (see MarkdownBrowserBundle.h for the layout)
+static gboolean
+write_bundle (const char *filename, GPtrArray *topics, GPtrArray *images, GError **err)
+{
+  MarkdownBrowserBundleHeader header = { { 0 } };
+  MarkdownBrowserBundleTopic *topicTable;
+  MarkdownBrowserBundleImage *imageTable;
+  BundleTopic *topic;
+  BundleImage *image;
+  GString *strings;
+  GByteArray *out;
+  char *content;
+  gboolean retval;
+  gsize len;
+  guint i;
+
+  topicTable = g_new0 (MarkdownBrowserBundleTopic, topics->len);       // ++ alloc topic table
+  imageTable = g_new0 (MarkdownBrowserBundleImage, images->len);       // ++ alloc image table
+  strings = g_string_new ("");                                          // ++ new string pool
+  g_string_append_c (strings, '\0');    // Pool is never empty
+
+  for (i = 0; i < topics->len; i++)
+  {
+    topic = g_ptr_array_index (topics, i);
+    topicTable[i].name = add_string (strings, topic->name);
+    topicTable[i].title = topic->title ? add_string (strings, topic->title) : MARKDOWN_BROWSER_BUNDLE_NONE;
+  }
+
+  for (i = 0; i < images->len; i++)
+    imageTable[i].name = add_string (strings, ((BundleImage *)g_ptr_array_index (images, i))->name);
+
+  memcpy (header.magic, MARKDOWN_BROWSER_BUNDLE_MAGIC, sizeof (header.magic));
+  header.version = MARKDOWN_BROWSER_BUNDLE_VERSION;
+  header.byteOrder = MARKDOWN_BROWSER_BUNDLE_BYTE_ORDER;
+  header.spanSize = sizeof (MarkdownBrowserSpan);
+  header.topicCount = topics->len;
+  header.imageCount = images->len;
+
+  // Header and tables are copied in last, once offsets are known
+  out = g_byte_array_new ();                                            // ++ new bundle data
+  g_byte_array_set_size (out, sizeof (MarkdownBrowserBundleHeader) + topics->len * sizeof (MarkdownBrowserBundleTopic)
+                         + images->len * sizeof (MarkdownBrowserBundleImage));
+
+  header.stringsOfs = out->len;
+  header.stringsLen = strings->len;
+  g_byte_array_append (out, (const guint8 *)strings->str, strings->len);
+  g_string_free (strings, TRUE);                                        // -- free string pool
+
+  for (i = 0; i < topics->len; i++)
+  {
+    topic = g_ptr_array_index (topics, i);
+
+    pad_to_align (out);
+    topicTable[i].spansOfs = out->len;
+    topicTable[i].spanCount = topic->doc->spanCount;
+    g_byte_array_append (out, (const guint8 *)topic->doc->spans, topic->doc->spanCount * sizeof (MarkdownBrowserSpan));
+
+    topicTable[i].textOfs = out->len;
+    topicTable[i].textLen = topic->doc->textLen;
+    g_byte_array_append (out, (const guint8 *)topic->doc->text, topic->doc->textLen);
+
+    if (topic->doc->timedOut)
+      topicTable[i].flags |= MARKDOWN_BROWSER_BUNDLE_TIMED_OUT;
+  }
+
+  for (i = 0, retval = TRUE; i < images->len && retval; i++)
+  {
+    image = g_ptr_array_index (images, i);
+
+    if ((retval = g_file_get_contents (image->path, &content, &len, err)))     // ++ alloc content
+    {
+      pad_to_align (out);
+      imageTable[i].dataOfs = out->len;
+      imageTable[i].dataLen = len;
+      g_byte_array_append (out, (const guint8 *)content, len);
+      g_free (content);                                                 // -- free content
+    }
+  }
+
+  if (retval && out->len > G_MAXUINT32)
+  {
+    g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_FBIG, "Help bundle exceeds 4 GiB");
+    retval = FALSE;
+  }
+
+  if (retval)
+  {
+    memcpy (out->data, &header, sizeof (header));
+    memcpy (out->data + sizeof (header), topicTable, topics->len * sizeof (MarkdownBrowserBundleTopic));
+    memcpy (out->data + sizeof (header) + topics->len * sizeof (MarkdownBrowserBundleTopic), imageTable,
+            images->len * sizeof (MarkdownBrowserBundleImage));
+
+    // Written to a temporary file and renamed, so a running application never maps a partial bundle
+    retval = g_file_set_contents (filename, (const char *)out->data, out->len, err);
+  }
+
+  g_byte_array_free (out, TRUE);                                        // -- free bundle data
+  g_free (imageTable);                                                  // -- free image table
+  g_free (topicTable);                                                  // -- free topic table
+
+  return retval;
+}
+
+int
+main (int argc, char **argv)
+{
+  GRegex *fileRegex = NULL, *titleRegex = NULL, *imageRegex;
+  GPtrArray *topics = NULL, *images;
+  GOptionContext *context;
+  GHashTable *imageTable;
+  GHashTableIter hashIter;
+  BundleImage *image;
+  GError *err = NULL;
+  int status = 1;
+
+  context = g_option_context_new ("DIRECTORY BUNDLE - Compile Markdown help bundle");  // ++ new option context
+  g_option_context_add_main_entries (context, command_line_options, NULL);
+  g_option_context_set_summary (context, CMDLINE_SUMMARY);
+
+  if (!g_option_context_parse (context, &argc, &argv, &err))
+  {
+    g_printerr ("%s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (context);            // -- free option context
+    return 1;
+  }
+
+  g_option_context_free (context);              // -- free option context
+
+  if (argc != 3)
+  {
+    g_printerr ("Usage: %s [OPTION...] DIRECTORY BUNDLE\n", argv[0]);
+    return 1;
+  }
+
+  if (!(fileRegex = g_regex_new (file_match ? file_match : DEFAULT_FILE_MATCH, 0, 0, &err))            // ++ new fileRegex
+      || !(titleRegex = g_regex_new (title_match ? title_match : DEFAULT_TITLE_MATCH,                 // ++ new titleRegex
+                                     G_REGEX_MULTILINE, 0, &err)))
+  {
+    g_printerr ("Invalid regular expression: %s\n", err->message);
+    g_clear_error (&err);
+    g_clear_pointer (&fileRegex, g_regex_unref);                        // -- unref fileRegex
+    return 1;
+  }
+
+  imageRegex = g_regex_new (IMAGE_MATCH, G_REGEX_CASELESS, 0, NULL);    // ++ new imageRegex
+  topics = g_ptr_array_new_with_free_func ((GDestroyNotify)bundle_topic_free);        // ++ new topic array
+  images = g_ptr_array_new_with_free_func ((GDestroyNotify)bundle_image_free);        // ++ new image array
+  imageTable = g_hash_table_new (g_str_hash, g_str_equal);              // ++ new image table (key is image name)
+
+  if (load_topics (argv[1], fileRegex, titleRegex, topics, &err))
+  {
+    find_images (argv[1], imageRegex, imageTable);
+    g_hash_table_iter_init (&hashIter, imageTable);
+
+    while (g_hash_table_iter_next (&hashIter, NULL, (gpointer *)&image))
+      g_ptr_array_add (images, image);          // !! takes over image
+
+    g_ptr_array_sort (topics, bundle_topic_sort);
+    g_ptr_array_sort (images, bundle_image_sort);
+
+    if (write_bundle (argv[2], topics, images, &err))
+      status = 0;
+  }
+
+  if (err)
+  {
+    g_printerr ("Failed to compile help bundle '%s': %s\n", argv[2], err->message);
+    g_clear_error (&err);
+  }
+
+  g_hash_table_destroy (imageTable);            // -- free image table
+  g_ptr_array_free (images, TRUE);              // -- free image array
+  g_ptr_array_free (topics, TRUE);              // -- free topic array
+  g_regex_unref (imageRegex);                   // -- unref imageRegex
+  g_regex_unref (titleRegex);                   // -- unref titleRegex
+  g_regex_unref (fileRegex);                    // -- unref fileRegex
+
+  return status;
+}
@@ -0,0 +1,566 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserDocument.c - Parsed Markdown document representation.
+ */
+#include <string.h>
+
+#include "MarkdownBrowserDocument.h"
+#include "MarkdownBrowserLexer.h"
+#include "MarkdownBrowserScan.h"
+
+#define MAX_FIRST_LEVEL_SPACES  3       // Maximum spaces at beginning of line for first level of list or header
+#define MIN_LEVEL_SPACING       2       // Minimum additional spaces for each list level
+#define SPAN_SIZE_ESTIMATE      32      // Estimated average content bytes per span (for preallocating the span array)
+#define TIME_CHECK_TOKENS       64      // Number of tokens processed between time limit checks
+
+// Characters in Markdown which can be escaped, others will result in the backslash not being considered an escape character
+static const gboolean valid_escaped_chars[256] =
+{
+  ['\\'] = TRUE, ['`'] = TRUE, ['*'] = TRUE, ['_'] = TRUE, ['{'] = TRUE, ['}'] = TRUE, ['['] = TRUE, [']'] = TRUE,
+  ['<'] = TRUE, ['>'] = TRUE, ['('] = TRUE, [')'] = TRUE, ['#'] = TRUE, ['+'] = TRUE, ['-'] = TRUE, ['.'] = TRUE,
+  ['!'] = TRUE, ['|'] = TRUE
+};
+
+// Markdown parse bag (for passing between functions)
+typedef struct
+{
+  MarkdownBrowserDocument *doc; // Document being built
+  GArray *spans;                // Span array being built (MarkdownBrowserSpan)
+  GString *text;                // Text pool being built
+
+  gboolean listItem;            // TRUE if currently in a list item
+  int listLevel;                // Current list level (0=none)
+  guint8 listSpacing[MARKDOWN_BROWSER_MAX_LIST_LEVELS];         // Number of spaces used for each level
+  guint8 numListCounts[MARKDOWN_BROWSER_MAX_LIST_LEVELS];       // Current counts for numbered list levels ([0] == 0 if unnumbered list or no list active)
+
+  int headerSize;               // Current header size (0 for none)
+  gboolean italic;              // True if italic active
+  gboolean bold;                // True if bold active
+  gboolean link;                // True if link active
+} MarkdownBrowserParseBag;
+
+// Get the style bit mask for the current parse state
+static guint16
+markdown_browser_parse_bag_style (MarkdownBrowserParseBag *bag)
+{
+  guint16 style = 0;
+
+  if (bag->bold)
+    style |= MARKDOWN_BROWSER_STYLE_BOLD;
+
+  if (bag->italic)
+    style |= MARKDOWN_BROWSER_STYLE_ITALIC;
+
+  if (bag->link)
+    style |= MARKDOWN_BROWSER_STYLE_LINK;
+
+  style |= bag->headerSize << MARKDOWN_BROWSER_STYLE_HEADER_SHIFT;
+
+  // List tag is only applied within list items
+  if (bag->listItem)
+    style |= bag->listLevel << MARKDOWN_BROWSER_STYLE_LIST_SHIFT;
+
+  return style;
+}
+
+// Add a span to the document, text is copied to the text pool (NUL terminated)
+static MarkdownBrowserSpan *
+markdown_browser_parse_bag_add_span (MarkdownBrowserParseBag *bag, MarkdownBrowserSpanType type, guint16 style,
+                                     const char *text, int len)
+{
+  MarkdownBrowserSpan *span;
+
+  g_array_set_size (bag->spans, bag->spans->len + 1);
+  span = &g_array_index (bag->spans, MarkdownBrowserSpan, bag->spans->len - 1);
+  span->type = type;
+  span->style = style;
+  span->ofs = bag->text->len;
+  span->len = len;
+  span->arg = MARKDOWN_BROWSER_SPAN_NO_ARG;
+
+  g_string_append_len (bag->text, text, len);
+  g_string_append_c (bag->text, '\0');
+
+  return span;
+}
+
+// Append a text span, unescaping Markdown escape sequences
+static void
+markdown_browser_parse_bag_append (MarkdownBrowserParseBag *bag, const char *string, int len)
+{
+  MarkdownBrowserSpan *span;
+  const char *src, *prev, *end;
+
+  if (len == -1)
+    len = strlen (string);
+
+  end = string + len;
+
+  g_array_set_size (bag->spans, bag->spans->len + 1);
+  span = &g_array_index (bag->spans, MarkdownBrowserSpan, bag->spans->len - 1);
+  span->type = MARKDOWN_BROWSER_SPAN_TEXT;
+  span->style = markdown_browser_parse_bag_style (bag);
+  span->ofs = bag->text->len;
+  span->arg = MARKDOWN_BROWSER_SPAN_NO_ARG;
+
+  // Unescape string into text pool, jumping from backslash to backslash
+  for (src = prev = string; (src = markdown_browser_scan_chars (src, end, "\\", 1)); )
+  { // Is next char a valid character to escape?
+    if (src + 1 < end && valid_escaped_chars[(guchar)src[1]])
+    {
+      // Any previous string data to copy?
+      if (src > prev)
+        g_string_append_len (bag->text, prev, src - prev);
+
+      prev = src + 1;
+      src += 2;
+    }
+    else src++;
+  }
+
+  if (end > prev)
+    g_string_append_len (bag->text, prev, end - prev);
+
+  span->len = bag->text->len - span->ofs;
+  g_string_append_c (bag->text, '\0');
+}
+
+// Process a list item token
+static void
+markdown_browser_parse_list_item (MarkdownBrowserParseBag *bag, MarkdownBrowserToken *token)
+{
+  gboolean newLevel;
+  int spaceCount, i;
+  char number[16];
+
+  spaceCount = token->argEnd - token->argStart;
+
+  // Too many spaces for first level item?
+  if (bag->listLevel == 0 && spaceCount > MAX_FIRST_LEVEL_SPACES)
+    return;
+
+  bag->listItem = TRUE;
+
+  if (bag->listLevel > 0)
+  { // Loop over levels looking for matching spacing
+    for (i = 0; i < bag->listLevel - 1; i++)
+      if (spaceCount - bag->listSpacing[i] < bag->listSpacing[i + 1] - spaceCount)
+        break;
+
+    newLevel = (i == bag->listLevel - 1 && spaceCount >= bag->listSpacing[i] + MIN_LEVEL_SPACING
+                && bag->listLevel < MARKDOWN_BROWSER_MAX_LIST_LEVELS);
+
+    if (!newLevel)
+      bag->listLevel = i + 1;
+  }
+  else newLevel = TRUE;
+
+  // Is this a new level?
+  if (newLevel)
+  {
+    bag->listSpacing[bag->listLevel] = spaceCount;
+    bag->numListCounts[bag->listLevel] = 0;
+    bag->listLevel++;
+  }
+
+  // Bullet list?  Bullet character is selected by list level when rendering
+  if (token->type == MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START)
+    markdown_browser_parse_bag_add_span (bag, MARKDOWN_BROWSER_SPAN_BULLET,
+                                         markdown_browser_parse_bag_style (bag), "", 0);
+  else    // Numeric list
+  {
+    bag->numListCounts[bag->listLevel - 1]++;
+
+    g_snprintf (number, sizeof (number), "%d. ", bag->numListCounts[bag->listLevel - 1]);
+    markdown_browser_parse_bag_append (bag, number, -1);
+  }
+}
+
+// Move the span array and text pool being built into the document, returns the document
+static MarkdownBrowserDocument *
+markdown_browser_parse_bag_finish (MarkdownBrowserParseBag *bag)
+{
+  MarkdownBrowserDocument *doc = bag->doc;
+
+  doc->spanCount = bag->spans->len;
+  doc->spans = (MarkdownBrowserSpan *)g_array_free (bag->spans, FALSE);        // !! document takes over span data
+  doc->textLen = bag->text->len;
+  doc->text = g_string_free (bag->text, FALSE);                                 // !! document takes over text pool
+
+  return doc;
+}
+
+// Parse the content of an initialized lexer into a new document (see markdown_browser_document_new())
+static MarkdownBrowserDocument *
+markdown_browser_document_parse (MarkdownBrowserLexer *lexer, int timeLimit)
+{
+  MarkdownBrowserDocument *doc;
+  MarkdownBrowserParseBag bag = { 0 };
+  MarkdownBrowserToken token;
+  MarkdownBrowserSpan *span;
+  const char *content = lexer->content;
+  int len = lexer->len;
+  gint64 endTime;
+  guint tokens = 0;
+  int count;
+
+  // Size the span array and text pool up front (text pool is rarely larger than the content), to avoid reallocations
+  doc = g_new0 (MarkdownBrowserDocument, 1);
+  doc->refCount = 1;
+  bag.spans = g_array_sized_new (FALSE, FALSE, sizeof (MarkdownBrowserSpan), len / SPAN_SIZE_ESTIMATE + 16);
+  bag.text = g_string_sized_new (len + len / 16 + 16);
+
+  bag.doc = doc;
+  endTime = timeLimit > 0 ? g_get_monotonic_time () + (gint64)timeLimit * 1000 : 0;
+
+  // No tokens?  Just use the entire content as is
+  if (!markdown_browser_lexer_next (lexer, FALSE, FALSE, &token))
+  {
+    markdown_browser_parse_bag_add_span (&bag, MARKDOWN_BROWSER_SPAN_TEXT, 0, content, len);
+    return markdown_browser_parse_bag_finish (&bag);
+  }
+
+  // Process content tokens into document spans
+  do
+  { // If list is active and end of list item, but this is not the start of another list item, deactivate list
+    if (bag.listLevel > 0 && !bag.listItem && token.type != MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START
+        && token.type != MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START)
+      bag.listLevel = 0;
+
+    // Any content prior to next token? - Append it
+    if (token.start > lexer->pos)
+      markdown_browser_parse_bag_append (&bag, content + lexer->pos, token.start - lexer->pos);
+
+    switch (token.type)
+    {
+      case MARKDOWN_BROWSER_TOKEN_EMPHASIS_START:
+        count = token.argEnd - token.argStart;  // Count emphasis chars
+        bag.italic |= (count & 1) ? 1 : 0;      // 1 or 3 * or _ characters enables italic
+        bag.bold |= (count & 2) ? 1 : 0;        // 2 or 3 * or _ characters enables bold
+        break;
+      case MARKDOWN_BROWSER_TOKEN_HEADER_START:
+        bag.headerSize = token.argEnd - token.argStart;       // Count header characters
+        break;
+      case MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START:
+      case MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START:
+        markdown_browser_parse_list_item (&bag, &token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_IMAGE:
+        span = markdown_browser_parse_bag_add_span (&bag, MARKDOWN_BROWSER_SPAN_IMAGE, markdown_browser_parse_bag_style (&bag),
+                                                    content + token.arg2Start, token.arg2End - token.arg2Start);
+        // Add image alt text for tooltip
+        if (token.argEnd > token.argStart)
+        {
+          span->arg = bag.text->len;
+          g_string_append_len (bag.text, content + token.argStart, token.argEnd - token.argStart);
+          g_string_append_c (bag.text, '\0');
+        }
+        break;
+      case MARKDOWN_BROWSER_TOKEN_LINK:
+        // Add link target followed by the linked text
+        markdown_browser_parse_bag_add_span (&bag, MARKDOWN_BROWSER_SPAN_LINK, markdown_browser_parse_bag_style (&bag),
+                                             content + token.arg2Start, token.arg2End - token.arg2Start);
+        bag.link = TRUE;
+        markdown_browser_parse_bag_append (&bag, content + token.argStart, token.argEnd - token.argStart);
+        bag.link = FALSE;
+        break;
+      case MARKDOWN_BROWSER_TOKEN_EMPHASIS_END:
+        count = token.end - token.start;        // Count emphasis chars
+        bag.italic &= (count & 1) ? 0 : 1;      // 1 or 3 * or _ characters disables italic
+        bag.bold &= (count & 2) ? 0 : 1;        // 2 or 3 * or _ characters enables bold
+        break;
+      case MARKDOWN_BROWSER_TOKEN_LINE_END:
+        bag.headerSize = 0;
+        bag.listItem = FALSE;
+        break;
+      default:
+        break;
+    }
+  } while (!(doc->timedOut = endTime && ++tokens % TIME_CHECK_TOKENS == 0 && g_get_monotonic_time () > endTime)
+           && markdown_browser_lexer_next (lexer, bag.italic || bag.bold, bag.headerSize > 0 || bag.listItem, &token));
+
+  if (doc->timedOut)
+  { // Out of time, add the content after the last token as is, without styles
+    if (token.end < len)
+      markdown_browser_parse_bag_add_span (&bag, MARKDOWN_BROWSER_SPAN_TEXT, 0, content + token.end, len - token.end);
+  }
+  else if (lexer->pos < len)            // Append any remaining content after the last token
+    markdown_browser_parse_bag_append (&bag, content + lexer->pos, len - lexer->pos);
+
+  return markdown_browser_parse_bag_finish (&bag);
+}
+
+/**
+ * markdown_browser_document_new:
+ * @content: Markdown content
+ * @len: Length of @content in bytes or -1 if NUL terminated
+ * @timeLimit: Parse time limit in milliseconds or 0 for no limit
+ *
+ * Parse Markdown content into a new document.  Does not use any GTK
+ * functionality, so it is safe to call from any thread.  If parsing takes
+ * longer than @timeLimit, the remaining content is added as plain text
+ * and the timedOut field of the document is set.
+ *
+ * Returns: (transfer full): New document with a reference count of 1
+ */
+MarkdownBrowserDocument *
+markdown_browser_document_new (const char *content, int len, int timeLimit)
+{
+  MarkdownBrowserLexer lexer;
+
+  g_return_val_if_fail (content != NULL, NULL);
+
+  markdown_browser_lexer_init (&lexer, content, len);
+
+  return markdown_browser_document_parse (&lexer, timeLimit);
+}
+
+#ifdef DEBUG
+
+/**
+ * markdown_browser_document_new_regex:
+ * @content: Markdown content
+ * @len: Length of @content in bytes or -1 if NUL terminated
+ *
+ * Parse Markdown content into a new document like markdown_browser_document_new(), but find tokens
+ * with the regular expressions the renderer originally used instead of the single pass lexer.
+ * Only available in debug builds, for checking the lexer against the original scan.
+ *
+ * Returns: (transfer full): New document with a reference count of 1
+ */
+MarkdownBrowserDocument *
+markdown_browser_document_new_regex (const char *content, int len)
+{
+  MarkdownBrowserLexer lexer;
+
+  g_return_val_if_fail (content != NULL, NULL);
+
+  markdown_browser_lexer_init_regex (&lexer, content, len);
+
+  return markdown_browser_document_parse (&lexer, 0);
+}
+
+#endif
+
+/**
+ * markdown_browser_document_new_from_data:
+ * @storage: Data which @spans and @text point into, a reference is added
+ * @spans: Spans in render order
+ * @spanCount: Number of spans
+ * @text: Text pool referenced by spans
+ * @textLen: Size of @text in bytes
+ * @timedOut: Value of the timedOut field
+ *
+ * Create a document from spans and a text pool of a previously parsed document, without
+ * copying them (such as a memory mapped help bundle).  The spans are checked to only
+ * reference NUL terminated text within the text pool and to have valid header numbers and
+ * list levels.
+ *
+ * Returns: (transfer full): New document with a reference count of 1 or NULL if the spans are invalid
+ */
+MarkdownBrowserDocument *
+markdown_browser_document_new_from_data (GBytes *storage, const MarkdownBrowserSpan *spans, guint spanCount,
+                                         const char *text, guint textLen, gboolean timedOut)
+{
+  MarkdownBrowserDocument *doc;
+  const MarkdownBrowserSpan *span;
+  guint i;
+
+  g_return_val_if_fail (storage != NULL, NULL);
+
+  // Text of each span is followed by a NUL, last byte of the pool terminates any argument string
+  if (spanCount > 0 && (textLen == 0 || text[textLen - 1] != '\0'))
+    return NULL;
+
+  // Header number and list level index tag and bullet arrays when rendered
+  for (i = 0, span = spans; i < spanCount; i++, span++)
+    if (span->type > MARKDOWN_BROWSER_SPAN_LINK || span->ofs >= textLen || span->len >= textLen - span->ofs
+        || text[span->ofs + span->len] != '\0' || (span->arg != MARKDOWN_BROWSER_SPAN_NO_ARG && span->arg >= textLen)
+        || MARKDOWN_BROWSER_STYLE_HEADER (span->style) > MARKDOWN_BROWSER_MAX_HEADER_NUMBER
+        || MARKDOWN_BROWSER_STYLE_LIST (span->style) > MARKDOWN_BROWSER_MAX_LIST_LEVELS)
+      return NULL;
+
+  doc = g_new0 (MarkdownBrowserDocument, 1);
+  doc->refCount = 1;
+  doc->spans = spans;
+  doc->spanCount = spanCount;
+  doc->text = text;
+  doc->textLen = textLen;
+  doc->timedOut = timedOut;
+  doc->storage = g_bytes_ref (storage);         // ++ ref storage
+
+  return doc;
+}
+
+/**
+ * markdown_browser_document_ref:
+ * @doc: Markdown document
+ *
+ * Add a reference to a document (thread safe).
+ *
+ * Returns: @doc
+ */
+MarkdownBrowserDocument *
+markdown_browser_document_ref (MarkdownBrowserDocument *doc)
+{
+  g_return_val_if_fail (doc != NULL, NULL);
+
+  g_atomic_int_inc (&doc->refCount);
+  return doc;
+}
+
+/**
+ * markdown_browser_document_unref:
+ * @doc: Markdown document
+ *
+ * Remove a reference from a document (thread safe), freeing it when there are no more references.
+ */
+void
+markdown_browser_document_unref (MarkdownBrowserDocument *doc)
+{
+  g_return_if_fail (doc != NULL);
+
+  if (!g_atomic_int_dec_and_test (&doc->refCount))
+    return;
+
+  if (doc->storage)
+    g_bytes_unref (doc->storage);               // -- unref storage
+  else
+  {
+    g_free ((MarkdownBrowserSpan *)doc->spans);
+    g_free ((char *)doc->text);
+  }
+
+  g_free (doc);
+}
+
+/**
+ * markdown_browser_document_get_sections:
+ * @doc: Markdown document
+ * @level: Maximum header number which starts a section (1-6) or 0 for no sections
+ * @sections: Array of guint to store the span index of the start of each section to (cleared first)
+ *
+ * Split a document into sections at headers up to a given header number.  Content before
+ * the first header is a section of its own.  A document always has at least one section.
+ */
+void
+markdown_browser_document_get_sections (MarkdownBrowserDocument *doc, int level, GArray *sections)
+{
+  const MarkdownBrowserSpan *span;
+  guint i, header, prevHeader = 0;
+
+  g_return_if_fail (doc != NULL);
+  g_return_if_fail (sections != NULL);
+
+  g_array_set_size (sections, 0);
+  i = 0;
+  g_array_append_val (sections, i);
+
+  for (i = 0; i < doc->spanCount; i++)
+  {
+    span = &doc->spans[i];
+    header = MARKDOWN_BROWSER_STYLE_HEADER (span->style);
+
+    // First span of a header line starts a section (unless it is the start of the document)
+    if (header > 0 && header <= level && prevHeader == 0 && i > 0)
+      g_array_append_val (sections, i);
+
+    prevHeader = header;
+  }
+}
+
+/**
+ * markdown_browser_document_find_anchor:
+ * @doc: Markdown document
+ * @sections: Section start span indexes from markdown_browser_document_get_sections()
+ * @anchor: Link anchor (without the '#')
+ *
+ * Find the section whose header matches a link anchor.  Header text is converted to an anchor by
+ * lower casing it, replacing spaces with '-' and removing ASCII punctuation, like most Markdown renderers do.
+ *
+ * Returns: Section index or -1 if not found
+ */
+int
+markdown_browser_document_find_anchor (MarkdownBrowserDocument *doc, GArray *sections, const char *anchor)
+{
+  const MarkdownBrowserSpan *span;
+  const char *a, *s, *end;
+  guint i, si, header;
+  char c;
+
+  g_return_val_if_fail (doc != NULL, -1);
+  g_return_val_if_fail (anchor != NULL, -1);
+
+  for (si = 0; si < sections->len; si++)
+  {
+    i = g_array_index (sections, guint, si);
+    a = anchor;
+    header = 0;
+
+    // Compare the text spans of the header line with the anchor
+    for (; i < doc->spanCount; i++)
+    {
+      span = &doc->spans[i];
+
+      if (!MARKDOWN_BROWSER_STYLE_HEADER (span->style))
+        break;
+
+      header = 1;
+
+      if (span->type != MARKDOWN_BROWSER_SPAN_TEXT)
+        continue;
+
+      s = markdown_browser_document_span_text (doc, span);
+      end = s + span->len;
+
+      // Skip leading spaces of header
+      if (a == anchor)
+        while (s < end && *s == ' ')
+          s++;
+
+      for (; s < end && a; s++)
+      {
+        if (*s == ' ' || *s == '-')
+          c = '-';
+        else if (g_ascii_isalnum (*s) || *s == '_' || (guchar)*s >= 0x80)
+          c = g_ascii_tolower (*s);
+        else continue;          // Punctuation is dropped
+
+        if (*a == c)
+          a++;
+        else if (*a || c != '-')        // Trailing spaces of the header are ignored
+          a = NULL;                     // Mismatch
+      }
+
+      if (!a)
+        break;
+    }
+
+    if (header && a && !*a)
+      return si;
+  }
+
+  return -1;
+}
@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserDocument.h - Parsed Markdown document representation.
+ */
+#ifndef MARKDOWN_BROWSER_DOCUMENT_H
+#define MARKDOWN_BROWSER_DOCUMENT_H
+
+#include <glib.h>
+
+#define MARKDOWN_BROWSER_MAX_LIST_LEVELS        10      // Maximum number of nested list levels (1 = bullet list without children)
+#define MARKDOWN_BROWSER_MAX_HEADER_NUMBER      6       // Maximum header number (h6)
+
+/**
+ * MarkdownBrowserSpanType:
+ * @MARKDOWN_BROWSER_SPAN_TEXT: Run of unescaped text
+ * @MARKDOWN_BROWSER_SPAN_BULLET: Bullet of a list item (character depends on list level, no text)
+ * @MARKDOWN_BROWSER_SPAN_IMAGE: Image, text is the image name and arg is the alt text
+ * @MARKDOWN_BROWSER_SPAN_LINK: Link target at the current position, text is the link URL
+ *
+ * Types of document spans.
+ */
+typedef enum
+{
+  MARKDOWN_BROWSER_SPAN_TEXT,
+  MARKDOWN_BROWSER_SPAN_BULLET,
+  MARKDOWN_BROWSER_SPAN_IMAGE,
+  MARKDOWN_BROWSER_SPAN_LINK
+} MarkdownBrowserSpanType;
+
+// Span style bit mask
+#define MARKDOWN_BROWSER_STYLE_BOLD             (1 << 0)        // Bold emphasis
+#define MARKDOWN_BROWSER_STYLE_ITALIC           (1 << 1)        // Italic emphasis
+#define MARKDOWN_BROWSER_STYLE_LINK             (1 << 2)        // Link text
+#define MARKDOWN_BROWSER_STYLE_HEADER_SHIFT     3               // Header number 1-6 (0 if none)
+#define MARKDOWN_BROWSER_STYLE_HEADER_MASK      (0x7 << MARKDOWN_BROWSER_STYLE_HEADER_SHIFT)
+#define MARKDOWN_BROWSER_STYLE_LIST_SHIFT       6               // List item level 1-10 (0 if none)
+#define MARKDOWN_BROWSER_STYLE_LIST_MASK        (0xF << MARKDOWN_BROWSER_STYLE_LIST_SHIFT)
+
+#define MARKDOWN_BROWSER_STYLE_HEADER(style)    (((style) & MARKDOWN_BROWSER_STYLE_HEADER_MASK) >> MARKDOWN_BROWSER_STYLE_HEADER_SHIFT)
+#define MARKDOWN_BROWSER_STYLE_LIST(style)      (((style) & MARKDOWN_BROWSER_STYLE_LIST_MASK) >> MARKDOWN_BROWSER_STYLE_LIST_SHIFT)
+
+// Span arg value when there is none
+#define MARKDOWN_BROWSER_SPAN_NO_ARG            G_MAXUINT32
+
+/**
+ * MarkdownBrowserSpan:
+ * @type: Span type (#MarkdownBrowserSpanType)
+ * @style: Style bit mask (MARKDOWN_BROWSER_STYLE_*)
+ * @ofs: Offset of span text in the document text pool
+ * @len: Length of span text in bytes
+ * @arg: Offset of NUL terminated argument string in the text pool (image alt text)
+ *   or MARKDOWN_BROWSER_SPAN_NO_ARG
+ *
+ * A span of a parsed Markdown document.  Image names and link URLs are NUL terminated in the text pool.
+ */
+typedef struct
+{
+  guint16 type;
+  guint16 style;
+  guint32 ofs;
+  guint32 len;
+  guint32 arg;
+} MarkdownBrowserSpan;
+
+/**
+ * MarkdownBrowserDocument:
+ * @spans: Array of #MarkdownBrowserSpan in render order
+ * @spanCount: Number of spans
+ * @text: Text pool referenced by spans
+ * @textLen: Size of the text pool in bytes
+ * @timedOut: TRUE if the parse time limit was exceeded and the end of the content is plain text
+ * @storage: Data which @spans and @text point into (ref held) or NULL if they are allocated
+ *
+ * Parsed Markdown document.  Contains no GTK objects, so it can be created in any thread
+ * and rendered later.  Reference counted and immutable once created.
+ */
+typedef struct _MarkdownBrowserDocument MarkdownBrowserDocument;
+
+struct _MarkdownBrowserDocument
+{
+  int refCount;
+  const MarkdownBrowserSpan *spans;
+  guint spanCount;
+  const char *text;
+  guint textLen;
+  gboolean timedOut;
+  GBytes *storage;
+};
+
+#define markdown_browser_document_span_text(doc, span)  ((doc)->text + (span)->ofs)
+
+MarkdownBrowserDocument *markdown_browser_document_new (const char *content, int len, int timeLimit);
+#ifdef DEBUG
+MarkdownBrowserDocument *markdown_browser_document_new_regex (const char *content, int len);
+#endif
+MarkdownBrowserDocument *markdown_browser_document_new_from_data (GBytes *storage, const MarkdownBrowserSpan *spans,
+                                                                  guint spanCount, const char *text, guint textLen,
+                                                                  gboolean timedOut);
+MarkdownBrowserDocument *markdown_browser_document_ref (MarkdownBrowserDocument *doc);
+void markdown_browser_document_unref (MarkdownBrowserDocument *doc);
+void markdown_browser_document_get_sections (MarkdownBrowserDocument *doc, int level, GArray *sections);
+int markdown_browser_document_find_anchor (MarkdownBrowserDocument *doc, GArray *sections, const char *anchor);
+
+#endif
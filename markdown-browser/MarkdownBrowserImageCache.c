@@ -0,0 +1,1173 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserImageCache.c - Process wide cache of decoded images.
+ *
+ * Decoded pixbufs are shared by all browser instances and topics, keyed by file name,
+ * modification time and requested size, so a changed file is decoded again.  Pixbufs are
+ * never modified once cached.  Animations are cached too (with a size of 0, since they are
+ * only decoded at natural size), so their decoded frames are shared.  Least recently used images are evicted once the total
+ * pixel data exceeds the byte budget.
+ *
+ * Rasterizing scalable images (SVG) is expensive, so their decoded pixel data is also
+ * kept on disk under $XDG_CACHE_HOME/markdown-browser/raster, keyed by a hash of the file
+ * content and the decode size (which includes the display scale factor).  Hits are
+ * memory mapped without parsing the image.  The content hash and natural size of each image
+ * are recorded with the size and modification time of its file, so an unchanged file is
+ * neither read nor parsed to look up its size or rasters.  Least recently used rasters are
+ * removed once they exceed the raster byte budget (hits update their modification time).
+ *
+ * Image file names can also be GResource URIs (resource:///path/image.png) or images of
+ * help bundles registered with markdown_browser_image_cache_add_data() (bundle://...),
+ * which are immutable, so their modification time is taken as 0.
+ */
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "MarkdownBrowserImageCache.h"
+
+// A cached image
+typedef struct
+{
+  char *key;                    // Hash key (file name, modification time and size)
+  GObject *object;              // Decoded image, GdkPixbuf or GdkPixbufAnimation (ref held)
+  gsize bytes;                  // Size of pixel data
+  GList link;                   // Link in LRU queue (data points to this entry)
+} MarkdownBrowserImageCacheEntry;
+
+static void markdown_browser_image_cache_run_task (const char *filename, int width, int height,
+                                                   GCancellable *cancellable, GAsyncReadyCallback callback,
+                                                   gpointer user_data);
+
+// Resource path of an image file name if it is a resource URI, NULL if it is a regular file
+#define markdown_browser_image_resource_path(filename) \
+  (g_str_has_prefix (filename, MARKDOWN_BROWSER_RESOURCE_PREFIX) ? (filename) + strlen (MARKDOWN_BROWSER_RESOURCE_PREFIX) : NULL)
+
+// TRUE if an image file name is a help bundle image registered with markdown_browser_image_cache_add_data()
+#define markdown_browser_image_is_bundle(filename)      g_str_has_prefix (filename, MARKDOWN_BROWSER_BUNDLE_PREFIX)
+
+static const char *markdown_browser_raster_cache_dir (void);
+static char *markdown_browser_raster_cache_source (const char *dir, const char *filename, int *width, int *height);
+
+static GMutex cache_mutex;                      // Locks all cache state
+static GHashTable *cache_table;                 // Key string -> MarkdownBrowserImageCacheEntry
+static GQueue cache_lru = G_QUEUE_INIT;         // Entries, most recently used first
+static gsize cache_bytes;                       // Total bytes of cached pixel data
+static gsize cache_budget = MARKDOWN_BROWSER_IMAGE_CACHE_DEFAULT_BUDGET;
+static guint cache_hits;                        // Lookup statistics
+static guint cache_misses;
+static guint raster_hits;                       // On-disk raster cache statistics
+static guint raster_misses;
+static GMutex raster_mutex;                     // Guards raster budget accounting and eviction
+static gsize raster_budget = MARKDOWN_BROWSER_RASTER_CACHE_DEFAULT_BUDGET;
+static gint64 raster_bytes = -1;                // Size of raster files, -1 until the directory has been scanned
+static GHashTable *data_table;                  // Bundle image file name -> image file data (GBytes), never freed
+
+#define RASTER_CACHE_MAGIC      "MDBRAST1"      // Raster cache file magic and format version
+#define RASTER_SOURCE_MAGIC     "MDBRSRC1"      // Raster cache source record magic and format version
+#define RASTER_HASH_LEN         64              // Length of a SHA-256 hex string
+
+// Raster cache file header, followed by the pixel data
+typedef struct
+{
+  char magic[8];
+  guint32 width;
+  guint32 height;
+  guint32 rowstride;
+  guint32 hasAlpha;
+} MarkdownBrowserRasterHeader;
+
+// A raster file considered for eviction
+typedef struct
+{
+  char *path;
+  gint64 mtime;
+  gint64 size;
+} MarkdownBrowserRasterFile;
+
+// Raster cache source record of an image file name (<hash of file name>.source)
+typedef struct
+{
+  char magic[8];
+  gint64 size;                  // Size of the image data
+  gint64 mtime;                 // Modification time of the file (0 for resources, bundle images and recent changes)
+  char hash[RASTER_HASH_LEN];   // Content hash (not NUL terminated)
+  guint32 width;                // Natural image size
+  guint32 height;
+} MarkdownBrowserRasterSource;
+
+// Async decode task data
+typedef struct
+{
+  char *filename;
+  int width;                    // Decode size (0 for an animation)
+  int height;
+} MarkdownBrowserImageCacheTask;
+
+static void
+markdown_browser_image_cache_entry_free (MarkdownBrowserImageCacheEntry *entry)
+{
+  g_object_unref (entry->object);       // -- unref image
+  g_free (entry->key);                  // -- free key
+  g_slice_free (MarkdownBrowserImageCacheEntry, entry);
+}
+
+// Evict least recently used entries until the cache fits in the budget (cache_mutex must be locked)
+static void
+markdown_browser_image_cache_evict (gsize budget)
+{
+  MarkdownBrowserImageCacheEntry *entry;
+
+  while (cache_bytes > budget && cache_lru.tail)
+  {
+    entry = cache_lru.tail->data;
+    g_queue_unlink (&cache_lru, &entry->link);
+    cache_bytes -= entry->bytes;
+    g_hash_table_remove (cache_table, entry->key);      // -- free entry
+  }
+}
+
+// Get the registered data of a help bundle image (NULL if not registered)
+static GBytes *
+markdown_browser_image_cache_lookup_data (const char *filename)        // ++ ref data
+{
+  GBytes *data = NULL;
+
+  g_mutex_lock (&cache_mutex);
+
+  if (data_table && (data = g_hash_table_lookup (data_table, filename)))
+    g_bytes_ref (data);
+
+  g_mutex_unlock (&cache_mutex);
+
+  return data;
+}
+
+// Build the cache key of an image file (NULL if the file could not be checked)
+static char *
+markdown_browser_image_cache_key (const char *filename, int width, int height)   // ++ alloc key
+{
+  GStatBuf statBuf;
+  const char *resource;
+
+  if ((resource = markdown_browser_image_resource_path (filename)) || markdown_browser_image_is_bundle (filename))
+  {
+    if (!markdown_browser_image_cache_file_exists (filename))
+      return NULL;
+
+    return g_strdup_printf ("%s\n0\n%dx%d", filename, width, height);
+  }
+
+  if (g_stat (filename, &statBuf) != 0)
+    return NULL;
+
+  return g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%dx%d", filename, (gint64)statBuf.st_mtime, width, height);
+}
+
+// Look up an image in the cache by its file name and size
+static GObject *
+markdown_browser_image_cache_lookup_object (const char *filename, int width, int height)  // ++ ref image
+{
+  MarkdownBrowserImageCacheEntry *entry;
+  GObject *object = NULL;
+  char *key;
+
+  key = markdown_browser_image_cache_key (filename, width, height);    // ++ alloc key
+
+  g_mutex_lock (&cache_mutex);
+
+  if (key && cache_table && (entry = g_hash_table_lookup (cache_table, key)))
+  {
+    g_queue_unlink (&cache_lru, &entry->link);
+    g_queue_push_head_link (&cache_lru, &entry->link);
+    object = g_object_ref (entry->object);              // ++ ref image
+    cache_hits++;
+  }
+  else cache_misses++;
+
+  g_mutex_unlock (&cache_mutex);
+  g_free (key);                                         // -- free key
+
+  return object;
+}
+
+// Add an image to the cache, bytes is the size of its pixel data
+static void
+markdown_browser_image_cache_add_object (const char *filename, int width, int height, GObject *object, gsize bytes)
+{
+  MarkdownBrowserImageCacheEntry *entry;
+  char *key;
+
+  if (!(key = markdown_browser_image_cache_key (filename, width, height)))     // ++ alloc key
+    return;
+
+  entry = g_slice_new (MarkdownBrowserImageCacheEntry);
+  entry->key = key;                                     // !! takes over key
+  entry->object = g_object_ref (object);                // ++ ref image
+  entry->bytes = bytes;
+  entry->link.data = entry;
+  entry->link.prev = entry->link.next = NULL;
+
+  g_mutex_lock (&cache_mutex);
+
+  if (!cache_table)
+    cache_table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                         (GDestroyNotify)markdown_browser_image_cache_entry_free);
+
+  if (entry->bytes > cache_budget || g_hash_table_contains (cache_table, key))
+    markdown_browser_image_cache_entry_free (entry);    // -- free entry
+  else
+  {
+    markdown_browser_image_cache_evict (cache_budget - entry->bytes);
+    g_hash_table_insert (cache_table, entry->key, entry);       // !! takes over entry
+    g_queue_push_head_link (&cache_lru, &entry->link);
+    cache_bytes += entry->bytes;
+  }
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_image_cache_lookup:
+ * @filename: Image file name
+ * @width: Width the image was scaled to or -1 for natural size
+ * @height: Height the image was scaled to or -1 for natural size
+ *
+ * Get an image from the process wide image cache, without decoding it on a miss.
+ * The returned pixbuf is shared and must not be modified.  Safe to call from any thread.
+ *
+ * Returns: New reference to the image or NULL if not cached
+ */
+GdkPixbuf *
+markdown_browser_image_cache_lookup (const char *filename, int width, int height)
+{
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (width != 0 && height != 0, NULL);
+
+  return GDK_PIXBUF (markdown_browser_image_cache_lookup_object (filename, width, height));
+}
+
+/**
+ * markdown_browser_image_cache_add:
+ * @filename: Image file name
+ * @width: Width the image was scaled to or -1 for natural size
+ * @height: Height the image was scaled to or -1 for natural size
+ * @pixbuf: Decoded image, must not be modified afterwards
+ *
+ * Add a decoded image to the process wide image cache.  Images larger than the budget or
+ * already cached are ignored.  Safe to call from any thread.
+ */
+void
+markdown_browser_image_cache_add (const char *filename, int width, int height, GdkPixbuf *pixbuf)
+{
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (width != 0 && height != 0);
+  g_return_if_fail (GDK_IS_PIXBUF (pixbuf));
+
+  markdown_browser_image_cache_add_object (filename, width, height, G_OBJECT (pixbuf),
+                                           gdk_pixbuf_get_byte_length (pixbuf));
+}
+
+/**
+ * markdown_browser_image_cache_lookup_animation:
+ * @filename: Animated image file name
+ *
+ * Get an animation from the process wide image cache, without decoding it on a miss.
+ * The returned animation is shared, create a separate iterator for each use of it.
+ *
+ * Returns: New reference to the animation or NULL if not cached
+ */
+GdkPixbufAnimation *
+markdown_browser_image_cache_lookup_animation (const char *filename)
+{
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  return GDK_PIXBUF_ANIMATION (markdown_browser_image_cache_lookup_object (filename, 0, 0));
+}
+
+// Read the data of an image file, resource or bundle image (resource and bundle data is not copied)
+static GBytes *
+markdown_browser_image_cache_read (const char *filename)       // ++ new bytes
+{
+  const char *resource;
+  char *content;
+  gsize len;
+
+  if ((resource = markdown_browser_image_resource_path (filename)))
+    return g_resources_lookup_data (resource, G_RESOURCE_LOOKUP_FLAGS_NONE, NULL);
+
+  if (markdown_browser_image_is_bundle (filename))
+    return markdown_browser_image_cache_lookup_data (filename);
+
+  if (!g_file_get_contents (filename, &content, &len, NULL))   // ++ alloc content
+    return NULL;
+
+  return g_bytes_new_take (content, len);                       // !! takes over content
+}
+
+static void
+markdown_browser_image_cache_size_prepared (GdkPixbufLoader *loader, int width, int height, gpointer data)
+{
+  int *size = data;
+
+  size[0] = width;
+  size[1] = height;
+}
+
+// TRUE if an image file name is an SVG image, going by its extension so it is known without parsing the image
+static gboolean
+markdown_browser_image_is_svg (const char *filename)
+{
+  const char *ext = strrchr (filename, '.');
+
+  return ext && (g_ascii_strcasecmp (ext, ".svg") == 0 || g_ascii_strcasecmp (ext, ".svgz") == 0);
+}
+
+// Get the pixbuf format of SVG images, NULL if there is no SVG loader
+static GdkPixbufFormat *
+markdown_browser_image_svg_format (void)
+{
+  static gsize initialized = 0;
+  static GdkPixbufFormat *format = NULL;
+  GSList *formats, *p;
+
+  if (g_once_init_enter (&initialized))
+  {
+    formats = gdk_pixbuf_get_formats ();                // ++ alloc format list
+
+    for (p = formats; p && !format; p = p->next)
+      if (g_strcmp0 (gdk_pixbuf_format_get_name (p->data), "svg") == 0)
+        format = p->data;
+
+    g_slist_free (formats);                             // -- free format list (formats are static)
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return format;
+}
+
+// Get the format and size of an image by feeding it to a loader until the size is known (the whole document for SVG)
+static GdkPixbufFormat *
+markdown_browser_image_cache_probe (const char *filename, int *width, int *height)
+{
+  GdkPixbufFormat *format = NULL;
+  GdkPixbufLoader *loader;
+  const guchar *data;
+  int size[2] = { 0, 0 };
+  GBytes *bytes;
+  gsize len, ofs;
+
+  if (!g_str_has_prefix (filename, MARKDOWN_BROWSER_RESOURCE_PREFIX) && !markdown_browser_image_is_bundle (filename))
+    return gdk_pixbuf_get_file_info (filename, width, height);
+
+  if (!(bytes = markdown_browser_image_cache_read (filename)))         // ++ ref resource or bundle data
+    return NULL;
+
+  data = g_bytes_get_data (bytes, &len);
+  loader = gdk_pixbuf_loader_new ();                    // ++ new loader
+  g_signal_connect (loader, "size-prepared", G_CALLBACK (markdown_browser_image_cache_size_prepared), size);
+
+  // Write the data in chunks until the size is known, like gdk_pixbuf_get_file_info() does for files
+  for (ofs = 0; ofs < len && size[0] == 0; ofs += 4096)
+    if (!gdk_pixbuf_loader_write (loader, data + ofs, MIN (len - ofs, 4096), NULL))
+      break;
+
+  if (size[0] > 0)
+    format = gdk_pixbuf_loader_get_format (loader);
+
+  gdk_pixbuf_loader_close (loader, NULL);               // Incomplete image errors are expected
+  g_object_unref (loader);                              // -- unref loader
+  g_bytes_unref (bytes);                                // -- unref resource or bundle data
+
+  if (width)
+    *width = size[0];
+
+  if (height)
+    *height = size[1];
+
+  return format;
+}
+
+/**
+ * markdown_browser_image_cache_get_file_info:
+ * @filename: Image file name, resource URI (resource:///path/image.png) or bundle image
+ * @width: (out) (optional): Location to store the image width or NULL
+ * @height: (out) (optional): Location to store the image height or NULL
+ *
+ * Get the format and size of an image without decoding it, like gdk_pixbuf_get_file_info()
+ * but also for resources and bundle images.  The size of an SVG image is only determined (which
+ * parses the whole document) when its content changes, and is recorded in the raster cache
+ * otherwise.  Safe to call from any thread.
+ *
+ * Returns: (transfer none): Image format or NULL if not recognized
+ */
+GdkPixbufFormat *
+markdown_browser_image_cache_get_file_info (const char *filename, int *width, int *height)
+{
+  GdkPixbufFormat *format;
+  const char *dir;
+  char *hash;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  if (markdown_browser_image_is_svg (filename) && (format = markdown_browser_image_svg_format ())
+      && raster_budget > 0 && (dir = markdown_browser_raster_cache_dir ())
+      && (hash = markdown_browser_raster_cache_source (dir, filename, width, height)))    // ++ alloc hash
+  {
+    g_free (hash);                                      // -- free hash
+    return format;
+  }
+
+  return markdown_browser_image_cache_probe (filename, width, height);
+}
+
+/**
+ * markdown_browser_image_cache_file_exists:
+ * @filename: Image file name, resource URI (resource:///path/image.png) or bundle image
+ *
+ * Check if an image file, resource or bundle image exists.
+ *
+ * Returns: TRUE if it exists
+ */
+gboolean
+markdown_browser_image_cache_file_exists (const char *filename)
+{
+  const char *resource;
+  gboolean exists;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  if ((resource = markdown_browser_image_resource_path (filename)))
+    return g_resources_get_info (resource, G_RESOURCE_LOOKUP_FLAGS_NONE, NULL, NULL, NULL);
+
+  if (markdown_browser_image_is_bundle (filename))
+  {
+    g_mutex_lock (&cache_mutex);
+    exists = data_table && g_hash_table_contains (data_table, filename);
+    g_mutex_unlock (&cache_mutex);
+
+    return exists;
+  }
+
+  return g_file_test (filename, G_FILE_TEST_IS_REGULAR);
+}
+
+/**
+ * markdown_browser_image_cache_add_data:
+ * @filename: Bundle image file name (starting with MARKDOWN_BROWSER_BUNDLE_PREFIX)
+ * @data: Image file data, a reference is added
+ *
+ * Register the file data of a help bundle image, so it can be loaded by its file name like
+ * image files.  Registrations are process wide and kept for the life of the process, like
+ * registered GResources.  Safe to call from any thread.
+ */
+void
+markdown_browser_image_cache_add_data (const char *filename, GBytes *data)
+{
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (markdown_browser_image_is_bundle (filename));
+  g_return_if_fail (data != NULL);
+
+  g_mutex_lock (&cache_mutex);
+
+  if (!data_table)
+    data_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+
+  g_hash_table_replace (data_table, g_strdup (filename), g_bytes_ref (data));  // ++ alloc file name, ++ ref data
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+// Get the raster cache directory, created on first use (NULL if it could not be created)
+static const char *
+markdown_browser_raster_cache_dir (void)
+{
+  static gsize initialized = 0;
+  static char *dir = NULL;
+
+  if (g_once_init_enter (&initialized))
+  {
+    dir = g_build_filename (g_get_user_cache_dir (), "markdown-browser", "raster", NULL);       // ++ alloc (never freed)
+
+    if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      g_warning ("Failed to create image raster cache directory '%s'", dir);
+      g_clear_pointer (&dir, g_free);
+    }
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return dir;
+}
+
+// Remove the cached rasters of a content hash
+static void
+markdown_browser_raster_cache_remove (const char *dir, const char *hash)
+{
+  const char *name;
+  char *path;
+  GDir *gdir;
+  int len;
+
+  if (!(gdir = g_dir_open (dir, 0, NULL)))              // ++ open directory
+    return;
+
+  len = strlen (hash);
+
+  while ((name = g_dir_read_name (gdir)))
+  {
+    if (strncmp (name, hash, len) == 0 && name[len] == '-')
+    {
+      path = g_build_filename (dir, name, NULL);        // ++ alloc path
+      g_unlink (path);
+      g_free (path);                                    // -- free path
+    }
+  }
+
+  g_dir_close (gdir);                                   // -- close directory
+}
+
+// Get the content hash and natural size of a scalable image from the source record of its file name (NULL if the
+// image can't be read or recognized).  A file with the recorded size and modification time is not read.  Otherwise the
+// content is hashed, and only if it changed is the image probed for its size (parsing it) and the rasters of its
+// previous content removed.
+static char *
+markdown_browser_raster_cache_source (const char *dir, const char *filename, int *width, int *height)  // ++ alloc hash
+{
+  MarkdownBrowserRasterSource *source = NULL, newSource;
+  char *hash = NULL, *oldHash, *sourceKey, *sourcePath, *data = NULL;
+  gboolean isFile;
+  GStatBuf statBuf;
+  GBytes *content;
+  int size[2];
+  gsize len;
+
+  isFile = !g_str_has_prefix (filename, MARKDOWN_BROWSER_RESOURCE_PREFIX) && !markdown_browser_image_is_bundle (filename);
+
+  memset (&newSource, 0, sizeof (MarkdownBrowserRasterSource));
+  memcpy (newSource.magic, RASTER_SOURCE_MAGIC, sizeof (newSource.magic));
+
+  if (isFile)
+  {
+    if (g_stat (filename, &statBuf) != 0)
+      return NULL;
+
+    newSource.size = statBuf.st_size;
+
+    // A file modified within the last second could change again without changing its modification time
+    if (statBuf.st_mtime < g_get_real_time () / G_USEC_PER_SEC - 1)
+      newSource.mtime = statBuf.st_mtime;
+  }
+
+  sourceKey = g_compute_checksum_for_string (G_CHECKSUM_SHA256, filename, -1);  // ++ alloc source key
+  sourcePath = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.source", dir, sourceKey);   // ++ alloc source path
+  g_free (sourceKey);                                   // -- free source key
+
+  if (g_file_get_contents (sourcePath, &data, &len, NULL)              // ++ alloc data
+      && len == sizeof (MarkdownBrowserRasterSource) && memcmp (data, RASTER_SOURCE_MAGIC, 8) == 0)
+    source = (MarkdownBrowserRasterSource *)data;
+
+  if (source && source->mtime != 0 && source->mtime == newSource.mtime && source->size == newSource.size)
+    newSource = *source;        // Unchanged file, nothing to read
+  else if ((content = markdown_browser_image_cache_read (filename)))  // ++ new content bytes
+  {
+    hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, content);  // ++ alloc hash
+    newSource.size = g_bytes_get_size (content);
+    memcpy (newSource.hash, hash, RASTER_HASH_LEN);
+    g_bytes_unref (content);                            // -- unref content
+    g_clear_pointer (&hash, g_free);                    // -- free hash
+
+    if (source && memcmp (source->hash, newSource.hash, RASTER_HASH_LEN) == 0)    // Touched but unchanged?
+    {
+      newSource.width = source->width;
+      newSource.height = source->height;
+    }
+    else if (markdown_browser_image_cache_probe (filename, &size[0], &size[1]))
+    {
+      if (source)               // Source file changed, remove the rasters of its previous content
+      {
+        oldHash = g_strndup (source->hash, RASTER_HASH_LEN);           // ++ alloc old hash
+        markdown_browser_raster_cache_remove (dir, oldHash);
+        g_free (oldHash);                               // -- free old hash
+      }
+
+      newSource.width = size[0];
+      newSource.height = size[1];
+    }
+    else newSource.size = -1;   // Not a recognized image
+
+    if (newSource.size >= 0 && (!source || memcmp (source, &newSource, sizeof (MarkdownBrowserRasterSource)) != 0))
+      g_file_set_contents (sourcePath, (const char *)&newSource, sizeof (MarkdownBrowserRasterSource), NULL);
+  }
+  else newSource.size = -1;     // Not readable
+
+  if (newSource.size >= 0)
+  {
+    hash = g_strndup (newSource.hash, RASTER_HASH_LEN); // ++ alloc hash
+    if (width) *width = newSource.width;
+    if (height) *height = newSource.height;
+  }
+
+  g_free (data);                                        // -- free data
+  g_free (sourcePath);                                  // -- free source path
+
+  return hash;
+}
+
+// Load a cached raster by memory mapping it (the pixbuf references the mapping)
+static GdkPixbuf *
+markdown_browser_raster_cache_load (const char *path)
+{
+  const MarkdownBrowserRasterHeader *header;
+  GMappedFile *mapped;
+  GdkPixbuf *pixbuf = NULL;
+  GBytes *bytes, *pixels;
+  gsize size, needed;
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, NULL)))       // ++ new mapped file
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);             // ++ new bytes (refs mapped file)
+  g_mapped_file_unref (mapped);                         // -- unref mapped file
+
+  header = g_bytes_get_data (bytes, &size);
+
+  if (size >= sizeof (MarkdownBrowserRasterHeader)
+      && memcmp (header->magic, RASTER_CACHE_MAGIC, sizeof (header->magic)) == 0
+      && header->width > 0 && header->height > 0)
+  {
+    needed = (gsize)header->rowstride * (header->height - 1) + header->width * (header->hasAlpha ? 4 : 3);
+
+    if (size - sizeof (MarkdownBrowserRasterHeader) >= needed)
+    {
+      pixels = g_bytes_new_from_bytes (bytes, sizeof (MarkdownBrowserRasterHeader),       // ++ new bytes
+                                       size - sizeof (MarkdownBrowserRasterHeader));
+      pixbuf = gdk_pixbuf_new_from_bytes (pixels, GDK_COLORSPACE_RGB, header->hasAlpha, 8,       // ++ new pixbuf
+                                          header->width, header->height, header->rowstride);
+      g_bytes_unref (pixels);                           // -- unref pixel bytes
+    }
+  }
+
+  g_bytes_unref (bytes);                                // -- unref bytes
+
+  return pixbuf;
+}
+
+static int
+markdown_browser_raster_cache_file_sort (gconstpointer a, gconstpointer b)
+{
+  const MarkdownBrowserRasterFile *afile = a, *bfile = b;
+  return afile->mtime < bfile->mtime ? -1 : afile->mtime > bfile->mtime;
+}
+
+// Remove least recently used rasters until they fit in size bytes and update raster_bytes (raster_mutex must be
+// locked).  Source records are small and only written when an image changes, so they are kept.
+static void
+markdown_browser_raster_cache_evict (const char *dir, gsize size)
+{
+  MarkdownBrowserRasterFile *file;
+  GStatBuf statBuf;
+  const char *name;
+  GArray *files;
+  gint64 total = 0;
+  GDir *gdir;
+  guint i;
+
+  if (!(gdir = g_dir_open (dir, 0, NULL)))              // ++ open directory
+    return;
+
+  files = g_array_new (FALSE, FALSE, sizeof (MarkdownBrowserRasterFile));      // ++ new array
+
+  while ((name = g_dir_read_name (gdir)))
+  {
+    if (!g_str_has_suffix (name, ".raw"))
+      continue;                 // Source record or temporary file of a write in progress
+
+    g_array_set_size (files, files->len + 1);
+    file = &g_array_index (files, MarkdownBrowserRasterFile, files->len - 1);
+    file->path = g_build_filename (dir, name, NULL);    // ++ alloc path
+
+    if (g_stat (file->path, &statBuf) == 0)
+    {
+      file->mtime = statBuf.st_mtime;
+      file->size = statBuf.st_size;
+      total += file->size;
+    }
+    else file->mtime = file->size = 0;
+  }
+
+  g_dir_close (gdir);                                   // -- close directory
+
+  if (total > size)
+  {
+    g_array_sort (files, markdown_browser_raster_cache_file_sort);
+
+    for (i = 0; i < files->len && total > size; i++)
+    {
+      file = &g_array_index (files, MarkdownBrowserRasterFile, i);
+
+      if (g_unlink (file->path) == 0)
+        total -= file->size;
+    }
+  }
+
+  for (i = 0; i < files->len; i++)
+    g_free (g_array_index (files, MarkdownBrowserRasterFile, i).path);        // -- free path
+
+  g_array_free (files, TRUE);                           // -- free array
+
+  raster_bytes = total;
+}
+
+// Save a raster to the cache and evict rasters if the budget is exceeded (down to 3/4 of it, so the directory is not
+// scanned on every save)
+static void
+markdown_browser_raster_cache_save (const char *dir, const char *path, GdkPixbuf *pixbuf)
+{
+  MarkdownBrowserRasterHeader *header;
+  gsize len;
+  char *data;
+
+  if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB || gdk_pixbuf_get_bits_per_sample (pixbuf) != 8)
+    return;
+
+  len = gdk_pixbuf_get_byte_length (pixbuf);
+  data = g_malloc (sizeof (MarkdownBrowserRasterHeader) + len);       // ++ alloc file data
+
+  header = (MarkdownBrowserRasterHeader *)data;
+  memcpy (header->magic, RASTER_CACHE_MAGIC, sizeof (header->magic));
+  header->width = gdk_pixbuf_get_width (pixbuf);
+  header->height = gdk_pixbuf_get_height (pixbuf);
+  header->rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  header->hasAlpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  memcpy (data + sizeof (MarkdownBrowserRasterHeader), gdk_pixbuf_read_pixels (pixbuf), len);
+
+  // Written to a temporary file and renamed, so concurrent readers never see a partial file
+  if (g_file_set_contents (path, data, sizeof (MarkdownBrowserRasterHeader) + len, NULL))
+  {
+    g_mutex_lock (&raster_mutex);
+
+    if (raster_bytes < 0)       // Size of rasters saved by earlier runs is not known yet
+      markdown_browser_raster_cache_evict (dir, raster_budget);
+    else raster_bytes += sizeof (MarkdownBrowserRasterHeader) + len;  // Removed rasters are corrected by the next scan
+
+    if (raster_bytes > raster_budget)
+      markdown_browser_raster_cache_evict (dir, raster_budget / 4 * 3);
+
+    g_mutex_unlock (&raster_mutex);
+  }
+
+  g_free (data);                                        // -- free file data
+}
+
+// Decode an image file, resource or bundle image at natural size or scaled, preserving the aspect ratio
+static GdkPixbuf *
+markdown_browser_image_cache_decode_file (const char *filename, int width, int height, GError **error)
+{
+  GInputStream *stream;
+  const char *resource;
+  GdkPixbuf *pixbuf;
+  GBytes *data;
+
+  if ((resource = markdown_browser_image_resource_path (filename)))
+  {
+    if (width > 0 || height > 0)
+      return gdk_pixbuf_new_from_resource_at_scale (resource, width, height, TRUE, error);     // ++ new pixbuf
+
+    return gdk_pixbuf_new_from_resource (resource, error);                     // ++ new pixbuf
+  }
+
+  if (markdown_browser_image_is_bundle (filename))
+  {
+    if (!(data = markdown_browser_image_cache_lookup_data (filename)))        // ++ ref data
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Bundle image '%s' not found", filename);
+      return NULL;
+    }
+
+    stream = g_memory_input_stream_new_from_bytes (data);                      // ++ new stream
+
+    if (width > 0 || height > 0)
+      pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream, width, height, TRUE, NULL, error);       // ++ new pixbuf
+    else pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, error);           // ++ new pixbuf
+
+    g_object_unref (stream);                                                    // -- unref stream
+    g_bytes_unref (data);                                                       // -- unref data
+
+    return pixbuf;
+  }
+
+  if (width > 0 || height > 0)
+    return gdk_pixbuf_new_from_file_at_scale (filename, width, height, TRUE, error);   // ++ new pixbuf
+
+  return gdk_pixbuf_new_from_file (filename, error);                            // ++ new pixbuf
+}
+
+// Decode an image file, rasters of scalable images are loaded from or saved to the on-disk raster cache
+static GdkPixbuf *
+markdown_browser_image_cache_decode (const char *filename, int width, int height, GError **error)
+{
+  GdkPixbuf *pixbuf;
+  char *hash, *path = NULL;
+  const char *dir;
+
+  // A hit only reads the source record (if the file is unchanged) and maps the raster, the image is not parsed
+  if (markdown_browser_image_is_svg (filename) && raster_budget > 0 && (dir = markdown_browser_raster_cache_dir ())
+      && (hash = markdown_browser_raster_cache_source (dir, filename, NULL, NULL)))   // ++ alloc hash
+  {
+    path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s-%dx%d.raw", dir, hash, width, height);  // ++ alloc path
+    g_free (hash);                                      // -- free hash
+
+    if ((pixbuf = markdown_browser_raster_cache_load (path)))      // ++ new pixbuf
+    {
+      g_utime (path, NULL);     // Most recently used, for eviction
+      g_free (path);                                    // -- free path
+      g_mutex_lock (&cache_mutex);
+      raster_hits++;
+      g_mutex_unlock (&cache_mutex);
+      return pixbuf;
+    }
+
+    g_mutex_lock (&cache_mutex);
+    raster_misses++;
+    g_mutex_unlock (&cache_mutex);
+  }
+
+  pixbuf = markdown_browser_image_cache_decode_file (filename, width, height, error);  // ++ new pixbuf
+
+  if (pixbuf && path)
+    markdown_browser_raster_cache_save (dir, path, pixbuf);
+
+  g_free (path);                                        // -- free path
+
+  return pixbuf;
+}
+
+/**
+ * markdown_browser_image_cache_load:
+ * @filename: Image file name
+ * @width: Width to scale the image to or -1 for natural size
+ * @height: Height to scale the image to or -1 for natural size (aspect ratio is preserved)
+ * @error: Location to store error or NULL
+ *
+ * Get an image from the process wide image cache, decoding and caching it on a miss.
+ * The returned pixbuf is shared and must not be modified.  Safe to call from any thread.
+ *
+ * Returns: New reference to the image or NULL on error
+ */
+GdkPixbuf *
+markdown_browser_image_cache_load (const char *filename, int width, int height, GError **error)
+{
+  GdkPixbuf *pixbuf;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  if ((pixbuf = markdown_browser_image_cache_lookup (filename, width, height)))        // ++ ref pixbuf
+    return pixbuf;
+
+  // Decode without holding the lock, another thread might decode the same image concurrently, which is harmless
+  if ((pixbuf = markdown_browser_image_cache_decode (filename, width, height, error)))  // ++ new pixbuf
+    markdown_browser_image_cache_add (filename, width, height, pixbuf);
+
+  return pixbuf;
+}
+
+// Decode an animation of a help bundle
+static GdkPixbufAnimation *
+markdown_browser_image_cache_decode_bundle_animation (const char *filename, GError **error)   // ++ new animation
+{
+  GdkPixbufAnimation *animation;
+  GInputStream *stream;
+  GBytes *data;
+
+  if (!(data = markdown_browser_image_cache_lookup_data (filename)))          // ++ ref data
+  {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "Bundle image '%s' not found", filename);
+    return NULL;
+  }
+
+  stream = g_memory_input_stream_new_from_bytes (data);                        // ++ new stream
+  animation = gdk_pixbuf_animation_new_from_stream (stream, NULL, error);      // ++ new animation
+  g_object_unref (stream);                                                      // -- unref stream
+  g_bytes_unref (data);                                                         // -- unref data
+
+  return animation;
+}
+
+static void
+markdown_browser_image_cache_task_free (MarkdownBrowserImageCacheTask *data)
+{
+  g_free (data->filename);
+  g_slice_free (MarkdownBrowserImageCacheTask, data);
+}
+
+// Image decode worker thread
+static void
+markdown_browser_image_cache_thread (GTask *task, gpointer source_object, gpointer task_data,
+                                     GCancellable *cancellable)
+{
+  MarkdownBrowserImageCacheTask *data = task_data;
+  GdkPixbufAnimation *animation;
+  GdkPixbuf *pixbuf;
+  GError *err = NULL;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (data->width == 0)         // Animation?
+  {
+    if (markdown_browser_image_resource_path (data->filename))
+      animation = gdk_pixbuf_animation_new_from_resource (markdown_browser_image_resource_path (data->filename),
+                                                          &err);        // ++ new animation
+    else if (markdown_browser_image_is_bundle (data->filename))
+      animation = markdown_browser_image_cache_decode_bundle_animation (data->filename, &err);        // ++ new animation
+    else animation = gdk_pixbuf_animation_new_from_file (data->filename, &err);       // ++ new animation
+
+    if (animation)
+    { // Frame count is not known, the static image size is used as an approximation
+      markdown_browser_image_cache_add_object (data->filename, 0, 0, G_OBJECT (animation),
+                                               gdk_pixbuf_get_byte_length (gdk_pixbuf_animation_get_static_image (animation)));
+      g_task_return_pointer (task, animation, g_object_unref);        // !! takes over animation
+    }
+    else g_task_return_error (task, err);                             // !! takes over error
+  }
+  else if ((pixbuf = markdown_browser_image_cache_decode (data->filename, data->width, data->height, &err)))
+  {
+    markdown_browser_image_cache_add (data->filename, data->width, data->height, pixbuf);
+    g_task_return_pointer (task, pixbuf, g_object_unref);     // !! takes over pixbuf
+  }
+  else g_task_return_error (task, err);                       // !! takes over error
+}
+
+/**
+ * markdown_browser_image_cache_decode_async:
+ * @filename: Image file name
+ * @width: Width to scale the image to or -1 for natural size
+ * @height: Height to scale the image to or -1 for natural size (aspect ratio is preserved)
+ * @cancellable: Cancellable or NULL
+ * @callback: Callback to call when the image is decoded
+ * @user_data: User data to pass to @callback
+ *
+ * Decode an image in a worker thread and add it to the process wide image cache.  The
+ * cache is not checked first, use markdown_browser_image_cache_lookup() for that.
+ * Rasters of scalable images come from the on-disk raster cache if possible.
+ */
+void
+markdown_browser_image_cache_decode_async (const char *filename, int width, int height, GCancellable *cancellable,
+                                           GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (width != 0 && height != 0);
+
+  markdown_browser_image_cache_run_task (filename, width, height, cancellable, callback, user_data);
+}
+
+/**
+ * markdown_browser_image_cache_decode_animation_async:
+ * @filename: Animated image file name
+ * @cancellable: Cancellable or NULL
+ * @callback: Callback to call when the animation is decoded
+ * @user_data: User data to pass to @callback
+ *
+ * Decode an animation in a worker thread and add it to the process wide image cache.  The
+ * cache is not checked first, use markdown_browser_image_cache_lookup_animation() for that.
+ */
+void
+markdown_browser_image_cache_decode_animation_async (const char *filename, GCancellable *cancellable,
+                                                     GAsyncReadyCallback callback, gpointer user_data)
+{
+  g_return_if_fail (filename != NULL);
+
+  markdown_browser_image_cache_run_task (filename, 0, 0, cancellable, callback, user_data);
+}
+
+/**
+ * markdown_browser_image_cache_decode_animation_finish:
+ * @result: Async result passed to the callback
+ * @error: Location to store error or NULL
+ *
+ * Get the result of markdown_browser_image_cache_decode_animation_async().
+ *
+ * Returns: New reference to the shared animation or NULL on error
+ */
+GdkPixbufAnimation *
+markdown_browser_image_cache_decode_animation_finish (GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+// Start a decode task (size of 0 for an animation)
+static void
+markdown_browser_image_cache_run_task (const char *filename, int width, int height, GCancellable *cancellable,
+                                       GAsyncReadyCallback callback, gpointer user_data)
+{
+  MarkdownBrowserImageCacheTask *data;
+  GTask *task;
+
+  data = g_slice_new (MarkdownBrowserImageCacheTask);
+  data->filename = g_strdup (filename);
+  data->width = width;
+  data->height = height;
+
+  task = g_task_new (NULL, cancellable, callback, user_data);         // ++ new task
+  g_task_set_source_tag (task, markdown_browser_image_cache_run_task);
+  g_task_set_task_data (task, data, (GDestroyNotify)markdown_browser_image_cache_task_free);
+  g_task_run_in_thread (task, markdown_browser_image_cache_thread);
+  g_object_unref (task);                                // -- unref task (thread holds a ref)
+}
+
+/**
+ * markdown_browser_image_cache_decode_finish:
+ * @result: Async result passed to the callback
+ * @error: Location to store error or NULL
+ *
+ * Get the result of markdown_browser_image_cache_decode_async().
+ *
+ * Returns: New reference to the shared image (must not be modified) or NULL on error
+ */
+GdkPixbuf *
+markdown_browser_image_cache_decode_finish (GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * markdown_browser_image_cache_set_budget:
+ * @budget: Maximum bytes of decoded pixel data to cache (0 disables caching)
+ *
+ * Set the size of the process wide image cache, evicting images if it is now exceeded.
+ */
+void
+markdown_browser_image_cache_set_budget (gsize budget)
+{
+  g_mutex_lock (&cache_mutex);
+  cache_budget = budget;
+  markdown_browser_image_cache_evict (budget);
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_image_cache_get_budget:
+ *
+ * Get the size of the process wide image cache.
+ *
+ * Returns: Maximum bytes of decoded pixel data cached
+ */
+gsize
+markdown_browser_image_cache_get_budget (void)
+{
+  return cache_budget;
+}
+
+/**
+ * markdown_browser_image_cache_get_stats:
+ * @hits: Location to store number of lookups which were cached or NULL
+ * @misses: Location to store number of lookups which required decoding or NULL
+ * @count: Location to store number of cached images or NULL
+ * @bytes: Location to store bytes of cached pixel data or NULL
+ *
+ * Get statistics of the process wide image cache, for sizing its budget.
+ */
+void
+markdown_browser_image_cache_get_stats (guint *hits, guint *misses, guint *count, gsize *bytes)
+{
+  g_mutex_lock (&cache_mutex);
+
+  if (hits) *hits = cache_hits;
+  if (misses) *misses = cache_misses;
+  if (count) *count = cache_lru.length;
+  if (bytes) *bytes = cache_bytes;
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_image_cache_get_raster_stats:
+ * @hits: Location to store number of scalable images loaded from the on-disk raster cache or NULL
+ * @misses: Location to store number of scalable images which had to be rasterized or NULL
+ *
+ * Get statistics of the on-disk raster cache of scalable images.
+ */
+void
+markdown_browser_image_cache_get_raster_stats (guint *hits, guint *misses)
+{
+  g_mutex_lock (&cache_mutex);
+
+  if (hits) *hits = raster_hits;
+  if (misses) *misses = raster_misses;
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_image_cache_set_raster_budget:
+ * @budget: Maximum bytes of raster files (0 disables the raster cache)
+ *
+ * Set the size of the on-disk raster cache of scalable images, removing least recently used rasters if it is now
+ * exceeded.
+ */
+void
+markdown_browser_image_cache_set_raster_budget (gsize budget)
+{
+  const char *dir;
+
+  g_mutex_lock (&raster_mutex);
+  raster_budget = budget;
+
+  if ((dir = markdown_browser_raster_cache_dir ()))
+    markdown_browser_raster_cache_evict (dir, budget);
+
+  g_mutex_unlock (&raster_mutex);
+}
+
+/**
+ * markdown_browser_image_cache_get_raster_budget:
+ *
+ * Get the size of the on-disk raster cache of scalable images.
+ *
+ * Returns: Maximum bytes of raster files
+ */
+gsize
+markdown_browser_image_cache_get_raster_budget (void)
+{
+  return raster_budget;
+}
+
+/**
+ * markdown_browser_image_cache_clear:
+ *
+ * Remove all images from the process wide image cache.  Images still in use remain valid.
+ */
+void
+markdown_browser_image_cache_clear (void)
+{
+  g_mutex_lock (&cache_mutex);
+  markdown_browser_image_cache_evict (0);
+  g_mutex_unlock (&cache_mutex);
+}
@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserImageCache.h - Process wide cache of decoded images.
+ */
+#ifndef MARKDOWN_BROWSER_IMAGE_CACHE_H
+#define MARKDOWN_BROWSER_IMAGE_CACHE_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define MARKDOWN_BROWSER_IMAGE_CACHE_DEFAULT_BUDGET     (32 * 1024 * 1024)      // Default cache size in bytes
+#define MARKDOWN_BROWSER_RASTER_CACHE_DEFAULT_BUDGET    (64 * 1024 * 1024)      // Default raster cache size on disk in bytes
+#define MARKDOWN_BROWSER_RESOURCE_PREFIX                "resource://"           // Prefix of image file names which are resources
+#define MARKDOWN_BROWSER_BUNDLE_PREFIX                  "bundle://"             // Prefix of image file names which are in help bundles
+
+GdkPixbuf *markdown_browser_image_cache_lookup (const char *filename, int width, int height);
+void markdown_browser_image_cache_add (const char *filename, int width, int height, GdkPixbuf *pixbuf);
+GdkPixbuf *markdown_browser_image_cache_load (const char *filename, int width, int height, GError **error);
+void markdown_browser_image_cache_decode_async (const char *filename, int width, int height, GCancellable *cancellable,
+                                                GAsyncReadyCallback callback, gpointer user_data);
+GdkPixbuf *markdown_browser_image_cache_decode_finish (GAsyncResult *result, GError **error);
+GdkPixbufAnimation *markdown_browser_image_cache_lookup_animation (const char *filename);
+void markdown_browser_image_cache_decode_animation_async (const char *filename, GCancellable *cancellable,
+                                                          GAsyncReadyCallback callback, gpointer user_data);
+GdkPixbufAnimation *markdown_browser_image_cache_decode_animation_finish (GAsyncResult *result, GError **error);
+GdkPixbufFormat *markdown_browser_image_cache_get_file_info (const char *filename, int *width, int *height);
+gboolean markdown_browser_image_cache_file_exists (const char *filename);
+void markdown_browser_image_cache_add_data (const char *filename, GBytes *data);
+void markdown_browser_image_cache_set_budget (gsize budget);
+gsize markdown_browser_image_cache_get_budget (void);
+void markdown_browser_image_cache_get_stats (guint *hits, guint *misses, guint *count, gsize *bytes);
+void markdown_browser_image_cache_get_raster_stats (guint *hits, guint *misses);
+void markdown_browser_image_cache_set_raster_budget (gsize budget);
+gsize markdown_browser_image_cache_get_raster_budget (void);
+void markdown_browser_image_cache_clear (void);
+
+#endif
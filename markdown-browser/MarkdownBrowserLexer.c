@@ -0,0 +1,657 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserLexer.c - Single pass Markdown tokenizer.
+ *
+ * Each token type has a hand written matcher which finds the same match as the
+ * regular expression the renderer originally used (listed in regex_strings[] below),
+ * without backtracking and without allocating.  The lexer keeps the next pending
+ * token of each type, just like the original per-regex GMatchInfo array did, so
+ * the order of emitted tokens is identical.
+ */
+#include <string.h>
+
+#include "MarkdownBrowserLexer.h"
+#include "MarkdownBrowserScan.h"
+
+#define MAX_HEADER_NUMBER       6       // Maximum header number (h6)
+#define MAX_HEADER_SPACES       3       // Maximum spaces at beginning of line before a header
+#define MAX_EMPHASIS_CHARS      3       // Maximum emphasis characters (bold + italic)
+
+#ifdef DEBUG
+
+// Match a string in brackets or parenthesis, including escaped end bracket or parenthesis using Friedl's unrolling-the-loop technique
+#define BRACKET_STR             "\\[([^]\\\\]*(?:\\\\.[^]\\\\]*)*)\\]"
+#define PARENTH_STR             "\\(([^)\\\\]+(?:\\\\.[^)\\\\]*)*)\\)"
+
+// Regular expressions the token matchers are equivalent to, used to verify the lexer in debug builds and by the
+// regex mode of markdown_browser_lexer_init_regex()
+static const char *regex_strings[MARKDOWN_BROWSER_TOKEN_COUNT] =
+{
+  "(?<!\\\\)(\\*{1,3})(?![* ])",  // MARKDOWN_BROWSER_TOKEN_EMPHASIS_START
+  "^ {0,3}(\\#{1,6}) ",         // MARKDOWN_BROWSER_TOKEN_HEADER_START
+  "^( *)\\* ",                  // MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START
+  "^( *)\\d+\\. ",              // MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START
+  "(?<!\\\\)!" BRACKET_STR PARENTH_STR,         // MARKDOWN_BROWSER_TOKEN_IMAGE
+  "(?<![!\\\\])" BRACKET_STR PARENTH_STR,       // MARKDOWN_BROWSER_TOKEN_LINK
+
+  "(?<![\\\\ ])(\\*{1,3})",     // MARKDOWN_BROWSER_TOKEN_EMPHASIS_END
+  "(?=\\R)"                     // MARKDOWN_BROWSER_TOKEN_LINE_END
+};
+
+static gboolean markdown_browser_lexer_find_regex (MarkdownBrowserLexer *lexer, MarkdownBrowserTokenType type, int from,
+                                                   MarkdownBrowserToken *token);
+static void markdown_browser_lexer_verify (MarkdownBrowserLexer *lexer, MarkdownBrowserTokenType type, int from,
+                                           gboolean found, const MarkdownBrowserToken *token);
+#endif
+
+// Get the length of a newline character at a position (any Unicode newline, like PCRE's NEWLINE_ANY), 0 if not a newline
+static inline int
+markdown_browser_lexer_newline_len (const char *s, const char *end)
+{
+  switch ((guchar)*s)
+  {
+    case '\n':
+    case '\r':
+    case '\v':
+    case '\f':
+      return 1;
+    case 0xC2:          // NEL (U+0085)
+      return (s + 1 < end && (guchar)s[1] == 0x85) ? 2 : 0;
+    case 0xE2:          // LS (U+2028) and PS (U+2029)
+      return (s + 2 < end && (guchar)s[1] == 0x80 && ((guchar)s[2] == 0xA8 || (guchar)s[2] == 0xA9)) ? 3 : 0;
+    default:
+      return 0;
+  }
+}
+
+// First bytes of all newline characters (see markdown_browser_lexer_newline_len())
+static const char newline_first_bytes[] = { '\n', '\r', '\v', '\f', (char)0xC2, (char)0xE2 };
+
+// Find the next newline character at or after a position, returns -1 if none.  Stores the newline length in nlLen.
+static int
+markdown_browser_lexer_find_newline (MarkdownBrowserLexer *lexer, int pos, int *nlLen)
+{
+  const char *content = lexer->content, *end = content + lexer->len, *s;
+  int nl;
+
+  for (s = content + pos; (s = markdown_browser_scan_chars (s, end, newline_first_bytes,
+                                                            sizeof (newline_first_bytes))); s++)
+  { // Lead bytes of other UTF-8 characters also match
+    if ((nl = markdown_browser_lexer_newline_len (s, end)))
+    {
+      *nlLen = nl;
+      return s - content;
+    }
+  }
+
+  return -1;
+}
+
+// Check if a position is at the start of a line (multiline '^' assertion)
+static inline gboolean
+markdown_browser_lexer_is_line_start (MarkdownBrowserLexer *lexer, int pos)
+{
+  const guchar *s = (const guchar *)lexer->content;
+
+  if (pos == 0)
+    return TRUE;
+
+  if (pos >= lexer->len)
+    return FALSE;
+
+  switch (s[pos - 1])
+  {
+    case '\n':
+    case '\r':
+    case '\v':
+    case '\f':
+      return TRUE;
+    case 0x85:
+      return pos >= 2 && s[pos - 2] == 0xC2;
+    case 0xA8:
+    case 0xA9:
+      return pos >= 3 && s[pos - 3] == 0xE2 && s[pos - 2] == 0x80;
+    default:
+      return FALSE;
+  }
+}
+
+// Find the next start of line at or after a position, returns -1 if none
+static int
+markdown_browser_lexer_next_line_start (MarkdownBrowserLexer *lexer, int pos)
+{
+  int nl;
+
+  if (markdown_browser_lexer_is_line_start (lexer, pos))
+    return pos;
+
+  if ((pos = markdown_browser_lexer_find_newline (lexer, pos, &nl)) == -1)
+    return -1;
+
+  return pos + nl < lexer->len ? pos + nl : -1;
+}
+
+// Find the next occurrence of a character at or after a position, returns -1 if none
+static inline int
+markdown_browser_lexer_find_char (MarkdownBrowserLexer *lexer, int pos, char c)
+{
+  const char *s;
+
+  if (pos >= lexer->len)
+    return -1;
+
+  s = memchr (lexer->content + pos, c, lexer->len - pos);
+  return s ? s - lexer->content : -1;
+}
+
+/* Scan a bracket or parenthesis string, with backslash escapes, starting at the open character.
+ * Returns position of close character or -1 if not terminated.  A scan starting at a later open
+ * character, which is inside the last scanned string, always ends at the same position (the escape
+ * pairs are in sync), so the last result is re-used.  This keeps long runs of unmatched brackets linear. */
+static int
+markdown_browser_lexer_scan_string (MarkdownBrowserLexer *lexer, MarkdownBrowserLexerScan *scan,
+                                    int open, char closeChar)
+{
+  const char *content = lexer->content, *end = content + lexer->len, *s;
+  const char chars[2] = { closeChar, '\\' };
+  int pos;
+
+  if (open > scan->open && open < scan->end)
+    return scan->close;
+
+  for (s = content + open + 1; (s = markdown_browser_scan_chars (s, end, chars, 2)); s += 2)
+  {
+    if (*s == closeChar)
+      break;
+
+    // Escape character must be followed by any character except newline
+    if (s + 1 >= end || markdown_browser_lexer_newline_len (s + 1, end))
+      break;
+  }
+
+  pos = s ? s - content : lexer->len;
+
+  scan->open = open;
+  scan->end = pos;
+  scan->close = (pos < lexer->len && content[pos] == closeChar) ? pos : -1;
+
+  return scan->close;
+}
+
+// Match bracketed text and a parenthesis string following it, starting at bracket position
+static gboolean
+markdown_browser_lexer_match_link (MarkdownBrowserLexer *lexer, MarkdownBrowserLexerScan *bracket,
+                                   MarkdownBrowserLexerScan *parenth, int open, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int close, parenthClose;
+
+  if ((close = markdown_browser_lexer_scan_string (lexer, bracket, open, ']')) == -1)
+    return FALSE;
+
+  // Parenthesis string must contain at least one character, which is not an escape
+  if (close + 2 >= lexer->len || content[close + 1] != '(' || content[close + 2] == ')' || content[close + 2] == '\\')
+    return FALSE;
+
+  if ((parenthClose = markdown_browser_lexer_scan_string (lexer, parenth, close + 1, ')')) == -1)
+    return FALSE;
+
+  token->end = parenthClose + 1;
+  token->argStart = open + 1;
+  token->argEnd = close;
+  token->arg2Start = close + 2;
+  token->arg2End = parenthClose;
+
+  return TRUE;
+}
+
+// Emphasis start: "(?<!\\)(\*{1,3})(?![* ])"
+static gboolean
+markdown_browser_lexer_find_emphasis_start (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int pos, runEnd, start;
+
+  for (pos = from; (pos = markdown_browser_lexer_find_char (lexer, pos, '*')) != -1; pos = runEnd)
+  {
+    for (runEnd = pos + 1; runEnd < lexer->len && content[runEnd] == '*'; runEnd++);
+
+    // Emphasis characters can't be followed by a space
+    if (runEnd < lexer->len && content[runEnd] == ' ')
+      continue;
+
+    // Only the last 1-3 characters of a run of asterisks match (can't be followed by an asterisk)
+    if (runEnd - pos > MAX_EMPHASIS_CHARS)
+      start = runEnd - MAX_EMPHASIS_CHARS;
+    else if (pos > 0 && content[pos - 1] == '\\')       // Escaped asterisk?
+    {
+      if (pos + 1 == runEnd)
+        continue;
+
+      start = pos + 1;
+    }
+    else start = pos;
+
+    token->start = token->argStart = start;
+    token->end = token->argEnd = runEnd;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Emphasis end: "(?<![\\ ])(\*{1,3})"
+static gboolean
+markdown_browser_lexer_find_emphasis_end (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int pos, start, end;
+
+  for (pos = from; (pos = markdown_browser_lexer_find_char (lexer, pos, '*')) != -1; pos++)
+  {
+    if (pos == 0 || (content[pos - 1] != '\\' && content[pos - 1] != ' '))
+      start = pos;
+    else if (pos + 1 < lexer->len && content[pos + 1] == '*')
+      start = pos + 1;
+    else continue;
+
+    for (end = start + 1; end < lexer->len && end - start < MAX_EMPHASIS_CHARS && content[end] == '*'; end++);
+
+    token->start = token->argStart = start;
+    token->end = token->argEnd = end;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+// Header start: "^ {0,3}(\#{1,6}) "
+static gboolean
+markdown_browser_lexer_find_header_start (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int line, hashes, pos;
+
+  for (line = markdown_browser_lexer_next_line_start (lexer, from); line != -1;
+       line = markdown_browser_lexer_next_line_start (lexer, line + 1))
+  {
+    for (hashes = line; hashes < lexer->len && content[hashes] == ' ' && hashes - line < MAX_HEADER_SPACES; hashes++);
+    for (pos = hashes; pos < lexer->len && content[pos] == '#' && pos - hashes <= MAX_HEADER_NUMBER; pos++);
+
+    if (pos > hashes && pos - hashes <= MAX_HEADER_NUMBER && pos < lexer->len && content[pos] == ' ')
+    {
+      token->start = line;
+      token->end = pos + 1;
+      token->argStart = hashes;
+      token->argEnd = pos;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+// Bullet list item start: "^( *)\* " or numeric list item start: "^( *)\d+\. "
+static gboolean
+markdown_browser_lexer_find_item_start (MarkdownBrowserLexer *lexer, int from, gboolean numeric,
+                                        MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int line, spaces, pos;
+  gunichar c;
+
+  for (line = markdown_browser_lexer_next_line_start (lexer, from); line != -1;
+       line = markdown_browser_lexer_next_line_start (lexer, line + 1))
+  {
+    for (spaces = line; spaces < lexer->len && content[spaces] == ' '; spaces++);
+
+    pos = spaces;
+
+    if (numeric)
+    { // Match decimal digits, including non-ASCII digits like PCRE's \d does with Unicode properties
+      while (pos < lexer->len)
+      {
+        if (g_ascii_isdigit (content[pos]))
+          pos++;
+        else if ((guchar)content[pos] >= 0x80
+                 && (c = g_utf8_get_char_validated (content + pos, lexer->len - pos)) < (gunichar)-2
+                 && g_unichar_isdigit (c))
+          pos = g_utf8_next_char (content + pos) - content;
+        else break;
+      }
+
+      if (pos == spaces || pos >= lexer->len || content[pos] != '.')
+        continue;
+    }
+    else if (pos >= lexer->len || content[pos] != '*')
+      continue;
+
+    if (pos + 1 < lexer->len && content[pos + 1] == ' ')
+    {
+      token->start = line;
+      token->end = pos + 2;
+      token->argStart = line;
+      token->argEnd = spaces;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+// Image: "(?<!\\)!" BRACKET_STR PARENTH_STR
+static gboolean
+markdown_browser_lexer_find_image (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int pos;
+
+  for (pos = from; (pos = markdown_browser_lexer_find_char (lexer, pos, '!')) != -1; pos++)
+  {
+    if ((pos > 0 && content[pos - 1] == '\\') || pos + 1 >= lexer->len || content[pos + 1] != '[')
+      continue;
+
+    if (markdown_browser_lexer_match_link (lexer, &lexer->imageBracket, &lexer->imageParenth, pos + 1, token))
+    {
+      token->start = pos;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+// Link: "(?<![!\\])" BRACKET_STR PARENTH_STR
+static gboolean
+markdown_browser_lexer_find_link (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  const char *content = lexer->content;
+  int pos;
+
+  for (pos = from; (pos = markdown_browser_lexer_find_char (lexer, pos, '[')) != -1; pos++)
+  {
+    if (pos > 0 && (content[pos - 1] == '!' || content[pos - 1] == '\\'))
+      continue;
+
+    if (markdown_browser_lexer_match_link (lexer, &lexer->linkBracket, &lexer->linkParenth, pos, token))
+    {
+      token->start = pos;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+// Header or list item end: "(?=\R)"
+static gboolean
+markdown_browser_lexer_find_line_end (MarkdownBrowserLexer *lexer, int from, MarkdownBrowserToken *token)
+{
+  int pos, nl;
+
+  if (from >= lexer->len || (pos = markdown_browser_lexer_find_newline (lexer, from, &nl)) == -1)
+    return FALSE;
+
+  token->start = token->end = pos;
+  return TRUE;
+}
+
+/* Find the first token of a given type at or after a position.  The first match of a type after a position
+ * does not depend on where the search started, so the last result is re-used if it is still ahead. */
+static gboolean
+markdown_browser_lexer_find (MarkdownBrowserLexer *lexer, MarkdownBrowserTokenType type, int from)
+{
+  MarkdownBrowserLexerMemo *memo = &lexer->memo[type];
+  MarkdownBrowserToken *token = &lexer->next[type];
+  gboolean found;
+
+  if (memo->from != -1 && from >= memo->from && (!memo->found || from <= memo->token.start))
+    found = memo->found;
+  else
+  {
+    memset (&memo->token, 0, sizeof (MarkdownBrowserToken));
+    memo->token.type = type;
+
+#ifdef DEBUG
+    if (lexer->regex)           // Original regular expression scan, for checking the lexer
+      found = markdown_browser_lexer_find_regex (lexer, type, from, &memo->token);
+    else
+#endif
+    switch (type)
+    {
+      case MARKDOWN_BROWSER_TOKEN_EMPHASIS_START:
+        found = markdown_browser_lexer_find_emphasis_start (lexer, from, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_HEADER_START:
+        found = markdown_browser_lexer_find_header_start (lexer, from, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START:
+        found = markdown_browser_lexer_find_item_start (lexer, from, FALSE, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START:
+        found = markdown_browser_lexer_find_item_start (lexer, from, TRUE, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_IMAGE:
+        found = markdown_browser_lexer_find_image (lexer, from, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_LINK:
+        found = markdown_browser_lexer_find_link (lexer, from, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_EMPHASIS_END:
+        found = markdown_browser_lexer_find_emphasis_end (lexer, from, &memo->token);
+        break;
+      case MARKDOWN_BROWSER_TOKEN_LINE_END:
+        found = markdown_browser_lexer_find_line_end (lexer, from, &memo->token);
+        break;
+      default:
+        g_return_val_if_reached (FALSE);
+    }
+
+#ifdef DEBUG
+    if (!lexer->regex)
+      markdown_browser_lexer_verify (lexer, type, from, found, &memo->token);
+#endif
+
+    memo->from = from;
+    memo->found = found;
+  }
+
+  if (found)
+  {
+    *token = memo->token;
+    lexer->nextValid |= 1 << type;
+  }
+  else lexer->nextValid &= ~(1 << type);
+
+  return found;
+}
+
+/**
+ * markdown_browser_lexer_init:
+ * @lexer: Lexer state to initialize
+ * @content: Markdown content to tokenize (must remain valid while @lexer is in use)
+ * @len: Length of @content in bytes or -1 if NUL terminated
+ *
+ * Initialize a Markdown lexer.  No resources are allocated.
+ */
+void
+markdown_browser_lexer_init (MarkdownBrowserLexer *lexer, const char *content, int len)
+{
+  int i;
+
+  memset (lexer, 0, sizeof (MarkdownBrowserLexer));
+
+  lexer->content = content;
+  lexer->len = len == -1 ? strlen (content) : len;
+  lexer->consumed = -1;
+
+  for (i = 0; i < MARKDOWN_BROWSER_TOKEN_COUNT; i++)
+    lexer->memo[i].from = -1;
+
+  lexer->imageBracket.open = lexer->imageParenth.open = -1;
+  lexer->linkBracket.open = lexer->linkParenth.open = -1;
+}
+
+/**
+ * markdown_browser_lexer_next:
+ * @lexer: Markdown lexer
+ * @emphasisOpen: TRUE if bold or italic emphasis is currently active
+ * @lineOpen: TRUE if a header or list item is currently active
+ * @token: Location to store the next token
+ *
+ * Get the next Markdown token.  The content between the lexer position (the end of
+ * the previously returned token) and the start of the returned token is plain text.
+ * END tokens are only searched for if their corresponding START state is active.
+ *
+ * Returns: TRUE if a token was found, FALSE if there are no more tokens
+ *   (any content after the lexer position is plain text)
+ */
+gboolean
+markdown_browser_lexer_next (MarkdownBrowserLexer *lexer, gboolean emphasisOpen, gboolean lineOpen,
+                             MarkdownBrowserToken *token)
+{
+  MarkdownBrowserTokenType type;
+  int nextType = -1;
+
+  if (lexer->consumed == -1)    // First call? - Find first START token of each type
+  {
+    for (type = 0; type < MARKDOWN_BROWSER_TOKEN_FIRST_END; type++)
+      markdown_browser_lexer_find (lexer, type, 0);
+  }
+  else
+  { // Skip the last token (does not include look ahead characters)
+    lexer->pos = lexer->next[lexer->consumed].end;
+    lexer->nextValid &= ~(1 << lexer->consumed);
+
+    if (lexer->pos >= lexer->len)
+      return FALSE;
+
+    // Search for the next token of the same type (END tokens are checked conditionally below)
+    if (lexer->consumed < MARKDOWN_BROWSER_TOKEN_FIRST_END)
+      markdown_browser_lexer_find (lexer, lexer->consumed, lexer->pos);
+
+    // Find next END tokens according to current open states
+    if (emphasisOpen && !(lexer->nextValid & (1 << MARKDOWN_BROWSER_TOKEN_EMPHASIS_END)))
+      markdown_browser_lexer_find (lexer, MARKDOWN_BROWSER_TOKEN_EMPHASIS_END, lexer->pos);
+
+    if (lineOpen && !(lexer->nextValid & (1 << MARKDOWN_BROWSER_TOKEN_LINE_END)))
+      markdown_browser_lexer_find (lexer, MARKDOWN_BROWSER_TOKEN_LINE_END, lexer->pos);
+  }
+
+  // Select the earliest token, lower types have priority for tokens at the same position
+  for (type = 0; type < MARKDOWN_BROWSER_TOKEN_COUNT; type++)
+    if ((lexer->nextValid & (1 << type)) && (nextType == -1 || lexer->next[type].start < lexer->next[nextType].start))
+      nextType = type;
+
+  lexer->consumed = nextType;
+
+  if (nextType == -1)
+    return FALSE;
+
+  *token = lexer->next[nextType];
+  return TRUE;
+}
+
+#ifdef DEBUG
+
+// Find the first match of the regular expression of a token type at or after a position
+static gboolean
+markdown_browser_lexer_find_regex (MarkdownBrowserLexer *lexer, MarkdownBrowserTokenType type, int from,
+                                   MarkdownBrowserToken *token)
+{
+  static GRegex *regexes[MARKDOWN_BROWSER_TOKEN_COUNT];
+  GMatchInfo *matchInfo;
+  GRegex *regex;
+  GError *err = NULL;
+  gboolean found;
+
+  if (!g_atomic_pointer_get (&regexes[type]))  // Documents are parsed in worker threads too
+  {
+    regex = g_regex_new (regex_strings[type], G_REGEX_MULTILINE, 0, &err);     // ++ new regex
+
+    if (!regex)
+      g_error ("Invalid regex '%s': %s", regex_strings[type], err->message);
+
+    if (!g_atomic_pointer_compare_and_exchange (&regexes[type], NULL, regex))
+      g_regex_unref (regex);    // -- unref regex, another thread was first
+  }
+
+  found = g_regex_match_full (regexes[type], lexer->content, lexer->len, from, 0, &matchInfo, NULL);
+
+  if (found)
+  {
+    g_match_info_fetch_pos (matchInfo, 0, &token->start, &token->end);
+
+    if (g_match_info_get_match_count (matchInfo) > 1)
+      g_match_info_fetch_pos (matchInfo, 1, &token->argStart, &token->argEnd);
+
+    if (g_match_info_get_match_count (matchInfo) > 2)
+      g_match_info_fetch_pos (matchInfo, 2, &token->arg2Start, &token->arg2End);
+  }
+
+  g_match_info_free (matchInfo);
+
+  return found;
+}
+
+// Compare a token found by the lexer with the match of the equivalent regular expression and warn on differences
+static void
+markdown_browser_lexer_verify (MarkdownBrowserLexer *lexer, MarkdownBrowserTokenType type, int from,
+                               gboolean found, const MarkdownBrowserToken *token)
+{
+  MarkdownBrowserToken regexToken = { type };
+  gboolean regexFound;
+
+  regexFound = markdown_browser_lexer_find_regex (lexer, type, from, &regexToken);
+
+  if (found != regexFound
+      || (found && (regexToken.start != token->start || regexToken.end != token->end
+                    || (regexToken.argStart != regexToken.argEnd
+                        && (regexToken.argStart != token->argStart || regexToken.argEnd != token->argEnd))
+                    || (regexToken.arg2Start != regexToken.arg2End
+                        && (regexToken.arg2Start != token->arg2Start || regexToken.arg2End != token->arg2End)))))
+    g_warning ("Markdown lexer mismatch for '%s' from position %d: lexer %s %d-%d, regex %s %d-%d",
+               regex_strings[type], from, found ? "found" : "not found", token->start, token->end,
+               regexFound ? "found" : "not found", regexFound ? regexToken.start : -1, regexFound ? regexToken.end : -1);
+}
+
+/**
+ * markdown_browser_lexer_init_regex:
+ * @lexer: Lexer state to initialize
+ * @content: Markdown content to tokenize (must remain valid while @lexer is in use)
+ * @len: Length of @content in bytes or -1 if NUL terminated
+ *
+ * Initialize a Markdown lexer which finds tokens with the regular expressions the renderer originally used,
+ * instead of the single pass matchers.  Only available in debug builds, for checking the lexer against the
+ * original scan.
+ */
+void
+markdown_browser_lexer_init_regex (MarkdownBrowserLexer *lexer, const char *content, int len)
+{
+  markdown_browser_lexer_init (lexer, content, len);
+  lexer->regex = TRUE;
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserLexer.h - Single pass Markdown tokenizer.
+ */
+#ifndef MARKDOWN_BROWSER_LEXER_H
+#define MARKDOWN_BROWSER_LEXER_H
+
+#include <glib.h>
+
+/**
+ * MarkdownBrowserTokenType:
+ * @MARKDOWN_BROWSER_TOKEN_EMPHASIS_START: Emphasis (bold/italic) start
+ * @MARKDOWN_BROWSER_TOKEN_HEADER_START: h1-h6 Markdown header
+ * @MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START: Start of a bullet list item
+ * @MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START: Start of a numeric list item
+ * @MARKDOWN_BROWSER_TOKEN_IMAGE: Image in the form: ![Alt Text](/images/image.jpg)
+ * @MARKDOWN_BROWSER_TOKEN_LINK: Link in the form: [Alt Text](http://link)
+ * @MARKDOWN_BROWSER_TOKEN_EMPHASIS_END: Emphasis end
+ * @MARKDOWN_BROWSER_TOKEN_LINE_END: End of header or list item (zero length)
+ *
+ * Markdown token types.  The order defines the priority of tokens which start at the same position.
+ */
+typedef enum
+{
+  MARKDOWN_BROWSER_TOKEN_EMPHASIS_START,
+  MARKDOWN_BROWSER_TOKEN_HEADER_START,
+  MARKDOWN_BROWSER_TOKEN_BULLET_ITEM_START,
+  MARKDOWN_BROWSER_TOKEN_NUMERIC_ITEM_START,
+  MARKDOWN_BROWSER_TOKEN_IMAGE,
+  MARKDOWN_BROWSER_TOKEN_LINK,
+
+  MARKDOWN_BROWSER_TOKEN_EMPHASIS_END,
+  MARKDOWN_BROWSER_TOKEN_LINE_END,
+
+  MARKDOWN_BROWSER_TOKEN_COUNT
+} MarkdownBrowserTokenType;
+
+// Set to the first END token (only searched for if a START token is active)
+#define MARKDOWN_BROWSER_TOKEN_FIRST_END        MARKDOWN_BROWSER_TOKEN_EMPHASIS_END
+
+/**
+ * MarkdownBrowserToken:
+ * @type: Token type
+ * @start: Start byte position of the token in the content
+ * @end: End byte position of the token in the content (one past the last byte)
+ * @argStart: Start of first argument (emphasis or header characters, list item spaces, image alt or link text)
+ * @argEnd: End of first argument
+ * @arg2Start: Start of second argument (image file name or link URL)
+ * @arg2End: End of second argument
+ *
+ * A Markdown token found by #MarkdownBrowserLexer.
+ */
+typedef struct
+{
+  MarkdownBrowserTokenType type;
+  int start;
+  int end;
+  int argStart;
+  int argEnd;
+  int arg2Start;
+  int arg2End;
+} MarkdownBrowserToken;
+
+// Result of the last search for a token type (so repeated searches don't rescan content)
+typedef struct
+{
+  int from;                     // Position search was started from (-1 if none yet)
+  gboolean found;               // TRUE if token was found
+  MarkdownBrowserToken token;   // The found token
+} MarkdownBrowserLexerMemo;
+
+// Result of the last bracket or parenthesis string scan
+typedef struct
+{
+  int open;                     // Position of open character (-1 if none yet)
+  int end;                      // Position where scan stopped
+  int close;                    // Position of close character or -1 if no match
+} MarkdownBrowserLexerScan;
+
+/**
+ * MarkdownBrowserLexer:
+ *
+ * Markdown lexer state, initialize with markdown_browser_lexer_init().
+ * All fields are private.
+ */
+typedef struct
+{
+  const char *content;          // Markdown content
+  int len;                      // Length of content in bytes
+  int pos;                      // Current content position (end of last token)
+  int consumed;                 // Type of last returned token or -1 if none yet
+
+  guint nextValid;              // Bit mask of valid entries in next[]
+  MarkdownBrowserToken next[MARKDOWN_BROWSER_TOKEN_COUNT];      // Pending next token of each type
+  MarkdownBrowserLexerMemo memo[MARKDOWN_BROWSER_TOKEN_COUNT];  // Last search result of each type
+
+  MarkdownBrowserLexerScan imageBracket;        // Image alt text scan
+  MarkdownBrowserLexerScan imageParenth;        // Image file name scan
+  MarkdownBrowserLexerScan linkBracket;         // Link text scan
+  MarkdownBrowserLexerScan linkParenth;         // Link URL scan
+#ifdef DEBUG
+  gboolean regex;                               // Find tokens with the original regular expressions
+#endif
+} MarkdownBrowserLexer;
+
+void markdown_browser_lexer_init (MarkdownBrowserLexer *lexer, const char *content, int len);
+gboolean markdown_browser_lexer_next (MarkdownBrowserLexer *lexer, gboolean emphasisOpen, gboolean lineOpen,
+                                      MarkdownBrowserToken *token);
+#ifdef DEBUG
+void markdown_browser_lexer_init_regex (MarkdownBrowserLexer *lexer, const char *content, int len);
+#endif
+
+#endif
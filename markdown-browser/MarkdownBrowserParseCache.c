@@ -0,0 +1,540 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserParseCache.c - On-disk cache of parsed topic files.
+ *
+ * Topic files added with markdown_browser_add_files() are cached under
+ * $XDG_CACHE_HOME/markdown-browser/parse, so unchanged files are neither searched for their
+ * title nor parsed again on later starts.  Two kinds of files are kept:
+ *
+ * - <hash of file path>.source records the size, modification time, content hash and title of a
+ *   topic file.  When the size and modification time still match, the title is used without
+ *   reading the file.  Otherwise the record remains valid if the content hash matches.
+ * - <content hash>.parsed holds the spans and text pool of a parsed document, which are memory
+ *   mapped and used directly, the same as help bundles.
+ *
+ * Files are written atomically and begin with a magic and version, so files of other versions
+ * or of hosts with a different byte order are ignored and overwritten.  Least recently used
+ * files are removed once the files exceed the byte budget.
+ */
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "MarkdownBrowserParseCache.h"
+
+#define PARSE_CACHE_SOURCE_MAGIC        "MDBSRC01"      // Source record magic
+#define PARSE_CACHE_PARSED_MAGIC        "MDBPARS1"      // Parsed document magic
+#define PARSE_CACHE_VERSION             1               // Format version, incremented when the format, spans or parser output change
+#define PARSE_CACHE_BYTE_ORDER          0x01020304      // Byte order mark (files use the byte order of the host)
+#define PARSE_CACHE_NO_TITLE            G_MAXUINT32     // Title length when the file has no title
+#define PARSE_CACHE_HASH_LEN            64              // Length of a SHA-256 hex string
+
+// Source record of a topic file, followed by the title (not NUL terminated)
+typedef struct
+{
+  char magic[8];                        // PARSE_CACHE_SOURCE_MAGIC
+  guint32 version;                      // PARSE_CACHE_VERSION
+  guint32 titleLen;                     // Length of the title or PARSE_CACHE_NO_TITLE
+  gint64 size;                          // Size of the file
+  gint64 mtime;                         // Modification time of the file
+  char hash[PARSE_CACHE_HASH_LEN];      // Content hash or all 0 if the file was lazily loaded
+  char titleMatch[PARSE_CACHE_HASH_LEN];        // Hash of the title regular expression
+} MarkdownBrowserParseCacheSource;
+
+// Parsed document header, followed by the spans (aligned to 8 bytes by the header size) and text pool
+typedef struct
+{
+  char magic[8];                        // PARSE_CACHE_PARSED_MAGIC
+  guint32 version;                      // PARSE_CACHE_VERSION
+  guint32 byteOrder;                    // PARSE_CACHE_BYTE_ORDER
+  guint32 spanSize;                     // Size of MarkdownBrowserSpan
+  guint32 spanCount;                    // Number of spans
+  guint32 textLen;                      // Size of the text pool in bytes
+  guint32 reserved;
+} MarkdownBrowserParseCacheHeader;
+
+// A cache file considered for eviction
+typedef struct
+{
+  char *path;
+  gint64 mtime;
+  gint64 size;
+} MarkdownBrowserParseCacheFile;
+
+static GMutex cache_mutex;                      // Guards budget accounting and eviction
+static gsize cache_budget = MARKDOWN_BROWSER_PARSE_CACHE_DEFAULT_BUDGET;
+static gint64 cache_bytes = -1;                 // Size of cache files, -1 until the directory has been scanned
+static guint cache_hits;                        // Parsed document lookup statistics (atomic)
+static guint cache_misses;
+
+static const char *
+markdown_browser_parse_cache_dir (void)
+{
+  static gsize initialized = 0;
+  static char *dir = NULL;
+
+  if (g_once_init_enter (&initialized))
+  {
+    dir = g_build_filename (g_get_user_cache_dir (), "markdown-browser", "parse", NULL);        // ++ alloc (never freed)
+
+    if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      g_warning ("Failed to create parse cache directory '%s'", dir);
+      g_clear_pointer (&dir, g_free);
+    }
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return dir;
+}
+
+// Get the path of the source record of a topic file, the file path is made absolute so it identifies the file
+static char *
+markdown_browser_parse_cache_source_path (const char *dir, const char *path)     // ++ alloc source path
+{
+  char *cwd, *fullpath, *key, *sourcePath;
+
+  if (g_path_is_absolute (path))
+    key = g_compute_checksum_for_string (G_CHECKSUM_SHA256, path, -1);        // ++ alloc key
+  else
+  {
+    cwd = g_get_current_dir ();                         // ++ alloc current directory
+    fullpath = g_build_filename (cwd, path, NULL);      // ++ alloc full path
+    key = g_compute_checksum_for_string (G_CHECKSUM_SHA256, fullpath, -1);     // ++ alloc key
+    g_free (fullpath);                                  // -- free full path
+    g_free (cwd);                                       // -- free current directory
+  }
+
+  sourcePath = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.source", dir, key);        // ++ alloc source path
+  g_free (key);                                         // -- free key
+
+  return sourcePath;
+}
+
+static int
+markdown_browser_parse_cache_file_sort (gconstpointer a, gconstpointer b)
+{
+  const MarkdownBrowserParseCacheFile *afile = a, *bfile = b;
+  return afile->mtime < bfile->mtime ? -1 : afile->mtime > bfile->mtime;
+}
+
+// Remove least recently used cache files until they fit in size bytes and update cache_bytes (mutex must be locked).
+// Lookups of parsed documents update their modification time, source records are only written when a file changes.
+static void
+markdown_browser_parse_cache_evict (const char *dir, gsize size)
+{
+  MarkdownBrowserParseCacheFile *file;
+  GStatBuf statBuf;
+  const char *name;
+  GArray *files;
+  gint64 total = 0;
+  GDir *gdir;
+  guint i;
+
+  if (!(gdir = g_dir_open (dir, 0, NULL)))              // ++ open directory
+    return;
+
+  files = g_array_new (FALSE, FALSE, sizeof (MarkdownBrowserParseCacheFile));  // ++ new array
+
+  while ((name = g_dir_read_name (gdir)))
+  {
+    if (!g_str_has_suffix (name, ".source") && !g_str_has_suffix (name, ".parsed"))
+      continue;                 // Temporary file of a write in progress
+
+    g_array_set_size (files, files->len + 1);
+    file = &g_array_index (files, MarkdownBrowserParseCacheFile, files->len - 1);
+    file->path = g_build_filename (dir, name, NULL);    // ++ alloc path
+
+    if (g_stat (file->path, &statBuf) == 0)
+    {
+      file->mtime = statBuf.st_mtime;
+      file->size = statBuf.st_size;
+      total += file->size;
+    }
+    else file->mtime = file->size = 0;
+  }
+
+  g_dir_close (gdir);                                   // -- close directory
+
+  if (total > size)
+  {
+    g_array_sort (files, markdown_browser_parse_cache_file_sort);
+
+    for (i = 0; i < files->len && total > size; i++)
+    {
+      file = &g_array_index (files, MarkdownBrowserParseCacheFile, i);
+
+      if (g_unlink (file->path) == 0)
+        total -= file->size;
+    }
+  }
+
+  for (i = 0; i < files->len; i++)
+    g_free (g_array_index (files, MarkdownBrowserParseCacheFile, i).path);    // -- free path
+
+  g_array_free (files, TRUE);                           // -- free array
+
+  cache_bytes = total;
+}
+
+// Write a cache file atomically and evict files if the budget is exceeded (down to 3/4 of it, so the directory is not
+// scanned on every write)
+static void
+markdown_browser_parse_cache_write (const char *dir, const char *path, const char *data, gsize len)
+{
+  if (!g_file_set_contents (path, data, len, NULL))
+    return;
+
+  g_mutex_lock (&cache_mutex);
+
+  if (cache_bytes < 0)          // Size of files written by earlier runs is not known yet
+    markdown_browser_parse_cache_evict (dir, cache_budget);
+  else cache_bytes += len;      // Overestimated if a file was replaced, corrected by the next scan
+
+  if (cache_bytes > cache_budget)
+    markdown_browser_parse_cache_evict (dir, cache_budget / 4 * 3);
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_parse_cache_hash:
+ * @content: Topic content
+ * @len: Length of @content or -1 if NUL terminated
+ *
+ * Compute the content hash which identifies a parsed document in the cache.
+ *
+ * Returns: (transfer full): SHA-256 hash as a hex string
+ */
+char *
+markdown_browser_parse_cache_hash (const char *content, gssize len)
+{
+  g_return_val_if_fail (content != NULL, NULL);
+
+  return g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *)content, len >= 0 ? len : strlen (content));
+}
+
+/**
+ * markdown_browser_parse_cache_lookup_source:
+ * @path: Topic file path
+ * @statBuf: Status of the topic file
+ * @titleMatch: Pattern of the regular expression the title is extracted with
+ * @content: Content read from @path or NULL if lazily loaded (not read)
+ * @len: Length of @content or -1 if NUL terminated
+ * @title: (out): Location to store the recorded title (NULL if the file has no title)
+ * @hash: (out) (optional): Location to store the content hash if @content is given (NULL if caching is disabled)
+ *
+ * Look up the record of a topic file, which is valid if the file size and modification time are
+ * unchanged.  If they changed but @content is given, it is valid if the content hash matches and
+ * the record is updated.  Only records with a content hash are used when @content is given, since
+ * the title of a lazily loaded file is only searched for at its start.  Safe to call from any thread.
+ *
+ * Returns: TRUE if the record is valid and @title was set, FALSE otherwise
+ */
+gboolean
+markdown_browser_parse_cache_lookup_source (const char *path, const GStatBuf *statBuf, const char *titleMatch,
+                                            const char *content, gssize len, char **title, char **hash)
+{
+  const MarkdownBrowserParseCacheSource *source;
+  char *sourcePath, *data = NULL, *matchHash, *contentHash = NULL;
+  gboolean valid = FALSE, changed = FALSE;
+  const char *dir;
+  gsize size;
+
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (statBuf != NULL, FALSE);
+  g_return_val_if_fail (titleMatch != NULL, FALSE);
+  g_return_val_if_fail (title != NULL, FALSE);
+
+  *title = NULL;
+  if (hash) *hash = NULL;
+
+  if (cache_budget == 0 || !(dir = markdown_browser_parse_cache_dir ()))
+    return FALSE;
+
+  sourcePath = markdown_browser_parse_cache_source_path (dir, path);   // ++ alloc source path
+
+  if (g_file_get_contents (sourcePath, &data, &size, NULL)             // ++ alloc data
+      && size >= sizeof (MarkdownBrowserParseCacheSource))
+  {
+    source = (const MarkdownBrowserParseCacheSource *)data;
+    matchHash = g_compute_checksum_for_string (G_CHECKSUM_SHA256, titleMatch, -1);    // ++ alloc match hash
+
+    if (memcmp (source->magic, PARSE_CACHE_SOURCE_MAGIC, sizeof (source->magic)) == 0
+        && source->version == PARSE_CACHE_VERSION
+        && memcmp (source->titleMatch, matchHash, PARSE_CACHE_HASH_LEN) == 0
+        && (source->titleLen == PARSE_CACHE_NO_TITLE
+            || source->titleLen <= size - sizeof (MarkdownBrowserParseCacheSource))
+        && (!content || source->hash[0]))
+    {
+      if (source->size == statBuf->st_size && source->mtime == statBuf->st_mtime)
+      {
+        valid = TRUE;
+
+        if (content)
+          contentHash = g_strndup (source->hash, PARSE_CACHE_HASH_LEN);       // ++ alloc content hash
+      }
+      else if (content)         // Touched but possibly unchanged (a checkout or copy for example)
+      {
+        contentHash = markdown_browser_parse_cache_hash (content, len);       // ++ alloc content hash
+        valid = changed = memcmp (source->hash, contentHash, PARSE_CACHE_HASH_LEN) == 0;
+      }
+
+      if (valid && source->titleLen != PARSE_CACHE_NO_TITLE)
+        *title = g_strndup (data + sizeof (MarkdownBrowserParseCacheSource), source->titleLen);        // ++ alloc title
+    }
+
+    g_free (matchHash);                                 // -- free match hash
+  }
+
+  g_free (data);                                        // -- free data
+  g_free (sourcePath);                                  // -- free source path
+
+  if (content && !contentHash)
+    contentHash = markdown_browser_parse_cache_hash (content, len);   // ++ alloc content hash
+
+  if (changed)                  // Record the new size and modification time
+    markdown_browser_parse_cache_save_source (path, statBuf, titleMatch, *title, contentHash);
+
+  if (hash)
+    *hash = contentHash;        // !! caller takes over content hash
+  else g_free (contentHash);    // -- free content hash
+
+  return valid;
+}
+
+/**
+ * markdown_browser_parse_cache_save_source:
+ * @path: Topic file path
+ * @statBuf: Status of the topic file, taken before it was read
+ * @titleMatch: Pattern of the regular expression the title was extracted with
+ * @title: (nullable): Title of the topic file
+ * @hash: (nullable): Content hash or NULL if the file was lazily loaded (not read)
+ *
+ * Record the title and content hash of a topic file.  Safe to call from any thread.
+ */
+void
+markdown_browser_parse_cache_save_source (const char *path, const GStatBuf *statBuf, const char *titleMatch,
+                                          const char *title, const char *hash)
+{
+  MarkdownBrowserParseCacheSource *source;
+  char *sourcePath, *matchHash, *data;
+  const char *dir;
+  gsize titleLen, len;
+
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (statBuf != NULL);
+  g_return_if_fail (titleMatch != NULL);
+
+  if (cache_budget == 0 || !(dir = markdown_browser_parse_cache_dir ()))
+    return;
+
+  titleLen = title ? strlen (title) : 0;
+  len = sizeof (MarkdownBrowserParseCacheSource) + titleLen;
+  data = g_malloc0 (len);                               // ++ alloc data
+
+  source = (MarkdownBrowserParseCacheSource *)data;
+  memcpy (source->magic, PARSE_CACHE_SOURCE_MAGIC, sizeof (source->magic));
+  source->version = PARSE_CACHE_VERSION;
+  source->titleLen = title ? titleLen : PARSE_CACHE_NO_TITLE;
+  source->size = statBuf->st_size;
+
+  // A file modified within the last second could change again without changing its modification time, its record
+  // is only trusted after checking the content hash
+  if (statBuf->st_mtime >= g_get_real_time () / G_USEC_PER_SEC - 1)
+    source->mtime = G_MININT64;
+  else source->mtime = statBuf->st_mtime;
+
+  if (hash && strlen (hash) == PARSE_CACHE_HASH_LEN)
+    memcpy (source->hash, hash, PARSE_CACHE_HASH_LEN);
+
+  matchHash = g_compute_checksum_for_string (G_CHECKSUM_SHA256, titleMatch, -1);      // ++ alloc match hash
+  memcpy (source->titleMatch, matchHash, PARSE_CACHE_HASH_LEN);
+  g_free (matchHash);                                   // -- free match hash
+
+  if (title)
+    memcpy (data + sizeof (MarkdownBrowserParseCacheSource), title, titleLen);
+
+  sourcePath = markdown_browser_parse_cache_source_path (dir, path);   // ++ alloc source path
+  markdown_browser_parse_cache_write (dir, sourcePath, data, len);
+  g_free (sourcePath);                                  // -- free source path
+  g_free (data);                                        // -- free data
+}
+
+/**
+ * markdown_browser_parse_cache_lookup:
+ * @hash: Content hash from markdown_browser_parse_cache_hash()
+ *
+ * Look up a parsed document by content hash.  The document uses the spans and text in the memory
+ * mapped cache file without copying them.  Safe to call from any thread.
+ *
+ * Returns: (transfer full): Document or NULL if it is not cached
+ */
+MarkdownBrowserDocument *
+markdown_browser_parse_cache_lookup (const char *hash)
+{
+  const MarkdownBrowserParseCacheHeader *header;
+  MarkdownBrowserDocument *doc = NULL;
+  const MarkdownBrowserSpan *spans;
+  GMappedFile *mappedFile;
+  const char *dir, *base;
+  char *path;
+  GBytes *bytes;
+  gsize size, spansLen;
+
+  g_return_val_if_fail (hash != NULL, NULL);
+
+  if (cache_budget == 0 || !(dir = markdown_browser_parse_cache_dir ()))
+    return NULL;
+
+  path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.parsed", dir, hash);      // ++ alloc path
+
+  if ((mappedFile = g_mapped_file_new (path, FALSE, NULL)))            // ++ map file
+  {
+    bytes = g_mapped_file_get_bytes (mappedFile);       // ++ new bytes (holds the mapping)
+    g_mapped_file_unref (mappedFile);                   // -- unref mapped file
+
+    base = g_bytes_get_data (bytes, &size);
+    header = (const MarkdownBrowserParseCacheHeader *)base;
+
+    if (size >= sizeof (MarkdownBrowserParseCacheHeader)
+        && memcmp (header->magic, PARSE_CACHE_PARSED_MAGIC, sizeof (header->magic)) == 0
+        && header->version == PARSE_CACHE_VERSION && header->byteOrder == PARSE_CACHE_BYTE_ORDER
+        && header->spanSize == sizeof (MarkdownBrowserSpan)
+        && header->spanCount <= (size - sizeof (MarkdownBrowserParseCacheHeader)) / sizeof (MarkdownBrowserSpan))
+    {
+      spansLen = (gsize)header->spanCount * sizeof (MarkdownBrowserSpan);
+
+      spans = (const MarkdownBrowserSpan *)(base + sizeof (MarkdownBrowserParseCacheHeader));
+
+      if (header->textLen == size - sizeof (MarkdownBrowserParseCacheHeader) - spansLen)
+        doc = markdown_browser_document_new_from_data (bytes, spans, header->spanCount,  // ++ new document (refs bytes)
+                                                       (const char *)spans + spansLen, header->textLen, FALSE);
+    }
+
+    g_bytes_unref (bytes);                              // -- unref bytes
+  }
+
+  if (doc)
+  {
+    g_utime (path, NULL);       // Most recently used, for eviction
+    g_atomic_int_inc (&cache_hits);
+  }
+  else g_atomic_int_inc (&cache_misses);
+
+  g_free (path);                                        // -- free path
+
+  return doc;
+}
+
+/**
+ * markdown_browser_parse_cache_save:
+ * @hash: Content hash from markdown_browser_parse_cache_hash()
+ * @doc: Document parsed from the content
+ *
+ * Save a parsed document to the cache.  Documents which exceeded the parse time limit are not
+ * saved, so they are parsed again.  Safe to call from any thread.
+ */
+void
+markdown_browser_parse_cache_save (const char *hash, MarkdownBrowserDocument *doc)
+{
+  MarkdownBrowserParseCacheHeader *header;
+  const char *dir;
+  char *path, *data;
+  gsize spansLen, len;
+
+  g_return_if_fail (hash != NULL);
+  g_return_if_fail (doc != NULL);
+
+  if (doc->timedOut || cache_budget == 0 || !(dir = markdown_browser_parse_cache_dir ()))
+    return;
+
+  spansLen = (gsize)doc->spanCount * sizeof (MarkdownBrowserSpan);
+  len = sizeof (MarkdownBrowserParseCacheHeader) + spansLen + doc->textLen;
+  data = g_malloc0 (len);                               // ++ alloc data
+
+  header = (MarkdownBrowserParseCacheHeader *)data;
+  memcpy (header->magic, PARSE_CACHE_PARSED_MAGIC, sizeof (header->magic));
+  header->version = PARSE_CACHE_VERSION;
+  header->byteOrder = PARSE_CACHE_BYTE_ORDER;
+  header->spanSize = sizeof (MarkdownBrowserSpan);
+  header->spanCount = doc->spanCount;
+  header->textLen = doc->textLen;
+
+  memcpy (data + sizeof (MarkdownBrowserParseCacheHeader), doc->spans, spansLen);
+  memcpy (data + sizeof (MarkdownBrowserParseCacheHeader) + spansLen, doc->text, doc->textLen);
+
+  path = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "%s.parsed", dir, hash);      // ++ alloc path
+  markdown_browser_parse_cache_write (dir, path, data, len);
+  g_free (path);                                        // -- free path
+  g_free (data);                                        // -- free data
+}
+
+/**
+ * markdown_browser_parse_cache_set_budget:
+ * @budget: Maximum bytes of cache files (0 disables caching)
+ *
+ * Set the size of the on-disk parse cache, removing least recently used files if it is now exceeded.
+ */
+void
+markdown_browser_parse_cache_set_budget (gsize budget)
+{
+  const char *dir;
+
+  g_mutex_lock (&cache_mutex);
+  cache_budget = budget;
+
+  if ((dir = markdown_browser_parse_cache_dir ()))
+    markdown_browser_parse_cache_evict (dir, budget);
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+/**
+ * markdown_browser_parse_cache_get_budget:
+ *
+ * Get the size of the on-disk parse cache.
+ *
+ * Returns: Maximum bytes of cache files
+ */
+gsize
+markdown_browser_parse_cache_get_budget (void)
+{
+  return cache_budget;
+}
+
+/**
+ * markdown_browser_parse_cache_get_stats:
+ * @hits: (out) (optional): Location to store the number of parsed documents loaded from the cache
+ * @misses: (out) (optional): Location to store the number of parsed documents not found in the cache
+ *
+ * Get parse cache statistics of this process.
+ */
+void
+markdown_browser_parse_cache_get_stats (guint *hits, guint *misses)
+{
+  if (hits) *hits = g_atomic_int_get (&cache_hits);
+  if (misses) *misses = g_atomic_int_get (&cache_misses);
+}
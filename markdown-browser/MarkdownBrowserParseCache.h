@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserParseCache.h - On-disk cache of parsed topic files.
+ */
+#ifndef MARKDOWN_BROWSER_PARSE_CACHE_H
+#define MARKDOWN_BROWSER_PARSE_CACHE_H
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "MarkdownBrowserDocument.h"
+
+#define MARKDOWN_BROWSER_PARSE_CACHE_DEFAULT_BUDGET     (64 * 1024 * 1024)      // Default cache size on disk in bytes
+
+char *markdown_browser_parse_cache_hash (const char *content, gssize len);
+gboolean markdown_browser_parse_cache_lookup_source (const char *path, const GStatBuf *statBuf, const char *titleMatch,
+                                                     const char *content, gssize len, char **title, char **hash);
+void markdown_browser_parse_cache_save_source (const char *path, const GStatBuf *statBuf, const char *titleMatch,
+                                               const char *title, const char *hash);
+MarkdownBrowserDocument *markdown_browser_parse_cache_lookup (const char *hash);
+void markdown_browser_parse_cache_save (const char *hash, MarkdownBrowserDocument *doc);
+void markdown_browser_parse_cache_set_budget (gsize budget);
+gsize markdown_browser_parse_cache_get_budget (void);
+void markdown_browser_parse_cache_get_stats (guint *hits, guint *misses);
+
+#endif
@@ -0,0 +1,52 @@
+# MarkdownBrowserResources.cmake - Compile a directory of Markdown topics and images into a GResource
+#
+# markdown_browser_compile_resources (<output variable> <directory> <resource path>)
+#
+# Packs the Markdown files (.md and .markdown) of a directory and the images anywhere below it into
+# a GResource under <resource path> (such as "/com/example/help/") and sets <output variable> to the
+# generated C source, to add to the sources of a target.  The resource is registered automatically
+# when the target starts.  Images are placed directly under <resource path>, since the browser strips
+# the directory of image names, so markdown_browser_add_resources() with the same path loads them too.
+#
+# Example:
+#   include (MarkdownBrowserResources.cmake)
+#   markdown_browser_compile_resources (HELP_RESOURCES ${CMAKE_SOURCE_DIR}/help "/com/example/help/")
+#   add_executable (example main.c ${HELP_RESOURCES})
+
+find_program (GLIB_COMPILE_RESOURCES glib-compile-resources)
+
+function (markdown_browser_compile_resources OUTPUT DIRECTORY PREFIX)
+  get_filename_component (NAME ${DIRECTORY} NAME)
+  set (XML_FILE ${CMAKE_CURRENT_BINARY_DIR}/${NAME}.gresource.xml)
+  set (C_FILE ${CMAKE_CURRENT_BINARY_DIR}/${NAME}-resources.c)
+
+  file (GLOB TOPIC_FILES RELATIVE ${DIRECTORY} ${DIRECTORY}/*.md ${DIRECTORY}/*.markdown)
+  file (GLOB_RECURSE IMAGE_FILES RELATIVE ${DIRECTORY} ${DIRECTORY}/*.png ${DIRECTORY}/*.jpg
+        ${DIRECTORY}/*.jpeg ${DIRECTORY}/*.gif ${DIRECTORY}/*.svg)
+
+  set (XML "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<gresources>\n  <gresource prefix=\"${PREFIX}\">\n")
+  set (DEPENDS "")
+
+  foreach (FILE ${TOPIC_FILES})
+    set (XML "${XML}    <file>${FILE}</file>\n")
+    list (APPEND DEPENDS ${DIRECTORY}/${FILE})
+  endforeach (FILE)
+
+  foreach (FILE ${IMAGE_FILES})
+    get_filename_component (ALIAS ${FILE} NAME)
+    set (XML "${XML}    <file alias=\"${ALIAS}\">${FILE}</file>\n")
+    list (APPEND DEPENDS ${DIRECTORY}/${FILE})
+  endforeach (FILE)
+
+  set (XML "${XML}  </gresource>\n</gresources>\n")
+  file (WRITE ${XML_FILE} ${XML})
+
+  add_custom_command (
+    OUTPUT ${C_FILE}
+    COMMAND ${GLIB_COMPILE_RESOURCES} --target=${C_FILE} --sourcedir=${DIRECTORY} --generate-source ${XML_FILE}
+    DEPENDS ${XML_FILE} ${DEPENDS}
+    COMMENT "Compiling ${NAME} Markdown resources"
+  )
+
+  set (${OUTPUT} ${C_FILE} PARENT_SCOPE)
+endfunction (markdown_browser_compile_resources)
@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021 Kymorphia, PBC - https://www.kymorphia.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * MarkdownBrowserScan.c - Vectorized scanning for Markdown significant characters.
+ *
+ * Plain text between Markdown tokens makes up most of the content, so finding the
+ * next significant byte is the inner loop of the lexer and unescaping.  An AVX2 or
+ * SSE2 kernel is selected at runtime, depending on the CPU, with a portable scalar
+ * fallback for other architectures.
+ */
+#include <string.h>
+
+#include "MarkdownBrowserScan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SCAN_X86
+#include <immintrin.h>
+#endif
+
+typedef const char *(*MarkdownBrowserScanFunc) (const char *s, const char *end, const char *chars, int count);
+
+static const char *markdown_browser_scan_scalar (const char *s, const char *end, const char *chars, int count);
+static const char *markdown_browser_scan_select (const char *s, const char *end, const char *chars, int count);
+
+static MarkdownBrowserScanFunc scan_func = markdown_browser_scan_select;     // Selected scan implementation
+static const char *scan_impl_name = "none";                                 // Name of selected implementation
+
+// Portable scan using a bit table of the characters
+static const char *
+markdown_browser_scan_scalar (const char *s, const char *end, const char *chars, int count)
+{
+  guint32 table[256 / 32] = { 0 };
+  int i;
+
+  for (i = 0; i < count; i++)
+    table[(guchar)chars[i] >> 5] |= 1u << ((guchar)chars[i] & 31);
+
+  for (; s < end; s++)
+    if (table[(guchar)*s >> 5] & (1u << ((guchar)*s & 31)))
+      return s;
+
+  return NULL;
+}
+
+#ifdef HAVE_SCAN_X86
+
+__attribute__ ((target ("sse2")))
+static const char *
+markdown_browser_scan_sse2 (const char *s, const char *end, const char *chars, int count)
+{
+  __m128i set[MARKDOWN_BROWSER_SCAN_MAX_CHARS], block, match;
+  int i, mask;
+
+  for (i = 0; i < count; i++)
+    set[i] = _mm_set1_epi8 (chars[i]);
+
+  for (; end - s >= 16; s += 16)
+  {
+    block = _mm_loadu_si128 ((const __m128i *)s);
+    match = _mm_cmpeq_epi8 (block, set[0]);
+
+    for (i = 1; i < count; i++)
+      match = _mm_or_si128 (match, _mm_cmpeq_epi8 (block, set[i]));
+
+    if ((mask = _mm_movemask_epi8 (match)))
+      return s + __builtin_ctz (mask);
+  }
+
+  return markdown_browser_scan_scalar (s, end, chars, count);
+}
+
+__attribute__ ((target ("avx2")))
+static const char *
+markdown_browser_scan_avx2 (const char *s, const char *end, const char *chars, int count)
+{
+  __m256i set[MARKDOWN_BROWSER_SCAN_MAX_CHARS], block, match;
+  guint32 mask;
+  int i;
+
+  for (i = 0; i < count; i++)
+    set[i] = _mm256_set1_epi8 (chars[i]);
+
+  for (; end - s >= 32; s += 32)
+  {
+    block = _mm256_loadu_si256 ((const __m256i *)s);
+    match = _mm256_cmpeq_epi8 (block, set[0]);
+
+    for (i = 1; i < count; i++)
+      match = _mm256_or_si256 (match, _mm256_cmpeq_epi8 (block, set[i]));
+
+    if ((mask = (guint32)_mm256_movemask_epi8 (match)))
+      return s + __builtin_ctz (mask);
+  }
+
+  return markdown_browser_scan_sse2 (s, end, chars, count);
+}
+
+#endif
+
+// Select the best implementation for the CPU on first use
+static const char *
+markdown_browser_scan_select (const char *s, const char *end, const char *chars, int count)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+  {
+#ifdef HAVE_SCAN_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+    {
+      scan_func = markdown_browser_scan_avx2;
+      scan_impl_name = "avx2";
+    }
+    else if (__builtin_cpu_supports ("sse2"))
+    {
+      scan_func = markdown_browser_scan_sse2;
+      scan_impl_name = "sse2";
+    }
+    else
+#endif
+    {
+      scan_func = markdown_browser_scan_scalar;
+      scan_impl_name = "scalar";
+    }
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return scan_func (s, end, chars, count);
+}
+
+/**
+ * markdown_browser_scan_chars:
+ * @s: Start of content to scan
+ * @end: End of content (one past the last byte)
+ * @chars: Array of byte values to scan for
+ * @count: Number of bytes in @chars (1 to #MARKDOWN_BROWSER_SCAN_MAX_CHARS)
+ *
+ * Find the first byte in content which is one of a set of bytes.
+ *
+ * Returns: Pointer to the first matching byte or NULL if none
+ */
+const char *
+markdown_browser_scan_chars (const char *s, const char *end, const char *chars, int count)
+{
+  g_return_val_if_fail (count > 0 && count <= MARKDOWN_BROWSER_SCAN_MAX_CHARS, NULL);
+
+  if (s >= end)
+    return NULL;
+
+  if (count == 1)               // C library memchr is already vectorized
+    return memchr (s, chars[0], end - s);
+
+  return scan_func (s, end, chars, count);
+}
+
+/**
+ * markdown_browser_scan_get_impl:
+ *
+ * Get the name of the scan implementation selected for the CPU ("avx2", "sse2", "scalar" or
+ * "none" if no scan has been done yet).
+ *
+ * Returns: Implementation name
+ */
+const char *
+markdown_browser_scan_get_impl (void)
+{
+  return scan_impl_name;
+}
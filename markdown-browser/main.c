@@ -28,6 +28,9 @@
 
 #include "MarkdownBrowserDialog.h"
 #include "MarkdownBrowser.h"
+#include "MarkdownBrowserImageCache.h"
+#include "MarkdownBrowserParseCache.h"
+#include "MarkdownBrowserScan.h"
 
 #define CMDLINE_SUMMARY \
   "markdown-browser Test Markdown browser application\n" \
@@ -38,7 +41,45 @@ static char *images_path = NULL;
 static char *file_match = NULL;
 static char *title_match = NULL;
 static char *ui_file = NULL;
+static char *bundle_file = NULL;
 static GSList *topic_paths = NULL;
+static int benchmark_count = 0;
+#ifdef DEBUG
+static gboolean check = FALSE;
+#endif
+
+// Count heap allocations of the main thread in debug builds by wrapping the glibc allocator (GLib allocates with it)
+#if defined (DEBUG) && defined (__GLIBC__)
+#define COUNT_ALLOCS
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t count, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static __thread gboolean count_allocs = FALSE;  // Per thread, so parser and image worker threads are not counted
+static __thread guint alloc_count = 0;
+
+void *
+malloc (size_t size)
+{
+  if (count_allocs) alloc_count++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t count, size_t size)
+{
+  if (count_allocs) alloc_count++;
+  return __libc_calloc (count, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  if (count_allocs) alloc_count++;
+  return __libc_realloc (ptr, size);
+}
+#endif
 
 static GOptionEntry command_line_options[] =
 {
@@ -50,6 +91,14 @@ static GOptionEntry command_line_options[] =
     "Regex to extract title from Markdown files, capture group is the title (defeaults to '^ {0,3}\\# (.*)')", NULL },
   { "ui-file", 'u', 0, G_OPTION_ARG_STRING, &ui_file,
     "External UI file to use instead of default builtin interface data", NULL },
+  { "bundle", 'B', 0, G_OPTION_ARG_FILENAME, &bundle_file,
+    "Help bundle compiled by markdown-browser-compile to load instead of Markdown files", "FILE" },
+  { "benchmark", 'b', 0, G_OPTION_ARG_INT, &benchmark_count,
+    "Render each topic COUNT times (also with per-span tags in debug builds), print render times and tag toggle counts and exit", "COUNT" },
+#ifdef DEBUG
+  { "check", 'c', 0, G_OPTION_ARG_NONE, &check,
+    "Check that each topic renders the same with the lexer and the original regex scan and exit", NULL },
+#endif
   { NULL }
 };
 
@@ -68,6 +117,177 @@ app_open (GApplication *app, GFile **files, gint n_files, const gchar *hint)
   g_application_activate (app);
 }                           
 
+// Find the first GtkTextView in a widget hierarchy
+static GtkTextView *
+find_text_view (GtkWidget *widget)
+{
+  GtkTextView *textView = NULL;
+  GList *children, *p;
+
+  if (GTK_IS_TEXT_VIEW (widget))
+    return GTK_TEXT_VIEW (widget);
+
+  if (!GTK_IS_CONTAINER (widget))
+    return NULL;
+
+  children = gtk_container_get_children (GTK_CONTAINER (widget));      // ++ alloc list of children
+
+  for (p = children; p && !textView; p = p->next)
+    textView = find_text_view (GTK_WIDGET (p->data));
+
+  g_list_free (children);       // -- free list of children
+
+  return textView;
+}
+
+// Render a topic benchmark_count times and count the tag toggle positions of the rendered text buffer, returns the
+// average render time in microseconds
+static gint64
+benchmark_topic (MarkdownBrowser *browser, GtkTextView *textView, int topicIndex, int *toggles)
+{
+  GtkTextIter iter;
+  gint64 start, total = 0;
+  int n;
+
+  for (n = 0; n < benchmark_count; n++)
+  {
+    markdown_browser_navigate (browser, 0, MARKDOWN_BROWSER_TOPIC_NONE);
+
+    start = g_get_monotonic_time ();
+    markdown_browser_navigate (browser, 0, topicIndex);
+
+    while (gtk_events_pending ())       // Let progressive rendering complete
+      gtk_main_iteration ();
+
+    total += g_get_monotonic_time () - start;
+  }
+
+  // Count tag toggle positions in rendered text buffer
+  *toggles = 0;
+  gtk_text_buffer_get_start_iter (gtk_text_view_get_buffer (textView), &iter);
+
+  while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL))
+    (*toggles)++;
+
+  return total / benchmark_count;
+}
+
+#ifdef COUNT_ALLOCS
+// Render a topic once more (after benchmark_topic() warmed the parse and image caches) and return the number of heap
+// allocations made by the main thread for it
+static guint
+count_render_allocs (MarkdownBrowser *browser, int topicIndex)
+{
+  markdown_browser_navigate (browser, 0, MARKDOWN_BROWSER_TOPIC_NONE);
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  alloc_count = 0;
+  count_allocs = TRUE;
+
+  markdown_browser_navigate (browser, 0, topicIndex);
+
+  while (gtk_events_pending ())       // Let progressive rendering complete
+    gtk_main_iteration ();
+
+  count_allocs = FALSE;
+
+  return alloc_count;
+}
+#endif
+
+// Render each topic benchmark_count times (with render cache disabled) and print timing and tag toggle counts.  Debug
+// builds also render with tags applied to each span for comparison (and count heap allocations of one render).
+static void
+run_benchmark (MarkdownBrowser *browser)
+{
+  MarkdownBrowserTopic *topics;
+  GtkTextView *textView;
+  guint count, i, hits, misses, images;
+  gint64 runsTime, runsTotal = 0;
+  gsize bytes;
+  int runsToggles;
+#ifdef DEBUG
+  gint64 spansTime, spansTotal = 0;
+  int spansToggles;
+#endif
+
+  g_object_set (browser, "render-cache-size", 0, NULL);
+  textView = find_text_view (GTK_WIDGET (browser));
+  topics = markdown_browser_get_topics (browser, &count);
+
+  g_print ("%-32s %13s %8s", "Topic", "Runs", "Toggles");
+#ifdef DEBUG
+  g_print (" %13s %8s", "Spans", "Toggles");
+#endif
+#ifdef COUNT_ALLOCS
+  g_print (" %8s", "Allocs");
+#endif
+  g_print ("\n");
+
+  for (i = 0; i < count; i++)
+  {
+    runsTime = benchmark_topic (browser, textView, i, &runsToggles);
+    g_print ("%-32s %10.3f ms %8d", topics[i].name, runsTime / 1000.0, runsToggles);
+    runsTotal += runsTime;
+
+#ifdef DEBUG
+    markdown_browser_set_coalesce_runs (browser, FALSE);
+    spansTime = benchmark_topic (browser, textView, i, &spansToggles);
+    markdown_browser_set_coalesce_runs (browser, TRUE);
+
+    g_print (" %10.3f ms %8d", spansTime / 1000.0, spansToggles);
+    spansTotal += spansTime;
+#endif
+#ifdef COUNT_ALLOCS
+    g_print (" %8u", count_render_allocs (browser, i));
+#endif
+    g_print ("\n");
+  }
+
+  g_print ("Total %.3f ms with runs", runsTotal / 1000.0);
+#ifdef DEBUG
+  g_print (", %.3f ms with spans", spansTotal / 1000.0);
+#endif
+  g_print (" per pass over %u topics (%s scanning)\n", count, markdown_browser_scan_get_impl ());
+
+  markdown_browser_image_cache_get_stats (&hits, &misses, &images, &bytes);
+  g_print ("Image cache: %u hits, %u misses, %u images using %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes\n",
+           hits, misses, images, bytes, markdown_browser_image_cache_get_budget ());
+
+  markdown_browser_image_cache_get_raster_stats (&hits, &misses);
+  g_print ("Raster cache: %u hits, %u misses\n", hits, misses);
+
+  markdown_browser_parse_cache_get_stats (&hits, &misses);
+  g_print ("Parse cache: %u hits, %u misses\n", hits, misses);
+}
+
+#ifdef DEBUG
+// Render each topic with the lexer and the original regex scan and print differences
+static void
+run_check (MarkdownBrowser *browser)
+{
+  MarkdownBrowserTopic *topics;
+  guint count, i, failed = 0;
+  int ofs;
+
+  topics = markdown_browser_get_topics (browser, &count);
+
+  for (i = 0; i < count; i++)
+  {
+    if ((ofs = markdown_browser_check_topic (browser, i)) != -1)
+    {
+      g_print ("%-32s differs at character %d\n", topics[i].name, ofs);
+      failed++;
+    }
+    else g_print ("%-32s OK\n", topics[i].name);
+  }
+
+  g_print ("%u of %u topics differ\n", failed, count);
+}
+#endif
+
 static void
 app_activate (GApplication *app, gpointer user_data)
 {
@@ -81,7 +301,15 @@ app_activate (GApplication *app, gpointer user_data)
   browserDialog = markdown_browser_dialog_new (ui_file);
   browser = markdown_browser_dialog_get_browser (MARKDOWN_BROWSER_DIALOG (browserDialog));
 
-  if (topic_paths)
+  if (bundle_file)
+  {
+    if (!markdown_browser_add_bundle (browser, bundle_file, &err))
+    {
+      g_warning ("%s", err->message);
+      g_clear_error (&err);
+    }
+  }
+  else if (topic_paths)
   {
     for (p = topic_paths; p; p = p->next)
     {
@@ -103,9 +331,25 @@ app_activate (GApplication *app, gpointer user_data)
     }
   }
 
-  if (images_path)
+  if (images_path)                // Images of topics added from files, bundle topics use the images of the bundle
     g_object_set (browser, "images-path", images_path, NULL);
 
+#ifdef DEBUG
+  if (check)
+  {
+    run_check (browser);
+    gtk_widget_destroy (browserDialog);
+    return;
+  }
+#endif
+
+  if (benchmark_count > 0)
+  {
+    run_benchmark (browser);
+    gtk_widget_destroy (browserDialog);
+    return;
+  }
+
   gtk_widget_show (browserDialog);
 
   gtk_application_add_window (GTK_APPLICATION (app), GTK_WINDOW (browserDialog));